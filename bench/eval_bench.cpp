@@ -0,0 +1,85 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <eval.h>
+
+namespace {
+
+    template <typename F>
+    double measure(F f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+
+    char const * name(eval::isa target) {
+        switch (target) {
+            case eval::isa::GENERIC:
+                return "generic";
+            case eval::isa::AVX2:
+                return "avx2";
+            case eval::isa::AVX512:
+                return "avx512";
+        }
+        return "";
+    }
+
+}
+
+int main(int argc, char ** argv) {
+    size_t rows = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+    std::pair<char const *, std::string> programs[] = {
+        {"straight", "x = a * b - c / (a - b + 1) y = -x + (a < b) * 3 z = x * y + a * a - b * c w = z >= 0 && y != 0"},
+        {"loop", "r = 0 while k > 0 r = r + k * a k = k - 1 end"},
+        {"divergent", "s = 0 while n > 1 && s < 64 if n - n / 2 * 2 == 1 n = 3 * n + 1 end n = n / 2 s = s + 1 end"},
+    };
+
+    for (auto const & [label, input] : programs) {
+        auto p = eval::compile(std::get<parser::ast::tree>(parser::parse(input)), input);
+
+        eval::table initial(p, rows);
+        std::mt19937 random(7);
+        std::uniform_int_distribution<eval::value> values(1, 40);
+        for (uint32_t var = 0; var < p.variable_count(); ++var) {
+            for (auto & v : initial.column(var)) {
+                v = values(random);
+            }
+        }
+
+        auto scalar = initial;
+        std::vector<eval::value> variables(p.variable_count());
+        auto seconds = measure([&] {
+            for (size_t row = 0; row < rows; ++row) {
+                for (uint32_t var = 0; var < p.variable_count(); ++var) {
+                    variables[var] = scalar.column(var)[row];
+                }
+                eval::run(p, variables);
+                for (uint32_t var = 0; var < p.variable_count(); ++var) {
+                    scalar.column(var)[row] = variables[var];
+                }
+            }
+        });
+        std::cout << label << ": scalar " << seconds / rows * 1e9 << " ns/env";
+
+        for (auto target : {eval::isa::GENERIC, eval::isa::AVX2, eval::isa::AVX512}) {
+            if (!eval::is_supported(target)) {
+                continue;
+            }
+            auto batch = initial;
+            auto batch_seconds = measure([&] {
+                eval::run(p, batch, eval::DEFAULT_MAX_TESTS, target);
+            });
+            bool same = true;
+            for (uint32_t var = 0; var < p.variable_count(); ++var) {
+                same &= std::equal(batch.column(var).begin(), batch.column(var).end(), scalar.column(var).begin());
+            }
+            std::cout << " | " << name(target) << " " << batch_seconds / rows * 1e9 << " ns/env"
+                      << " (x" << seconds / batch_seconds << (same ? "" : ", MISMATCH") << ")";
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
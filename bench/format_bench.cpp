@@ -0,0 +1,29 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <format.h>
+
+int main(int argc, char ** argv) {
+    int blocks = argc > 1 ? std::stoi(argv[1]) : 1000;
+
+    std::string input;
+    for (int i = 0; i < blocks; ++i) {
+        input += "a=b+(c*d)-e  while (a<10) if a>5 b=(b-1)/2 end a=a+1 end\n";
+    }
+
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+
+    std::string out;
+    auto iterations = 200;
+    auto start = std::chrono::steady_clock::now();
+    for (auto i = 0; i < iterations; ++i) {
+        formatter::format(tree, input, out);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    auto megabytes = static_cast<double>(out.size()) * iterations / (1 << 20);
+    std::cout << "nodes: " << tree.size() << ", output: " << out.size() << " bytes" << std::endl;
+    std::cout << "format: " << megabytes / elapsed.count() << " MB/s, "
+              << elapsed.count() / iterations * 1e6 << " us/program" << std::endl;
+    return 0;
+}
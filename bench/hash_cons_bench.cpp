@@ -0,0 +1,32 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <hash_cons.h>
+#include "program_generator.h"
+
+int main(int argc, char ** argv) {
+    uint32_t statements = argc > 1 ? std::stoul(argv[1]) : 5000;
+
+    size_t nodes = 0, unique = 0, tree_bytes = 0, consed_bytes = 0;
+    double seconds = 0;
+    for (uint32_t seed = 0; seed < 10; ++seed) {
+        auto input = program_generator::generate(statements, seed);
+        auto tree = std::get<parser::ast::tree>(parser::parse(input));
+
+        auto start = std::chrono::steady_clock::now();
+        auto consed = parser::ast::hash_cons(tree, input);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        nodes += tree.size();
+        unique += consed.size();
+        tree_bytes += tree.memory_usage();
+        consed_bytes += consed.memory_usage();
+    }
+
+    std::cout << "nodes: " << nodes << " -> " << unique
+              << " (" << 100.0 * unique / nodes << "%)" << std::endl;
+    std::cout << "memory: " << tree_bytes << " -> " << consed_bytes << " bytes"
+              << " (" << 100.0 * consed_bytes / tree_bytes << "%)" << std::endl;
+    std::cout << "hash_cons: " << seconds / 10 * 1e6 << " us/program" << std::endl;
+    return 0;
+}
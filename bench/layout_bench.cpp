@@ -0,0 +1,154 @@
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+#include <analyze.h>
+#include <layout.h>
+#include <pretty_print.h>
+#include "program_generator.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+    // Hardware cache misses of the calling thread, when the kernel lets us count them
+    class cache_misses {
+    public:
+        cache_misses() {
+#ifdef __linux__
+            perf_event_attr attr{};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+        }
+
+        ~cache_misses() {
+#ifdef __linux__
+            if (fd_ >= 0) {
+                close(fd_);
+            }
+#endif
+        }
+
+        template <typename F>
+        std::optional<uint64_t> count(F f) {
+#ifdef __linux__
+            if (fd_ >= 0) {
+                ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+                f();
+                ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+                uint64_t value = 0;
+                if (read(fd_, &value, sizeof(value)) == sizeof(value)) {
+                    return value;
+                }
+                return std::nullopt;
+            }
+#endif
+            f();
+            return std::nullopt;
+        }
+
+    private:
+        int fd_ = -1;
+    };
+
+    // Share of the steps of a pre-order walk that do not go to the same or the next couple of nodes,
+    // i.e. that are likely to touch a cache line the hardware prefetcher did not bring in
+    double far_jumps(parser::ast::tree const & tree) {
+        uint64_t jumps = 0, steps = 0;
+        uint16_t previous = tree.get_root();
+        for (auto node : parser::ast::preorder(tree)) {
+            jumps += node < previous || node > previous + 2;
+            previous = node;
+            ++steps;
+        }
+        return 100.0 * jumps / steps;
+    }
+
+}
+
+int main(int argc, char ** argv) {
+    // trees are visited in turn, so with the default sizes each traversal starts with a cold cache
+    uint32_t programs = argc > 1 ? std::stoul(argv[1]) : 128;
+    uint32_t statements = argc > 2 ? std::stoul(argv[2]) : 4500;
+    int rounds = 5;
+
+    std::vector<std::string> inputs;
+    std::vector<parser::ast::tree> parsed, preorder, blocked;
+    size_t nodes = 0;
+    for (uint32_t seed = 0; seed < programs; ++seed) {
+        inputs.push_back(program_generator::generate(statements, seed));
+        parsed.push_back(std::get<parser::ast::tree>(parser::parse(inputs.back())));
+        preorder.push_back(parser::ast::relayout(parsed.back(), parser::ast::layout::PREORDER));
+        blocked.push_back(parser::ast::relayout(parsed.back(), parser::ast::layout::VAN_EMDE_BOAS));
+        nodes += parsed.back().size();
+    }
+    std::cout << "programs: " << programs << ", nodes: " << nodes / programs << " per program" << std::endl;
+
+    cache_misses counter;
+    auto report = [&](char const * name, std::vector<parser::ast::tree> const & trees) {
+        size_t checksum = 0;
+        auto run = [&](auto f) {
+            std::optional<uint64_t> misses = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (int round = 0; round < rounds; ++round) {
+                for (size_t idx = 0; idx < trees.size(); ++idx) {
+                    auto counted = counter.count([&] {
+                        f(trees[idx], inputs[idx]);
+                    });
+                    misses = misses && counted ? std::optional<uint64_t>(*misses + *counted) : std::nullopt;
+                }
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::ostringstream line;
+            line << std::fixed << std::setprecision(1) << elapsed.count() / rounds / trees.size() * 1e6 << " us";
+            if (misses) {
+                line << ", " << *misses / rounds / trees.size() << " misses";
+            }
+            return line.str();
+        };
+
+        auto walk = run([&](parser::ast::tree const & tree, std::string_view) {
+            for (auto node : parser::ast::preorder(tree)) {
+                checksum += tree.get_range(node).first;
+            }
+        });
+        auto analyze = run([&](parser::ast::tree const & tree, std::string_view sv) {
+            checksum += find_unused_assignments(tree, sv).size();
+        });
+        std::string out;
+        auto binary = run([&](parser::ast::tree const & tree, std::string_view) {
+            out.clear();
+            printer::print_binary(out, tree);
+            checksum += out.size();
+        });
+
+        double jumps = 0;
+        for (auto const & tree : trees) {
+            jumps += far_jumps(tree);
+        }
+
+        std::cout << name << ": far jumps " << std::fixed << std::setprecision(1) << jumps / trees.size() << "%"
+                  << " | preorder " << walk << " | analyze " << analyze << " | print_binary " << binary
+                  << " (" << checksum % 10 << ")" << std::endl;
+    };
+
+    report("parse order  ", parsed);
+    report("preorder     ", preorder);
+    report("van Emde Boas", blocked);
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <server.h>
+
+int main(int argc, char ** argv) {
+    int requests = argc > 1 ? std::stoi(argv[1]) : 20000;
+    int blocks = argc > 2 ? std::stoi(argv[2]) : 40; // about 2.5 KB
+
+    std::string input;
+    for (int i = 0; i < blocks; ++i) {
+        input += "a=b+(c*d)-e  while (a<10) if a>5 b=(b-1)/2 end a=a+1 end\n";
+    }
+
+    auto path = (std::filesystem::temp_directory_path() / "simple_parser_bench.sock").string();
+    server::daemon daemon(path, 2);
+    std::thread loop([&] { daemon.serve(); });
+
+    std::vector<double> latencies;
+    {
+        server::client client(path);
+        for (int i = 0; i < requests / 10; ++i) { // warm up
+            client.request(server::protocol::ANALYZE, server::protocol::BINARY, input);
+        }
+
+        latencies.reserve(requests);
+        for (int i = 0; i < requests; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            client.request(server::protocol::ANALYZE, server::protocol::BINARY, input);
+            std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+            latencies.push_back(elapsed.count());
+        }
+    }
+
+    daemon.stop();
+    loop.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+    };
+    std::cout << "program: " << input.size() << " bytes, requests: " << requests << std::endl;
+    std::cout << "analyze round trip: p50 " << percentile(0.5) << " us, p99 " << percentile(0.99)
+              << " us, max " << latencies.back() << " us" << std::endl;
+    return 0;
+}
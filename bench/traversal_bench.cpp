@@ -0,0 +1,61 @@
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <analyze.h>
+#include <pretty_print.h>
+
+namespace {
+
+    template <typename F>
+    double measure(int iterations, F f) {
+        auto start = std::chrono::steady_clock::now();
+        for (auto i = 0; i < iterations; ++i) {
+            f();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / iterations * 1e6;
+    }
+
+}
+
+int main(int argc, char ** argv) {
+    int blocks = argc > 1 ? std::stoi(argv[1]) : 1000;
+
+    std::string input;
+    for (int i = 0; i < blocks; ++i) {
+        input += "a=b+(c*d)-e  while (a<10) if a>5 b=(b-1)/2 end a=a+1 end\n";
+    }
+
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    auto iterations = 200;
+
+    size_t unused = 0;
+    auto analyze = measure(iterations, [&] {
+        unused += find_unused_assignments(tree, input).size();
+    });
+
+    std::ostringstream text;
+    auto print = measure(iterations, [&] {
+        text.str({});
+        printer::print(text, tree, input);
+    });
+
+    std::string out;
+    auto json = measure(iterations, [&] {
+        out.clear();
+        printer::print_json(out, tree);
+    });
+
+    auto binary = measure(iterations, [&] {
+        out.clear();
+        printer::print_binary(out, tree);
+    });
+
+    std::cout << "nodes: " << tree.size() << ", unused: " << unused / iterations << std::endl;
+    std::cout << "analyze: " << analyze << " us/program" << std::endl;
+    std::cout << "print: " << print << " us/program" << std::endl;
+    std::cout << "print_json: " << json << " us/program" << std::endl;
+    std::cout << "print_binary: " << binary << " us/program" << std::endl;
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <parser.h>
+#include <validate.h>
+#include "program_generator.h"
+
+namespace {
+
+    // best of a few runs, in MB/s
+    template <typename F>
+    double throughput(std::string const & input, F f) {
+        double best = 0;
+        for (int run = 0; run < 5; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            f();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::max(best, input.size() / elapsed.count() / (1 << 20));
+        }
+        return best;
+    }
+
+}
+
+int main() {
+    for (uint32_t indent : {0u, 4u, 16u}) {
+        // statements of a program share one tree, which holds at most 65535 nodes
+        auto input = program_generator::generate(4000, 1u, {.long_names = true, .constants = 100000, .indent = std::string(indent, ' ')});
+        std::string many;
+        while (many.size() < (64u << 20)) {
+            many += input;
+        }
+
+        size_t sink = 0;
+        auto scan = throughput(many, [&] {
+            sink += reinterpret_cast<uintptr_t>(std::memchr(many.data(), '#', many.size()));
+        });
+        auto validate = throughput(many, [&] {
+            sink += parser::validate(many).has_value();
+        });
+        auto parse = throughput(input, [&] {
+            sink += std::holds_alternative<lexer::error>(parser::parse(input));
+        });
+
+        std::cout << "indent " << indent << ": memchr " << scan << " MB/s | validate " << validate << " MB/s | parse "
+                  << parse << " MB/s (x" << validate / parse << ")" << (sink ? "" : " ") << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <driver.h>
+#include <server.h>
+
+namespace {
+
+    constexpr char USAGE[] =
+        "usage: simple-parser [--json] [--stats] [--trace FILE] [--jobs N] [--files-from LIST] [PATH...]\n"
+        "       simple-parser --serve SOCKET [--jobs N]\n"
+        "  PATH               file or directory (searched recursively)\n"
+        "  --files-from LIST  newline separated paths, '-' for stdin\n"
+        "  --json             one JSON object per file instead of text\n"
+        "  --stats            throughput and per-phase time on stderr\n"
+        "  --trace FILE       Chrome trace events of the phases, per worker and file (builds with SIMPLE_PARSER_TRACE)\n"
+        "  --jobs N           worker threads (default: all cores)\n"
+        "  --serve SOCKET     answer requests on a Unix domain socket until SIGINT or SIGTERM\n";
+
+    constexpr size_t FLUSH_SIZE = 1 << 16;
+
+    struct options {
+        std::vector<std::string> paths;
+        std::string files_from;
+        std::string socket;
+        std::string trace;
+        bool json = false;
+        bool stats = false;
+        unsigned jobs = std::thread::hardware_concurrency();
+    };
+
+    bool parse_options(int argc, char ** argv, options & opts) {
+        for (int idx = 1; idx < argc; ++idx) {
+            std::string_view arg = argv[idx];
+            if (arg == "--json") {
+                opts.json = true;
+            } else if (arg == "--stats") {
+                opts.stats = true;
+            } else if (arg == "--jobs" && idx + 1 < argc) {
+                std::string_view value = argv[++idx];
+                auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), opts.jobs);
+                if (ec != std::errc() || end != value.data() + value.size() || !opts.jobs) {
+                    return false;
+                }
+            } else if (arg == "--files-from" && idx + 1 < argc) {
+                opts.files_from = argv[++idx];
+            } else if (arg == "--serve" && idx + 1 < argc) {
+                opts.socket = argv[++idx];
+            } else if (arg == "--trace" && idx + 1 < argc && trace::enabled) {
+                opts.trace = argv[++idx];
+            } else if (arg.starts_with("--")) {
+                return false;
+            } else {
+                opts.paths.emplace_back(arg);
+            }
+        }
+        return !opts.paths.empty() || !opts.files_from.empty() || !opts.socket.empty();
+    }
+
+    server::daemon * running = nullptr;
+
+    int serve(options const & opts) {
+        try {
+            server::daemon daemon(opts.socket, opts.jobs);
+            running = &daemon;
+            std::signal(SIGINT, [](int) { running->stop(); });
+            std::signal(SIGTERM, [](int) { running->stop(); });
+            daemon.serve();
+            running = nullptr;
+        } catch (std::system_error const & e) {
+            std::cerr << "simple-parser: " << e.what() << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+}
+
+int main(int argc, char ** argv) {
+    options opts;
+    if (!parse_options(argc, argv, opts)) {
+        std::cerr << USAGE;
+        return 2;
+    }
+    if (!opts.socket.empty()) {
+        return serve(opts);
+    }
+
+    std::ifstream list_file;
+    std::istream * file_list = nullptr;
+    if (opts.files_from == "-") {
+        file_list = &std::cin;
+    } else if (!opts.files_from.empty()) {
+        list_file.open(opts.files_from);
+        if (!list_file) {
+            std::cerr << "simple-parser: cannot read " << opts.files_from << '\n';
+            return 2;
+        }
+        file_list = &list_file;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto inputs = driver::collect_inputs(opts.paths, file_list);
+
+    std::vector<driver::file_result> results;
+    {
+        concurrency::work_stealing_pool pool(opts.jobs);
+        results = driver::run(pool, inputs);
+    }
+
+    std::string out;
+    for (size_t idx = 0; idx < inputs.size(); ++idx) {
+        if (opts.json) {
+            driver::write_json(out, inputs[idx], results[idx]);
+        } else {
+            driver::write_text(out, inputs[idx], results[idx]);
+        }
+        if (out.size() >= FLUSH_SIZE) {
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            out.clear();
+        }
+    }
+    std::fwrite(out.data(), 1, out.size(), stdout);
+    std::fflush(stdout);
+
+    auto summary = driver::summarize(results, std::chrono::steady_clock::now() - start);
+    if (opts.stats) {
+        driver::write_summary(std::cerr, summary);
+    }
+#ifdef SIMPLE_PARSER_TRACE
+    if (!opts.trace.empty()) {
+        std::ofstream trace_file(opts.trace);
+        trace::write_chrome_json(trace_file);
+        if (!trace_file) {
+            std::cerr << "simple-parser: cannot write " << opts.trace << '\n';
+            return 2;
+        }
+        if (auto dropped = trace::dropped()) {
+            std::cerr << "simple-parser: " << dropped << " trace events dropped\n";
+        }
+    }
+#endif
+    return summary.failed ? 1 : 0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <type_traits>
+#include <vector>
+
+namespace memory {
+
+    // Allocates from a std::pmr::memory_resource, or from the global heap when it has none.
+    // Unlike std::pmr::polymorphic_allocator it also works during constant evaluation, so the
+    // constexpr pipeline and the arena-backed one share the same container types.
+    template <typename T>
+    class allocator {
+    public:
+        using value_type = T;
+        // moved and swapped containers keep their memory where it is
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        constexpr allocator() noexcept = default;
+
+        constexpr allocator(std::pmr::memory_resource * resource) noexcept : resource_(resource) {}
+
+        template <typename U>
+        constexpr allocator(allocator<U> const & other) noexcept : resource_(other.resource()) {}
+
+        [[nodiscard]]
+        constexpr T * allocate(size_t n) {
+            if (std::is_constant_evaluated() || !resource_) {
+                return std::allocator<T>().allocate(n);
+            }
+            return static_cast<T *>(resource_->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        constexpr void deallocate(T * ptr, size_t n) {
+            if (std::is_constant_evaluated() || !resource_) {
+                std::allocator<T>().deallocate(ptr, n);
+                return;
+            }
+            resource_->deallocate(ptr, n * sizeof(T), alignof(T));
+        }
+
+        // copies go to the heap like with std::pmr, a copy must not outlive an arena it never asked for
+        [[nodiscard]]
+        constexpr allocator select_on_container_copy_construction() const noexcept {
+            return {};
+        }
+
+        [[nodiscard]]
+        constexpr std::pmr::memory_resource * resource() const noexcept {
+            return resource_;
+        }
+
+        template <typename U>
+        constexpr bool operator==(allocator<U> const & other) const noexcept {
+            return resource_ == other.resource();
+        }
+
+    private:
+        std::pmr::memory_resource * resource_ = nullptr;
+    };
+
+    template <typename T>
+    using vector = std::vector<T, allocator<T>>;
+
+}
@@ -1,164 +1,386 @@
 #pragma once
 
-#include <map>
-#include <set>
+#include <algorithm>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+#include "allocator.h"
 #include "parser.h"
 #include "lexer.h"
+#include "stats.h"
+#include "trace.h"
+#include "visitor.h"
 
 namespace detail {
 
-    void get_free_variables_in_expression_helper(
-        std::set<std::string> & tokens,
-        parser::ast::tree const & tree,
-        uint32_t expression,
-        std::string_view sv
-    ) {
-        sw: switch (tree.get_kind(expression)) {
-            case parser::ast::kind::VAR: {
-                tokens.insert(std::string(tree.get_string(expression, sv)));
-                break;
-            }
-            case parser::ast::kind::BINOP: {
-                get_free_variables_in_expression_helper(tokens, tree, tree.get_left(expression), sv);
-                expression = tree.get_right(expression);
-                goto sw;
+    constexpr uint32_t NO_VARIABLE = -1;
+
+    // Per-node results of the scope analysis
+    struct scopes {
+        memory::vector<uint32_t> variables;   // variable id of every VAR node
+        memory::vector<uint16_t> reentries;   // ASSIGNMENT: innermost loop whose next iteration reads it, or npos
+        memory::vector<uint32_t> loop_depths; // WHILE: nesting depth starting from 1
+        uint32_t variable_count = 0;
+        uint32_t max_depth = 0;
+    };
+
+    // Calls `f` for every VAR node of the expression from left to right
+    template <typename F>
+    constexpr void for_each_variable(parser::ast::tree const & tree, uint16_t expression, F f) {
+        for (auto node : parser::ast::preorder(tree, expression)) {
+            if (tree.get_kind(node) == parser::ast::kind::VAR) {
+                f(node);
             }
-            default:
-                break;
         }
     }
 
-    std::set<std::string> get_free_variables_in_expression(
-            parser::ast::tree const & tree,
-            uint32_t expression,
-            std::string_view sv
-    ) {
-        std::set<std::string> tokens;
-        get_free_variables_in_expression_helper(tokens, tree, expression, sv);
-        return tokens;
-    }
+    // Interns variable names, open addressing over vectors so it also works during constant evaluation
+    class symbol_table {
+    public:
+        constexpr explicit symbol_table(std::pmr::memory_resource * resource) : slots_(resource), names_(resource) {}
 
-    void calculate_free_variables_for_scopes_helper(
-        parser::ast::tree const & tree,
-        uint32_t node,
-        uint32_t current_scope,
-        std::string_view sv,
-        std::map<uint32_t, std::set<std::string>> & frees,
-        std::set<std::string> & binded
-    ) {
-        auto process_expression = [&](uint32_t idx) {
-            auto free_expr = get_free_variables_in_expression(tree, idx, sv);
-            for (auto const & b : binded) {
-                free_expr.erase(b);
+        // id of the name, a new one if the name was not seen before
+        constexpr std::pair<uint32_t, bool> intern(std::string_view name) {
+            if ((names_.size() + 1) * 2 > slots_.size()) {
+                grow();
+            }
+            auto & id = slots_[find(name)];
+            if (id != NO_VARIABLE) {
+                return {id, false};
+            }
+            id = names_.size();
+            names_.push_back(name);
+            return {id, true};
+        }
+
+        [[nodiscard]]
+        constexpr uint32_t size() const {
+            return names_.size();
+        }
+
+    private:
+        static constexpr uint64_t hash(std::string_view name) { // FNV-1a
+            uint64_t h = 14695981039346656037ull;
+            for (auto c : name) {
+                h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+            }
+            return h;
+        }
+
+        // slot holding the name or the empty slot where it belongs
+        [[nodiscard]]
+        constexpr size_t find(std::string_view name) const {
+            auto mask = slots_.size() - 1;
+            auto slot = hash(name) & mask;
+            while (slots_[slot] != NO_VARIABLE && names_[slots_[slot]] != name) {
+                slot = (slot + 1) & mask;
+            }
+            return slot;
+        }
+
+        constexpr void grow() {
+            slots_.assign(std::max<size_t>(16, slots_.size() * 2), NO_VARIABLE);
+            for (uint32_t id = 0; id < names_.size(); ++id) {
+                slots_[find(names_[id])] = id;
+            }
+        }
+
+        memory::vector<uint32_t> slots_;
+        memory::vector<std::string_view> names_;
+    };
+
+    // A variable read in a loop is free in that loop and in the enclosing ones, up to the first scope
+    // in which the variable was bound before the read. An assignment pending at the end of a loop is
+    // used by the next iteration if its variable is free in the loop. Later reads use the assignment
+    // directly, so only the reads before it matter and the loop is known once the assignment is visited.
+    //
+    // Reads of every variable are kept as (time, top level it escapes to) with both increasing, so the
+    // innermost loop is found in amortized O(log depth) without materializing free variable sets.
+    class scope_analyzer : parser::ast::visitor<scope_analyzer> {
+    public:
+        constexpr scope_analyzer(parser::ast::tree const & tree, std::string_view sv, std::pmr::memory_resource * resource)
+            : visitor(tree)
+            , sv_(sv)
+            , result_{
+                .variables = memory::vector<uint32_t>(resource),
+                .reentries = memory::vector<uint16_t>(resource),
+                .loop_depths = memory::vector<uint32_t>(resource),
             }
-            frees[current_scope].insert(free_expr.begin(), free_expr.end());
+            , ids_(resource)
+            , bindings_(resource)
+            , reads_(resource)
+            , loops_(resource) {
+            result_.variables.assign(tree.size(), NO_VARIABLE);
+            result_.reentries.assign(tree.size(), parser::ast::tree::npos);
+            result_.loop_depths.assign(tree.size(), 0);
+            loops_.push_back({parser::ast::tree::npos, 0}); // top level
+        }
+
+        constexpr scopes run() && {
+            visit();
+            result_.variable_count = ids_.size();
+            return std::move(result_);
+        }
+
+    private:
+        friend visitor;
+
+        struct loop {
+            uint16_t node;
+            uint32_t entered;
+        };
+
+        struct binding {
+            uint32_t level;
+            uint32_t entered; // distinguishes loops at the same level
         };
 
-        repeat: switch (tree.get_kind(node)) {
-            case parser::ast::kind::IF: {
-                process_expression(tree.get_left(node));
-                node = tree.get_right(node);
-                goto repeat;
-            }
-            case parser::ast::kind::WHILE: {
-                frees[node] = get_free_variables_in_expression(tree, tree.get_left(node), sv);
-                std::set<std::string> new_binded;
-                calculate_free_variables_for_scopes_helper(
-                        tree, tree.get_right(node), node, sv, frees, new_binded);
-                for (auto const &f : frees[node]) {
-                    if (binded.find(f) == binded.end()) {
-                        frees[current_scope].insert(f);
-                    }
+        struct read {
+            uint32_t time;
+            uint32_t top;
+        };
+
+        constexpr void visit_if(uint16_t node) {
+            read_expression(tree_.get_left(node));
+            visit(tree_.get_right(node));
+        }
+
+        constexpr void visit_while(uint16_t node) {
+            loops_.push_back({node, ++time_});
+            result_.loop_depths[node] = depth();
+            result_.max_depth = std::max(result_.max_depth, depth());
+
+            read_expression(tree_.get_left(node)); // the condition is read on every iteration
+            visit(tree_.get_right(node));
+            loops_.pop_back();
+        }
+
+        constexpr void visit_assignment(uint16_t node) {
+            read_expression(tree_.get_right(node));
+            bind(tree_.get_left(node), node);
+        }
+
+        constexpr void read_expression(uint16_t expression) {
+            for_each_variable(tree_, expression, [this](uint16_t var_node) {
+                auto var = variable(var_node);
+                auto top = static_cast<uint32_t>(bound_level(var) + 1);
+
+                auto & reads = reads_[var];
+                while (!reads.empty() && reads.back().top >= top) {
+                    reads.pop_back(); // dominated by the newer read
+                }
+                reads.push_back({++time_, top});
+            });
+        }
+
+        constexpr void bind(uint16_t var_node, uint16_t assignment) {
+            auto var = variable(var_node);
+
+            auto & reads = reads_[var];
+            while (!reads.empty()) {
+                auto level = level_at(reads.back().time);
+                if (reads.back().top > level) {
+                    reads.pop_back(); // the loops it escapes to are finished
+                    continue;
+                }
+                if (level > 0) {
+                    result_.reentries[assignment] = loops_[level].node;
                 }
                 break;
             }
-            case parser::ast::kind::ASSIGNMENT: {
-                process_expression(tree.get_right(node));
-                binded.insert(std::string(tree.get_string(tree.get_left(node), sv)));
-                break;
+
+            if (bound_level(var) != static_cast<int64_t>(depth())) {
+                bindings_[var].push_back({depth(), loops_.back().entered});
             }
-            case parser::ast::kind::STATEMENTS: {
-                calculate_free_variables_for_scopes_helper(
-                        tree, tree.get_left(node), current_scope, sv, frees, binded);
-                node = tree.get_right(node);
-                goto repeat;
+        }
+
+        constexpr uint32_t variable(uint16_t var_node) {
+            auto [id, inserted] = ids_.intern(tree_.get_symbol(var_node, sv_));
+            if (inserted) {
+                bindings_.emplace_back(bindings_.get_allocator());
+                reads_.emplace_back(reads_.get_allocator());
             }
-            default:
-                break;
+            result_.variables[var_node] = id;
+            return id;
         }
-    }
 
-    std::map<uint32_t, std::set<std::string>> calculate_free_variables_for_scopes(
+        // innermost open level in which the variable is bound (-1 if none), drops bindings of finished loops
+        constexpr int64_t bound_level(uint32_t var) {
+            auto & bindings = bindings_[var];
+            while (!bindings.empty()
+                   && (bindings.back().level > depth() || loops_[bindings.back().level].entered != bindings.back().entered)) {
+                bindings.pop_back();
+            }
+            return bindings.empty() ? -1 : bindings.back().level;
+        }
+
+        // innermost open level entered before `time`
+        [[nodiscard]]
+        constexpr uint32_t level_at(uint32_t time) const {
+            auto it = std::upper_bound(loops_.begin(), loops_.end(), time, [](uint32_t t, loop const & l) {
+                return t < l.entered;
+            });
+            return (it - loops_.begin()) - 1;
+        }
+
+        [[nodiscard]]
+        constexpr uint32_t depth() const {
+            return loops_.size() - 1;
+        }
+
+        std::string_view sv_;
+        scopes result_;
+
+        symbol_table ids_;
+        memory::vector<memory::vector<binding>> bindings_;
+        memory::vector<memory::vector<read>> reads_;
+        memory::vector<loop> loops_;
+        uint32_t time_ = 0;
+    };
+
+    constexpr scopes calculate_free_variables_for_scopes(
         parser::ast::tree const & tree,
-        std::string_view sv
+        std::string_view sv,
+        std::pmr::memory_resource * resource = nullptr
     ) {
-        std::map<uint32_t, std::set<std::string>> frees;
-        std::set<std::string> binded;
-        calculate_free_variables_for_scopes_helper(tree, tree.get_root(), tree.get_root(), sv, frees, binded);
-        return frees;
+        trace::span span("free variables");
+        return scope_analyzer(tree, sv, resource).run();
     }
 
+    // Walks the statements in program order keeping the pending assignment of every variable,
+    // an assignment is unused once another one replaces it before any read
+    template <typename Result>
+    class unused_finder : parser::ast::visitor<unused_finder<Result>> {
+        using base = parser::ast::visitor<unused_finder<Result>>;
+        using base::tree_;
+        using base::visit;
 
-    void find_unused_assignments_helper(
-        parser::ast::tree const & tree,
-        uint32_t node,
-        std::map<uint32_t, std::set<std::string>> const & frees,
-        std::vector<uint32_t> & unused,
-        std::map<std::string, uint32_t> & pending,
-        std::string_view sv
-    ) {
-        repeat: switch (tree.get_kind(node)) {
-            case parser::ast::kind::IF: {
-                for (const auto & s : get_free_variables_in_expression(tree, tree.get_left(node), sv)) {
-                    pending.erase(std::string(s));
-                }
-                node = tree.get_right(node);
-                goto repeat;
+    public:
+        constexpr unused_finder(parser::ast::tree const & tree, scopes const & scopes, Result & unused, std::pmr::memory_resource * resource)
+            : base(tree)
+            , scopes_(scopes)
+            , unused_(unused)
+            , pending_(scopes.variable_count, parser::ast::tree::npos, resource)
+            , reentering_(resource) {
+            for (uint32_t level = 0; level <= scopes.max_depth; ++level) {
+                reentering_.emplace_back(resource);
             }
-            case parser::ast::kind::WHILE: {
-                for (const auto & s : get_free_variables_in_expression(tree, tree.get_left(node), sv)) {
-                    pending.erase(std::string(s));
-                }
-                find_unused_assignments_helper(tree, tree.get_right(node), frees, unused, pending, sv);
-                for (const auto & s : frees.at(node)) {
-                    pending.erase(s);
+        }
+
+        constexpr void run() && {
+            trace::span span("unused detection");
+            visit();
+            for (auto idx : pending_) {
+                if (idx != parser::ast::tree::npos) {
+                    unused_.push_back(idx);
                 }
-                break;
             }
-            case parser::ast::kind::ASSIGNMENT: {
-                std::string var(tree.get_string(tree.get_left(node), sv));
-                auto it = pending.find(var);
-                if (it != pending.end()) {
-                    unused.push_back(it->second);
-                }
-                for (const auto &s : get_free_variables_in_expression(tree, tree.get_right(node), sv)) {
-                    pending.erase(std::string(s));
+        }
+
+    private:
+        friend base;
+
+        constexpr void visit_if(uint16_t node) {
+            read_expression(tree_.get_left(node));
+            visit(tree_.get_right(node));
+        }
+
+        constexpr void visit_while(uint16_t node) {
+            read_expression(tree_.get_left(node));
+            visit(tree_.get_right(node));
+
+            auto & reentering = reentering_[scopes_.loop_depths[node]];
+            for (auto assignment : reentering) {
+                auto & pending = pending_[scopes_.variables[tree_.get_left(assignment)]];
+                if (pending == assignment) {
+                    pending = parser::ast::tree::npos;
                 }
-                pending[var] = node;
-                break;
             }
-            case parser::ast::kind::STATEMENTS: {
-                find_unused_assignments_helper(tree, tree.get_left(node), frees, unused, pending, sv);
-                node = tree.get_right(node);
-                goto repeat;
+            reentering.clear();
+        }
+
+        constexpr void visit_assignment(uint16_t node) {
+            read_expression(tree_.get_right(node));
+
+            auto & pending = pending_[scopes_.variables[tree_.get_left(node)]];
+            if (pending != parser::ast::tree::npos) {
+                unused_.push_back(pending);
             }
-            default:
-                break;
+            pending = node;
+
+            if (auto loop = scopes_.reentries[node]; loop != parser::ast::tree::npos) {
+                reentering_[scopes_.loop_depths[loop]].push_back(node);
+            }
+        }
+
+        constexpr void read_expression(uint16_t expression) {
+            for_each_variable(tree_, expression, [this](uint16_t var_node) {
+                pending_[scopes_.variables[var_node]] = parser::ast::tree::npos;
+            });
+        }
+
+        scopes const & scopes_;
+        Result & unused_;
+        memory::vector<uint16_t> pending_;                     // pending assignment of every variable
+        memory::vector<memory::vector<uint16_t>> reentering_;  // assignments used by the next iteration of the open loop at each level
+    };
+
+    // Appends the unused assignments to `unused`, all intermediate state is allocated from `resource`
+    template <typename Recorder, typename Result>
+    constexpr void find_unused_assignments(
+        parser::ast::tree const & tree,
+        std::string_view sv,
+        Recorder & recorder,
+        std::pmr::memory_resource * resource,
+        Result & unused
+    ) {
+        scopes scopes;
+        {
+            [[maybe_unused]] auto scope = recorder.measure(stats::FREE_VARIABLES);
+            scopes = calculate_free_variables_for_scopes(tree, sv, resource);
+        }
+
+        [[maybe_unused]] auto scope = recorder.measure(stats::UNUSED_DETECTION);
+        if (tree.empty()) {
+            return;
         }
+
+        unused_finder(tree, scopes, unused, resource).run();
     }
 
 }
 
-std::vector<uint32_t> find_unused_assignments(
+constexpr std::vector<uint32_t> find_unused_assignments(
     parser::ast::tree const & tree,
     std::string_view sv
 ) {
+    stats::disabled recorder;
     std::vector<uint32_t> unused;
-    std::map<std::string, uint32_t> pending;
-    auto frees = detail::calculate_free_variables_for_scopes(tree, sv);
-    detail::find_unused_assignments_helper(tree, tree.get_root(), frees, unused, pending, sv);
-    for (auto const & [_, idx] : pending) {
-        unused.push_back(idx);
-    }
+    detail::find_unused_assignments(tree, sv, recorder, nullptr, unused);
+    return unused;
+}
+
+// Same as `find_unused_assignments`, also fills analysis statistics; the analysis state comes from
+// `stats::counting_heap` so that its allocations are counted
+inline std::vector<uint32_t> find_unused_assignments(
+    parser::ast::tree const & tree,
+    std::string_view sv,
+    stats::pipeline_stats & statistics
+) {
+    stats::recorder recorder(statistics);
+    std::vector<uint32_t> unused;
+    detail::find_unused_assignments(tree, sv, recorder, stats::counting_heap(), unused);
+    return unused;
+}
+
+// Same as `find_unused_assignments`, the result and all analysis state are allocated from `resource`
+inline memory::vector<uint32_t> find_unused_assignments(
+    parser::ast::tree const & tree,
+    std::string_view sv,
+    std::pmr::memory_resource * resource
+) {
+    stats::disabled recorder;
+    memory::vector<uint32_t> unused(resource);
+    detail::find_unused_assignments(tree, sv, recorder, resource, unused);
     return unused;
 }
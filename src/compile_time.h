@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include "analyze.h"
+#include "parser.h"
+
+namespace parser {
+
+    // String literal usable as a template argument, parse_ct<"x = 1">()
+    template <size_t N>
+    struct fixed_string {
+        char data[N]{};
+
+        constexpr fixed_string(char const (&str)[N]) {
+            std::copy_n(str, N, data);
+        }
+
+        [[nodiscard]]
+        constexpr std::string_view view() const {
+            return {data, N - 1};
+        }
+    };
+
+    namespace ast {
+
+        // Tree with its nodes stored inline, so a tree computed during constant evaluation
+        // can be kept in a constexpr variable. Same indices and accessors as `tree`.
+        template <size_t CAPACITY>
+        class static_tree {
+            struct node {
+                kind type{};
+                uint16_t op1 = tree::npos;
+                uint16_t op2 = tree::npos;
+                uint16_t par = tree::npos;
+
+                uint32_t start_pos = 0;
+                uint32_t end_pos = 0;
+
+                lexer::operator_type op_type = lexer::operator_type::UNDEFINED;
+            };
+
+        public:
+            static constexpr uint16_t npos = tree::npos;
+
+            constexpr static_tree(tree const & t, std::string_view sv) : size_(t.size()), root_(t.get_root()), source_(sv) {
+                for (uint16_t idx = 0; idx < size_; ++idx) {
+                    auto [start, end] = t.get_range(idx);
+                    nodes_[idx] = node{
+                        .type = t.get_kind(idx),
+                        .op1 = t.get_left(idx),
+                        .op2 = t.get_right(idx),
+                        .par = t.get_parent(idx),
+                        .start_pos = start,
+                        .end_pos = end,
+                        .op_type = t.get_operator_type(idx),
+                    };
+                }
+            }
+
+            [[nodiscard]]
+            constexpr uint16_t get_root() const {
+                return root_;
+            }
+
+            [[nodiscard]]
+            constexpr uint16_t get_left(uint16_t idx) const {
+                return nodes_[idx].op1;
+            }
+
+            [[nodiscard]]
+            constexpr uint16_t get_right(uint16_t idx) const {
+                return nodes_[idx].op2;
+            }
+
+            [[nodiscard]]
+            constexpr uint16_t get_parent(uint16_t idx) const {
+                return nodes_[idx].par;
+            }
+
+            [[nodiscard]]
+            constexpr lexer::operator_type get_operator_type(uint16_t idx) const {
+                return nodes_[idx].op_type;
+            }
+
+            [[nodiscard]]
+            constexpr kind get_kind(uint16_t idx) const {
+                return nodes_[idx].type;
+            }
+
+            [[nodiscard]]
+            constexpr std::pair<uint32_t, uint32_t> get_range(uint16_t idx) const {
+                return {nodes_[idx].start_pos, nodes_[idx].end_pos};
+            }
+
+            [[nodiscard]]
+            constexpr std::string_view get_string(uint16_t idx) const {
+                auto [from, to] = get_range(idx);
+                return source_.substr(from, to - from);
+            }
+
+            [[nodiscard]]
+            constexpr std::string_view source() const {
+                return source_;
+            }
+
+            [[nodiscard]]
+            constexpr uint16_t size() const {
+                return size_;
+            }
+
+            // runtime tree with the same nodes, no parsing involved
+            [[nodiscard]]
+            constexpr tree to_tree() const {
+                tree result;
+                builder b(result);
+                for (uint16_t idx = 0; idx < size_; ++idx) {
+                    auto const & n = nodes_[idx];
+                    if (n.type == kind::BINOP) {
+                        b.new_node_binop(n.op_type, n.start_pos, n.end_pos);
+                    } else if (n.type == kind::UNOP) {
+                        b.new_node_unop(n.op_type, n.start_pos, n.end_pos);
+                    } else {
+                        b.new_node(n.type, n.start_pos, n.end_pos);
+                    }
+                }
+                for (uint16_t idx = 0; idx < size_; ++idx) {
+                    if (nodes_[idx].op1 != npos) {
+                        b.set_left(idx, nodes_[idx].op1);
+                    }
+                    if (nodes_[idx].op2 != npos) {
+                        b.set_right(idx, nodes_[idx].op2);
+                    }
+                }
+                b.set_root(root_);
+                return result;
+            }
+
+        private:
+            std::array<node, CAPACITY> nodes_{};
+            uint16_t size_;
+            uint16_t root_;
+            std::string_view source_;
+        };
+
+    }
+
+    namespace detail {
+        // Not constexpr: reaching it during constant evaluation turns a syntax error into a compile error
+        inline void syntax_error_in_compile_time_source(char const * /* cause */, uint32_t /* pos */) {}
+
+        constexpr ast::tree parse_or_fail(std::string_view sv) {
+            auto result = parser::parse(sv);
+            if (auto error = std::get_if<lexer::error>(&result)) {
+                syntax_error_in_compile_time_source(error->cause, error->pos);
+            }
+            return std::get<ast::tree>(std::move(result));
+        }
+    }
+
+    // Parses SOURCE during compilation, the tree is sized to exactly fit it
+    template <fixed_string SOURCE>
+    consteval auto parse_ct() {
+        constexpr size_t size = detail::parse_or_fail(SOURCE.view()).size();
+        return ast::static_tree<size>(detail::parse_or_fail(SOURCE.view()), SOURCE.view());
+    }
+
+}
+
+// True if the source parses and every assignment is used, usable in static_assert
+constexpr bool no_unused_assignments(std::string_view sv) {
+    auto result = parser::parse(sv);
+    auto tree = std::get_if<parser::ast::tree>(&result);
+    return tree && find_unused_assignments(*tree, sv).empty();
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "parser.h"
+
+namespace dataflow {
+
+    class def_use_chains;
+
+    namespace detail {
+        class reaching_definitions;
+    }
+
+    // Def-use and use-def chains in CSR form. Uses of an ASSIGNMENT are the VAR nodes
+    // (in expressions) it reaches, definitions of a VAR node are the ASSIGNMENTs reaching it.
+    class def_use_chains {
+    public:
+        [[nodiscard]]
+        std::span<uint16_t const> get_uses(uint16_t assignment) const {
+            return {uses_.data() + use_offsets_[assignment], uses_.data() + use_offsets_[assignment + 1]};
+        }
+
+        [[nodiscard]]
+        std::span<uint16_t const> get_definitions(uint16_t var) const {
+            return {defs_.data() + def_offsets_[var], defs_.data() + def_offsets_[var + 1]};
+        }
+
+    private:
+        std::vector<uint32_t> use_offsets_;
+        std::vector<uint16_t> uses_;
+        std::vector<uint32_t> def_offsets_;
+        std::vector<uint16_t> defs_;
+
+        friend class detail::reaching_definitions;
+    };
+
+    namespace detail {
+
+        using definitions = std::vector<uint16_t>; // sorted
+        using generated = std::map<uint32_t, definitions>;
+
+        inline void merge_into(definitions & to, definitions const & from) {
+            definitions merged;
+            merged.reserve(to.size() + from.size());
+            std::set_union(to.begin(), to.end(), from.begin(), from.end(), std::back_inserter(merged));
+            to = std::move(merged);
+        }
+
+        // Structured reaching definitions. For a compound statement with body B the state after it is
+        // `before ∪ gen(B)` where gen(B) are the definitions in B reaching its end; gen is memoized per
+        // compound statement, so every node is visited once by the summary walk and once by the main walk.
+        class reaching_definitions {
+        public:
+            reaching_definitions(parser::ast::tree const & tree, std::string_view sv)
+                : tree_(tree), sv_(sv), summaries_(tree.size()), computed_(tree.size(), false) {}
+
+            def_use_chains build() {
+                walk(tree_.get_root());
+
+                def_use_chains chains;
+                to_csr(chains.use_offsets_, chains.uses_, [](auto const & p) { return p.first; }, [](auto const & p) { return p.second; });
+                to_csr(chains.def_offsets_, chains.defs_, [](auto const & p) { return p.second; }, [](auto const & p) { return p.first; });
+                return chains;
+            }
+
+        private:
+            uint32_t variable_id(uint16_t var) {
+                auto [it, inserted] = variables_.try_emplace(tree_.get_symbol(var, sv_), variables_.size());
+                if (inserted) {
+                    state_.emplace_back();
+                }
+                return it->second;
+            }
+
+            void set(uint32_t var, definitions defs) {
+                if (depth_) {
+                    journal_.emplace_back(var, std::move(state_[var]));
+                }
+                state_[var] = std::move(defs);
+            }
+
+            void add(generated const & gen) {
+                for (auto const & [var, defs] : gen) {
+                    auto merged = state_[var];
+                    merge_into(merged, defs);
+                    set(var, std::move(merged));
+                }
+            }
+
+            void undo(size_t mark) {
+                while (journal_.size() > mark) {
+                    state_[journal_.back().first] = std::move(journal_.back().second);
+                    journal_.pop_back();
+                }
+            }
+
+            void record_uses(uint16_t expression) {
+                sw: switch (tree_.get_kind(expression)) {
+                    case parser::ast::kind::VAR: {
+                        for (auto def : state_[variable_id(expression)]) {
+                            pairs_.emplace_back(def, expression);
+                        }
+                        break;
+                    }
+                    case parser::ast::kind::BINOP: {
+                        record_uses(tree_.get_left(expression));
+                        expression = tree_.get_right(expression);
+                        goto sw;
+                    }
+                    case parser::ast::kind::UNOP: {
+                        expression = tree_.get_left(expression);
+                        goto sw;
+                    }
+                    default:
+                        break;
+                }
+            }
+
+            generated const & summary(uint16_t compound) {
+                if (!computed_[compound]) {
+                    summarize(tree_.get_right(compound), summaries_[compound]);
+                    computed_[compound] = true;
+                }
+                return summaries_[compound];
+            }
+
+            void summarize(uint16_t node, generated & gen) {
+                repeat: switch (tree_.get_kind(node)) {
+                    case parser::ast::kind::IF:
+                    case parser::ast::kind::WHILE: {
+                        for (auto const & [var, defs] : summary(node)) {
+                            merge_into(gen[var], defs);
+                        }
+                        break;
+                    }
+                    case parser::ast::kind::ASSIGNMENT: {
+                        gen[variable_id(tree_.get_left(node))] = {node};
+                        break;
+                    }
+                    case parser::ast::kind::STATEMENTS: {
+                        summarize(tree_.get_left(node), gen);
+                        node = tree_.get_right(node);
+                        goto repeat;
+                    }
+                    default:
+                        break;
+                }
+            }
+
+            void walk(uint16_t node) {
+                repeat: switch (tree_.get_kind(node)) {
+                    case parser::ast::kind::IF:
+                    case parser::ast::kind::WHILE: {
+                        auto const & gen = summary(node);
+                        bool loop = tree_.get_kind(node) == parser::ast::kind::WHILE;
+
+                        if (loop) {
+                            add(gen); // loop head is reached from the body end too
+                        }
+                        record_uses(tree_.get_left(node));
+
+                        ++depth_;
+                        auto mark = journal_.size();
+                        walk(tree_.get_right(node));
+                        undo(mark);
+                        --depth_;
+
+                        if (!loop) {
+                            add(gen);
+                        }
+                        break;
+                    }
+                    case parser::ast::kind::ASSIGNMENT: {
+                        record_uses(tree_.get_right(node));
+                        set(variable_id(tree_.get_left(node)), {node});
+                        break;
+                    }
+                    case parser::ast::kind::STATEMENTS: {
+                        walk(tree_.get_left(node));
+                        node = tree_.get_right(node);
+                        goto repeat;
+                    }
+                    default:
+                        break;
+                }
+            }
+
+            // counting sort of (definition, use) pairs by `key`
+            template <typename Key, typename Value>
+            void to_csr(std::vector<uint32_t> & offsets, std::vector<uint16_t> & values, Key key, Value value) const {
+                offsets.assign(tree_.size() + 1, 0);
+                for (auto const & p : pairs_) {
+                    ++offsets[key(p) + 1];
+                }
+                for (size_t idx = 1; idx < offsets.size(); ++idx) {
+                    offsets[idx] += offsets[idx - 1];
+                }
+
+                values.resize(pairs_.size());
+                auto fill = offsets;
+                for (auto const & p : pairs_) {
+                    values[fill[key(p)]++] = value(p);
+                }
+            }
+
+            parser::ast::tree const & tree_;
+            std::string_view sv_;
+
+            std::map<std::string_view, uint32_t> variables_;
+            std::vector<definitions> state_;
+            std::vector<std::pair<uint32_t, definitions>> journal_;
+            uint32_t depth_ = 0;
+
+            std::vector<generated> summaries_;
+            std::vector<char> computed_;
+
+            std::vector<std::pair<uint16_t, uint16_t>> pairs_; // (definition, use)
+        };
+
+    }
+
+    inline def_use_chains build_def_use_chains(parser::ast::tree const & tree, std::string_view sv) {
+        return detail::reaching_definitions(tree, sv).build();
+    }
+
+}
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "analyze.h"
+#include "location.h"
+#include "parser.h"
+#include "stats.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+namespace driver {
+
+    // Read-only private mapping of a whole file
+    class mapped_file {
+    public:
+        explicit mapped_file(std::string const & path) {
+            fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd_ < 0) {
+                error_ = errno;
+                return;
+            }
+
+            struct stat st{};
+            if (::fstat(fd_, &st) != 0) {
+                error_ = errno;
+                return;
+            }
+
+            size_ = st.st_size;
+            if (size_ == 0) {
+                return;
+            }
+
+            auto data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+            if (data == MAP_FAILED) {
+                error_ = errno;
+                size_ = 0;
+                return;
+            }
+            data_ = static_cast<char const *>(data);
+            ::madvise(data, size_, MADV_SEQUENTIAL);
+        }
+
+        mapped_file(mapped_file const &) = delete;
+        mapped_file & operator=(mapped_file const &) = delete;
+
+        ~mapped_file() {
+            if (data_) {
+                ::munmap(const_cast<char *>(data_), size_);
+            }
+            if (fd_ >= 0) {
+                ::close(fd_);
+            }
+        }
+
+        // errno of the failed call, 0 on success
+        [[nodiscard]]
+        int error() const {
+            return error_;
+        }
+
+        [[nodiscard]]
+        std::string_view contents() const {
+            return {data_, size_};
+        }
+
+    private:
+        int fd_ = -1;
+        int error_ = 0;
+        char const * data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    struct unused_assignment {
+        location::span where;
+        std::string text;
+    };
+
+    struct file_result {
+        std::string error;    // empty on success
+        location::position error_position{0, 0};
+        std::vector<unused_assignment> unused; // in source order
+        uint64_t bytes = 0;
+        stats::pipeline_stats statistics;
+    };
+
+    struct summary {
+        uint64_t files = 0;
+        uint64_t failed = 0;
+        uint64_t bytes = 0;
+        uint64_t unused = 0;
+        std::chrono::nanoseconds wall{0};
+        std::array<std::chrono::nanoseconds, stats::PHASE_COUNT> phases{}; // summed over workers
+    };
+
+    // Expands directories recursively (entries sorted by path) and appends the paths listed in `file_list`
+    // ("-" is stdin), keeping the order of the arguments, so results come out in a deterministic order
+    inline std::vector<std::string> collect_inputs(std::vector<std::string> const & paths, std::istream * file_list) {
+        std::vector<std::string> inputs;
+
+        for (auto const & path : paths) {
+            std::error_code ec;
+            if (!std::filesystem::is_directory(path, ec)) {
+                inputs.push_back(path);
+                continue;
+            }
+
+            auto first = inputs.size();
+            for (auto const & entry : std::filesystem::recursive_directory_iterator(path, ec)) {
+                if (entry.is_regular_file(ec)) {
+                    inputs.push_back(entry.path().string());
+                }
+            }
+            std::sort(inputs.begin() + first, inputs.end());
+        }
+
+        if (file_list) {
+            std::string line;
+            while (std::getline(*file_list, line)) {
+                if (!line.empty()) {
+                    inputs.push_back(line);
+                }
+            }
+        }
+        return inputs;
+    }
+
+    inline file_result process(std::string_view source) {
+        file_result result;
+        result.bytes = source.size();
+
+        auto parsed = parser::parse(source, result.statistics);
+        if (auto err = std::get_if<lexer::error>(&parsed)) {
+            result.error = err->cause;
+            result.error_position = location::line_index(source).get_position(err->pos);
+            return result;
+        }
+
+        auto const & tree = std::get<parser::ast::tree>(parsed);
+        auto unused = find_unused_assignments(tree, source, result.statistics);
+        std::sort(unused.begin(), unused.end(), [&](uint32_t l, uint32_t r) {
+            return tree.get_range(l).first < tree.get_range(r).first;
+        });
+
+        location::line_index lines(source);
+        for (auto idx : unused) {
+            result.unused.push_back({lines.get_span(tree, idx), std::string(tree.get_string(idx, source))});
+        }
+        return result;
+    }
+
+    inline file_result process_file(std::string const & path) {
+        trace::span span("file");
+        std::optional<mapped_file> file;
+        {
+            trace::span read("read");
+            file.emplace(path);
+        }
+        if (file->error()) {
+            file_result result;
+            result.error = std::strerror(file->error());
+            return result;
+        }
+        return process(file->contents());
+    }
+
+    // Results are indexed like `inputs` whatever order the workers finish in, so are the file ids of trace spans
+    inline std::vector<file_result> run(concurrency::work_stealing_pool & pool, std::vector<std::string> const & inputs) {
+        std::vector<file_result> results(inputs.size());
+        concurrency::parallel_for(pool, inputs.size(), [&](size_t idx) {
+            trace::file_scope file(idx);
+            results[idx] = process_file(inputs[idx]);
+        });
+        return results;
+    }
+
+    inline summary summarize(std::vector<file_result> const & results, std::chrono::nanoseconds wall) {
+        summary s;
+        s.wall = wall;
+        for (auto const & result : results) {
+            ++s.files;
+            s.failed += !result.error.empty();
+            s.bytes += result.bytes;
+            s.unused += result.unused.size();
+            for (size_t phase = 0; phase < stats::PHASE_COUNT; ++phase) {
+                s.phases[phase] += result.statistics.phases[phase].time;
+            }
+        }
+        return s;
+    }
+
+    namespace detail {
+
+        inline void append_json_string(std::string & out, std::string_view str) {
+            out.push_back('"');
+            for (unsigned char c : str) {
+                switch (c) {
+                    case '"': out += "\\\""; break;
+                    case '\\': out += "\\\\"; break;
+                    case '\n': out += "\\n"; break;
+                    case '\r': out += "\\r"; break;
+                    case '\t': out += "\\t"; break;
+                    default:
+                        if (c < 0x20) {
+                            constexpr char HEX[] = "0123456789abcdef";
+                            out += "\\u00";
+                            out.push_back(HEX[c >> 4]);
+                            out.push_back(HEX[c & 15]);
+                        } else {
+                            out.push_back(static_cast<char>(c));
+                        }
+                }
+            }
+            out.push_back('"');
+        }
+
+        inline void append_number(std::string & out, uint64_t value) {
+            char buf[24];
+            auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+            out.append(buf, end);
+        }
+
+        inline void append_position(std::string & out, location::position pos) {
+            append_number(out, pos.line);
+            out.push_back(':');
+            append_number(out, pos.column);
+        }
+
+    }
+
+    // path:line:column: message, one line per finding
+    inline void write_text(std::string & out, std::string_view path, file_result const & result) {
+        if (!result.error.empty()) {
+            out += path;
+            out.push_back(':');
+            if (result.error_position.line) {
+                detail::append_position(out, result.error_position);
+                out.push_back(':');
+            }
+            out += " error: ";
+            out += result.error;
+            out.push_back('\n');
+            return;
+        }
+
+        for (auto const & u : result.unused) {
+            out += path;
+            out.push_back(':');
+            detail::append_position(out, u.where.begin);
+            out += ": unused assignment: ";
+            out += u.text;
+            out.push_back('\n');
+        }
+    }
+
+    // One JSON object per file and line
+    inline void write_json(std::string & out, std::string_view path, file_result const & result) {
+        out += "{\"file\":";
+        detail::append_json_string(out, path);
+
+        out += ",\"error\":";
+        if (result.error.empty()) {
+            out += "null";
+        } else {
+            out += "{\"cause\":";
+            detail::append_json_string(out, result.error);
+            out += ",\"line\":";
+            detail::append_number(out, result.error_position.line);
+            out += ",\"column\":";
+            detail::append_number(out, result.error_position.column);
+            out.push_back('}');
+        }
+
+        out += ",\"unused\":[";
+        for (size_t idx = 0; idx < result.unused.size(); ++idx) {
+            auto const & u = result.unused[idx];
+            out += idx ? ",{\"line\":" : "{\"line\":";
+            detail::append_number(out, u.where.begin.line);
+            out += ",\"column\":";
+            detail::append_number(out, u.where.begin.column);
+            out += ",\"text\":";
+            detail::append_json_string(out, u.text);
+            out.push_back('}');
+        }
+        out += "]}\n";
+    }
+
+    inline void write_summary(std::ostream & out, summary const & s) {
+        constexpr char const * PHASE_NAMES[stats::PHASE_COUNT] = {"lex", "parse", "free variables", "unused detection"};
+
+        auto seconds = std::chrono::duration<double>(s.wall).count();
+        auto megabytes = static_cast<double>(s.bytes) / (1 << 20);
+        out << "files: " << s.files << " (" << s.failed << " failed), "
+            << "bytes: " << s.bytes << ", unused assignments: " << s.unused << '\n'
+            << "wall: " << seconds * 1e3 << " ms, "
+            << (seconds > 0 ? megabytes / seconds : 0) << " MB/s, "
+            << (seconds > 0 ? s.files / seconds : 0) << " files/s\n";
+        for (size_t phase = 0; phase < stats::PHASE_COUNT; ++phase) {
+            out << "  " << PHASE_NAMES[phase] << ": "
+                << std::chrono::duration<double, std::milli>(s.phases[phase]).count() << " ms\n";
+        }
+    }
+
+}
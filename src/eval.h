@@ -0,0 +1,575 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "parser.h"
+#include "semantics.h"
+#include "visitor.h"
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// Evaluation of programs over many environments (initial values of the variables).
+// A program is compiled once to a register code; `run` executes it for one environment,
+// the batch `run` executes it for a whole table, several environments per vector instruction.
+namespace eval {
+
+    using semantics::value;
+
+    constexpr uint32_t npos = -1;
+
+    // bound on the condition tests of one run, a program may loop forever
+    constexpr uint64_t DEFAULT_MAX_TESTS = uint64_t(1) << 32;
+
+    enum class opcode : uint8_t {
+        BINARY, // dst = lhs op rhs
+        PREFIX, // dst = op lhs
+        ASSIGN, // dst = lhs, dst is a variable
+        ENTER,  // an if or a while starts, the running environments are saved
+        TEST,   // environments where lhs is false stop running; when none is left, restores them and goes to dst
+        LEAVE,  // an if body ends, restores the saved environments
+        JUMP,   // goes to dst, back to the condition of a while
+    };
+
+    struct instruction {
+        opcode code;
+        lexer::operator_type op = lexer::UNDEFINED;
+        uint32_t dst = 0;
+        uint32_t lhs = 0;
+        uint32_t rhs = 0;
+    };
+
+    // Register code of a program. Registers are the variables in order of first appearance,
+    // then the distinct constants, then the temporaries of expressions.
+    class program {
+    public:
+        [[nodiscard]]
+        uint32_t variable_count() const {
+            return names_.size();
+        }
+
+        [[nodiscard]]
+        std::string_view variable_name(uint32_t var) const {
+            return names_[var];
+        }
+
+        // npos if the program has no such variable
+        [[nodiscard]]
+        uint32_t find_variable(std::string_view name) const {
+            auto found = std::find(names_.begin(), names_.end(), name);
+            return found == names_.end() ? npos : found - names_.begin();
+        }
+
+        [[nodiscard]]
+        uint32_t register_count() const {
+            return registers_;
+        }
+
+        // values of the registers following the variables
+        [[nodiscard]]
+        std::span<value const> constants() const {
+            return constants_;
+        }
+
+        [[nodiscard]]
+        std::span<instruction const> code() const {
+            return code_;
+        }
+
+        // deepest nesting of if and while
+        [[nodiscard]]
+        uint32_t max_depth() const {
+            return max_depth_;
+        }
+
+        // size of the tree the program was compiled from
+        [[nodiscard]]
+        uint16_t node_count() const {
+            return nodes_;
+        }
+
+        // statement node every instruction belongs to: conditions and jumps to their if or while,
+        // expressions to their assignment
+        [[nodiscard]]
+        std::span<uint16_t const> owners() const {
+            return owners_;
+        }
+
+    private:
+        std::vector<std::string> names_;
+        std::vector<value> constants_;
+        std::vector<instruction> code_;
+        std::vector<uint16_t> owners_;
+        uint32_t registers_ = 0;
+        uint32_t max_depth_ = 0;
+        uint16_t nodes_ = 0;
+
+        friend class compiler;
+    };
+
+    class compiler : parser::ast::visitor<compiler> {
+    public:
+        compiler(parser::ast::tree const & tree, std::string_view sv) : visitor(tree), sv_(sv), registers_(tree.size(), npos) {
+            std::unordered_map<std::string_view, uint32_t> variables;
+            std::unordered_map<value, uint32_t> constants;
+            for (auto node : parser::ast::preorder(tree)) {
+                if (tree.get_kind(node) == parser::ast::kind::VAR) {
+                    auto [it, added] = variables.emplace(tree.get_symbol(node, sv), variables.size());
+                    if (added) {
+                        out_.names_.emplace_back(it->first);
+                    }
+                    registers_[node] = it->second;
+                }
+            }
+            for (auto node : parser::ast::preorder(tree)) {
+                if (tree.get_kind(node) == parser::ast::kind::CONST) {
+                    auto v = semantics::parse_constant(tree.get_symbol(node, sv));
+                    auto [it, added] = constants.emplace(v, variables.size() + constants.size());
+                    if (added) {
+                        out_.constants_.push_back(v);
+                    }
+                    registers_[node] = it->second;
+                }
+            }
+            temporaries_ = out_.registers_ = variables.size() + constants.size();
+            out_.nodes_ = tree.size();
+        }
+
+        program run() && {
+            visit();
+            return std::move(out_);
+        }
+
+    private:
+        friend visitor;
+
+        void visit_if(uint16_t node) {
+            auto outer = std::exchange(owner_, node);
+            enter();
+            auto test = emit({.code = opcode::TEST, .lhs = expression(tree_.get_left(node), temporaries_)});
+            visit(tree_.get_right(node));
+            owner_ = node;
+            emit({.code = opcode::LEAVE});
+            owner_ = outer;
+            out_.code_[test].dst = out_.code_.size();
+            --depth_;
+        }
+
+        void visit_while(uint16_t node) {
+            auto outer = std::exchange(owner_, node);
+            enter();
+            uint32_t condition = out_.code_.size();
+            auto test = emit({.code = opcode::TEST, .lhs = expression(tree_.get_left(node), temporaries_)});
+            visit(tree_.get_right(node));
+            owner_ = node;
+            emit({.code = opcode::JUMP, .dst = condition});
+            owner_ = outer;
+            out_.code_[test].dst = out_.code_.size();
+            --depth_;
+        }
+
+        void visit_assignment(uint16_t node) {
+            auto outer = std::exchange(owner_, node);
+            auto source = expression(tree_.get_right(node), temporaries_);
+            emit({.code = opcode::ASSIGN, .dst = registers_[tree_.get_left(node)], .lhs = source});
+            owner_ = outer;
+        }
+
+        void enter() {
+            emit({.code = opcode::ENTER});
+            out_.max_depth_ = std::max(out_.max_depth_, ++depth_);
+        }
+
+        // register holding the value of `node`, temporaries from `temporary` on are free to use
+        uint32_t expression(uint16_t node, uint32_t temporary) {
+            switch (tree_.get_kind(node)) {
+                case parser::ast::kind::VAR:
+                case parser::ast::kind::CONST:
+                    return registers_[node];
+                case parser::ast::kind::UNOP: {
+                    auto operand = expression(tree_.get_left(node), temporary);
+                    emit({.code = opcode::PREFIX, .op = tree_.get_operator_type(node), .dst = temporary, .lhs = operand});
+                    break;
+                }
+                default: {
+                    auto lhs = expression(tree_.get_left(node), temporary);
+                    auto rhs = expression(tree_.get_right(node), temporary + 1);
+                    emit({.code = opcode::BINARY, .op = tree_.get_operator_type(node), .dst = temporary, .lhs = lhs, .rhs = rhs});
+                    break;
+                }
+            }
+            out_.registers_ = std::max(out_.registers_, temporary + 1);
+            return temporary;
+        }
+
+        uint32_t emit(instruction i) {
+            out_.code_.push_back(i);
+            out_.owners_.push_back(owner_);
+            return out_.code_.size() - 1;
+        }
+
+        std::string_view sv_;
+        std::vector<uint32_t> registers_; // of VAR and CONST nodes
+        uint32_t temporaries_;
+        uint32_t depth_ = 0;
+        uint16_t owner_ = parser::ast::tree::npos;
+        program out_;
+    };
+
+    inline program compile(parser::ast::tree const & tree, std::string_view sv) {
+        return compiler(tree, sv).run();
+    }
+
+    // Where the time of runs went, by node of the tree the program was compiled from; only IF, WHILE
+    // and ASSIGNMENT nodes get entries. Accumulates over all the runs it is passed to.
+    struct profile {
+        explicit profile(program const & p) : counts(p.node_count()), cycles(p.node_count()) {}
+
+        std::vector<uint64_t> counts; // executions, an if or a while counts once however often it loops
+        std::vector<uint64_t> cycles; // spent in the node itself, not in the statements of its body
+    };
+
+    namespace detail {
+
+        // time stamp counter where there is one, nanoseconds elsewhere
+        inline uint64_t cycles() {
+        #if defined(__x86_64__)
+            return __rdtsc();
+        #else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        #endif
+        }
+
+        // Profiler which is passed when no profile is requested, every call compiles to nothing
+        struct no_profiler {
+            constexpr void step(uint32_t) {}
+            constexpr void count(uint32_t) {}
+            constexpr void finish() {}
+        };
+
+        // Charges the cycles between two reads of the counter to the statement that was running.
+        // The counter is only read when the running statement changes, not on every instruction.
+        class profiler {
+        public:
+            profiler(program const & p, profile & out) : owners_(p.owners()), out_(out) {}
+
+            void step(uint32_t pc) {
+                if (owners_[pc] != current_) {
+                    auto now = cycles();
+                    if (current_ != parser::ast::tree::npos) {
+                        out_.cycles[current_] += now - last_;
+                    }
+                    last_ = now;
+                    current_ = owners_[pc];
+                }
+            }
+
+            void count(uint32_t pc) {
+                ++out_.counts[owners_[pc]];
+            }
+
+            void finish() {
+                if (current_ != parser::ast::tree::npos) {
+                    out_.cycles[current_] += cycles() - last_;
+                }
+            }
+
+        private:
+            std::span<uint16_t const> owners_;
+            profile & out_;
+            uint16_t current_ = parser::ast::tree::npos;
+            uint64_t last_ = 0;
+        };
+
+        template <typename Profiler>
+        bool run(program const & p, std::span<value> variables, uint64_t max_tests, Profiler & profiler) {
+            std::vector<value> registers(p.register_count());
+            std::copy(variables.begin(), variables.end(), registers.begin());
+            std::copy(p.constants().begin(), p.constants().end(), registers.begin() + p.variable_count());
+
+            auto code = p.code();
+            uint64_t tests = 0;
+            for (uint32_t pc = 0; pc < code.size();) {
+                profiler.step(pc);
+                auto const & i = code[pc++];
+                switch (i.code) {
+                    case opcode::BINARY:
+                        registers[i.dst] = semantics::apply_operator(i.op, registers[i.lhs], registers[i.rhs]);
+                        break;
+                    case opcode::PREFIX:
+                        registers[i.dst] = semantics::apply_prefix_operator(i.op, registers[i.lhs]);
+                        break;
+                    case opcode::ASSIGN:
+                        registers[i.dst] = registers[i.lhs];
+                        profiler.count(pc - 1);
+                        break;
+                    case opcode::TEST:
+                        if (++tests > max_tests) {
+                            profiler.finish();
+                            std::copy_n(registers.begin(), variables.size(), variables.begin());
+                            return false;
+                        }
+                        if (!semantics::is_true(registers[i.lhs])) {
+                            pc = i.dst;
+                        }
+                        break;
+                    case opcode::JUMP:
+                        pc = i.dst;
+                        break;
+                    case opcode::ENTER:
+                        profiler.count(pc - 1);
+                        break;
+                    case opcode::LEAVE:
+                        break;
+                }
+            }
+            profiler.finish();
+            std::copy_n(registers.begin(), variables.size(), variables.begin());
+            return true;
+        }
+
+    }
+
+    // Runs `p` for one environment, `variables` holds the initial and then the final values.
+    // Returns false when `max_tests` condition tests were not enough to finish.
+    inline bool run(program const & p, std::span<value> variables, uint64_t max_tests = DEFAULT_MAX_TESTS) {
+        detail::no_profiler profiler;
+        return detail::run(p, variables, max_tests, profiler);
+    }
+
+    // The same, also adding counts and cycles of the statements to `out`
+    inline bool run(program const & p, std::span<value> variables, profile & out, uint64_t max_tests = DEFAULT_MAX_TESTS) {
+        detail::profiler profiler(p, out);
+        return detail::run(p, variables, max_tests, profiler);
+    }
+
+    // Values of the variables of a program over many environments, one column per variable
+    class table {
+    public:
+        table(program const & p, size_t rows) : rows_(rows), values_(p.variable_count() * rows) {}
+
+        [[nodiscard]]
+        size_t rows() const {
+            return rows_;
+        }
+
+        [[nodiscard]]
+        std::span<value> column(uint32_t var) {
+            return {values_.data() + var * rows_, rows_};
+        }
+
+        [[nodiscard]]
+        std::span<value const> column(uint32_t var) const {
+            return {values_.data() + var * rows_, rows_};
+        }
+
+    private:
+        size_t rows_;
+        std::vector<value> values_;
+    };
+
+    // Instruction sets the batch evaluation can run on
+    enum class isa {
+        GENERIC, // whatever the compiler targets by default, SSE2 on x86-64
+        AVX2,
+        AVX512,
+    };
+
+    namespace detail {
+
+        constexpr size_t LANES = 8;
+
+        // only aligned as their elements: the natural alignment of a vector depends on the instruction set
+        // a function is compiled for, so the storage is plain values and groups are accessed in place
+        using lanes = value __attribute__((vector_size(LANES * sizeof(value)), aligned(sizeof(value))));
+        using unsigned_lanes = uint64_t __attribute__((vector_size(LANES * sizeof(value)), aligned(sizeof(value))));
+
+        // The batch interpreter. It is inlined into one function per instruction set, so the same
+        // vector code is compiled for each; nothing vector-typed crosses a function boundary.
+        // Divergent conditions narrow a mask of running environments, kept on a stack per nesting level.
+        [[gnu::always_inline]] inline bool run_rows(program const & p, table & t, uint64_t max_tests) {
+            std::vector<value> storage((p.register_count() + p.max_depth() + 1) * LANES);
+            auto registers = reinterpret_cast<lanes *>(storage.data());
+            auto masks = registers + p.register_count(); // by nesting level
+            uint32_t depth = 0;
+            for (uint32_t c = 0; c < p.constants().size(); ++c) {
+                registers[p.variable_count() + c] = lanes{} + p.constants()[c];
+            }
+
+            auto code = p.code();
+            bool finished = true;
+            for (size_t row = 0; row < t.rows(); row += LANES) {
+                auto count = std::min(LANES, t.rows() - row);
+                for (uint32_t var = 0; var < p.variable_count(); ++var) {
+                    std::memcpy(&registers[var], t.column(var).data() + row, count * sizeof(value));
+                }
+
+                lanes running{};
+                for (size_t lane = 0; lane < count; ++lane) {
+                    running[lane] = -1;
+                }
+                masks[depth = 0] = running;
+
+                uint64_t tests = 0;
+                for (uint32_t pc = 0; pc < code.size();) {
+                    auto const & i = code[pc++];
+                    switch (i.code) {
+                        case opcode::BINARY: {
+                            auto const & l = registers[i.lhs];
+                            auto const & r = registers[i.rhs];
+                            auto & d = registers[i.dst];
+                            switch (i.op) {
+                                case lexer::PLUS:
+                                    d = (lanes) ((unsigned_lanes) l + (unsigned_lanes) r);
+                                    break;
+                                case lexer::MINUS:
+                                    d = (lanes) ((unsigned_lanes) l - (unsigned_lanes) r);
+                                    break;
+                                case lexer::MULTIPLICATION:
+                                    d = (lanes) ((unsigned_lanes) l * (unsigned_lanes) r);
+                                    break;
+                                case lexer::LESS:
+                                    d = (lanes) (l < r) & 1;
+                                    break;
+                                case lexer::GREATER:
+                                    d = (lanes) (l > r) & 1;
+                                    break;
+                                case lexer::EQUAL:
+                                    d = (lanes) (l == r) & 1;
+                                    break;
+                                case lexer::NOT_EQUAL:
+                                    d = (lanes) (l != r) & 1;
+                                    break;
+                                case lexer::LESS_EQUAL:
+                                    d = (lanes) (l <= r) & 1;
+                                    break;
+                                case lexer::GREATER_EQUAL:
+                                    d = (lanes) (l >= r) & 1;
+                                    break;
+                                case lexer::AND:
+                                    d = (lanes) ((l != 0) & (r != 0)) & 1;
+                                    break;
+                                case lexer::OR:
+                                    d = (lanes) ((l != 0) | (r != 0)) & 1;
+                                    break;
+                                default: {
+                                    // no vector division, lanes go one by one
+                                    lanes result;
+                                    for (size_t lane = 0; lane < LANES; ++lane) {
+                                        result[lane] = semantics::apply_operator(i.op, l[lane], r[lane]);
+                                    }
+                                    d = result;
+                                    break;
+                                }
+                            }
+                            break;
+                        }
+                        case opcode::PREFIX:
+                            registers[i.dst] = (lanes) (unsigned_lanes{} - (unsigned_lanes) registers[i.lhs]);
+                            break;
+                        case opcode::ASSIGN: {
+                            auto const & mask = masks[depth];
+                            registers[i.dst] = (registers[i.lhs] & mask) | (registers[i.dst] & ~mask);
+                            break;
+                        }
+                        case opcode::ENTER:
+                            masks[depth + 1] = masks[depth];
+                            ++depth;
+                            break;
+                        case opcode::TEST: {
+                            auto & mask = masks[depth];
+                            mask &= (lanes) (registers[i.lhs] != 0);
+                            value any = 0;
+                            for (size_t lane = 0; lane < LANES; ++lane) {
+                                any |= mask[lane];
+                            }
+                            if (!any) {
+                                --depth;
+                                pc = i.dst;
+                            } else if (++tests > max_tests) {
+                                finished = false;
+                                pc = code.size();
+                            }
+                            break;
+                        }
+                        case opcode::LEAVE:
+                            --depth;
+                            break;
+                        case opcode::JUMP:
+                            pc = i.dst;
+                            break;
+                    }
+                }
+
+                for (uint32_t var = 0; var < p.variable_count(); ++var) {
+                    std::memcpy(t.column(var).data() + row, &registers[var], count * sizeof(value));
+                }
+            }
+            return finished;
+        }
+
+        inline bool run_generic(program const & p, table & t, uint64_t max_tests) {
+            return run_rows(p, t, max_tests);
+        }
+
+    #if defined(__GNUC__) && defined(__x86_64__)
+        __attribute__((target("avx2"))) inline bool run_avx2(program const & p, table & t, uint64_t max_tests) {
+            return run_rows(p, t, max_tests);
+        }
+
+        __attribute__((target("avx512f,avx512dq"))) inline bool run_avx512(program const & p, table & t, uint64_t max_tests) {
+            return run_rows(p, t, max_tests);
+        }
+    #endif
+
+    }
+
+    [[nodiscard]]
+    inline bool is_supported(isa target) {
+    #if defined(__GNUC__) && defined(__x86_64__)
+        switch (target) {
+            case isa::GENERIC:
+                return true;
+            case isa::AVX2:
+                return __builtin_cpu_supports("avx2");
+            case isa::AVX512:
+                return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq");
+        }
+        return false;
+    #else
+        return target == isa::GENERIC;
+    #endif
+    }
+
+    [[nodiscard]]
+    inline isa best_isa() {
+        static isa const best = is_supported(isa::AVX512) ? isa::AVX512 : is_supported(isa::AVX2) ? isa::AVX2 : isa::GENERIC;
+        return best;
+    }
+
+    // Runs `p` for every row of `t`, eight environments at a time; same results as `run` row by row.
+    // Returns false when a group of environments needed more than `max_tests` condition tests.
+    inline bool run(program const & p, table & t, uint64_t max_tests = DEFAULT_MAX_TESTS, isa target = best_isa()) {
+    #if defined(__GNUC__) && defined(__x86_64__)
+        switch (target) {
+            case isa::AVX512:
+                return detail::run_avx512(p, t, max_tests);
+            case isa::AVX2:
+                return detail::run_avx2(p, t, max_tests);
+            case isa::GENERIC:
+                break;
+        }
+    #endif
+        return detail::run_generic(p, t, max_tests);
+    }
+
+}
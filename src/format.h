@@ -0,0 +1,136 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "lexer.h"
+#include "parser.h"
+
+namespace formatter {
+
+    namespace detail {
+
+        constexpr uint32_t INDENT = 4;
+
+        inline std::string_view operator_symbol(lexer::operator_type t) {
+            auto info = lexer::find_operator(t);
+            return info ? info->symbol : "?";
+        }
+
+        inline int binding_power(lexer::operator_type t) {
+            auto info = lexer::find_operator(t);
+            return info ? info->precedence : 0;
+        }
+
+        class source_writer {
+        public:
+            source_writer(parser::ast::tree const & tree, std::string_view sv, std::string & out)
+                : tree_(tree), sv_(sv), out_(out) {}
+
+            void statements(uint16_t node, uint32_t depth) {
+                while (tree_.get_kind(node) == parser::ast::kind::STATEMENTS) {
+                    statement(tree_.get_left(node), depth);
+                    node = tree_.get_right(node);
+                }
+                statement(node, depth);
+            }
+
+        private:
+            void statement(uint16_t node, uint32_t depth) {
+                switch (tree_.get_kind(node)) {
+                    case parser::ast::kind::ASSIGNMENT:
+                        out_.append(depth * INDENT, ' ');
+                        out_.append(tree_.get_symbol(tree_.get_left(node), sv_));
+                        out_.append(" = ");
+                        expression(tree_.get_right(node));
+                        out_.push_back('\n');
+                        break;
+                    case parser::ast::kind::IF:
+                    case parser::ast::kind::WHILE:
+                        out_.append(depth * INDENT, ' ');
+                        out_.append(tree_.get_kind(node) == parser::ast::kind::IF ? "if " : "while ");
+                        expression(tree_.get_left(node));
+                        out_.push_back('\n');
+                        statements(tree_.get_right(node), depth + 1);
+                        out_.append(depth * INDENT, ' ');
+                        out_.append("end\n");
+                        break;
+                    case parser::ast::kind::STATEMENTS:
+                        statements(node, depth);
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            void expression(uint16_t node) {
+                switch (tree_.get_kind(node)) {
+                    case parser::ast::kind::BINOP: {
+                        auto type = tree_.get_operator_type(node);
+                        auto left_associative = lexer::find_operator(type)->assoc == lexer::associativity::LEFT;
+
+                        operand(tree_.get_left(node), needs_parentheses(tree_.get_left(node), type, !left_associative));
+                        out_.push_back(' ');
+                        out_.append(operator_symbol(type));
+                        out_.push_back(' ');
+                        operand(tree_.get_right(node), needs_parentheses(tree_.get_right(node), type, left_associative));
+                        break;
+                    }
+                    case parser::ast::kind::UNOP: {
+                        auto type = tree_.get_operator_type(node);
+                        out_.append(operator_symbol(type));
+                        operand(tree_.get_left(node), needs_parentheses(tree_.get_left(node), type, false));
+                        break;
+                    }
+                    default:
+                        out_.append(tree_.get_symbol(node, sv_));
+                        break;
+                }
+            }
+
+            // an operand binding looser than its operator needs parentheses, so does one binding
+            // the same on the side the operator does not group towards
+            [[nodiscard]]
+            bool needs_parentheses(uint16_t node, lexer::operator_type parent, bool on_tie) const {
+                auto kind = tree_.get_kind(node);
+                if (kind != parser::ast::kind::BINOP && kind != parser::ast::kind::UNOP) {
+                    return false;
+                }
+                auto power = binding_power(tree_.get_operator_type(node));
+                return power < binding_power(parent) || (power == binding_power(parent) && on_tie);
+            }
+
+            void operand(uint16_t node, bool parenthesize) {
+                if (parenthesize) {
+                    out_.push_back('(');
+                }
+                expression(node);
+                if (parenthesize) {
+                    out_.push_back(')');
+                }
+            }
+
+            parser::ast::tree const & tree_;
+            std::string_view sv_;
+            std::string & out_;
+        };
+
+    }
+
+    // Writes the canonical source of the program into `out`: one statement per line,
+    // blocks indented by four spaces, single spaces around operators, only required parentheses.
+    // Formatting is idempotent: format(parse(format(x))) == format(x).
+    inline void format(parser::ast::tree const & tree, std::string_view sv, std::string & out) {
+        out.clear();
+        out.reserve(sv.size() + sv.size() / 2);
+        if (!tree.empty()) {
+            detail::source_writer(tree, sv, out).statements(tree.get_root(), 0);
+        }
+    }
+
+    inline std::string format(parser::ast::tree const & tree, std::string_view sv) {
+        std::string out;
+        format(tree, sv, out);
+        return out;
+    }
+
+}
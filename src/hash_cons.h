@@ -0,0 +1,272 @@
+#pragma once
+
+#include <memory_resource>
+#include <string_view>
+#include "allocator.h"
+#include "parser.h"
+#include "visitor.h"
+
+namespace parser::ast {
+
+    namespace detail {
+
+        constexpr uint64_t hash_bytes(std::string_view str, uint64_t h = 14695981039346656037ull) { // FNV-1a
+            for (auto c : str) {
+                h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+            }
+            return h;
+        }
+
+        constexpr uint64_t hash_combine(uint64_t seed, uint64_t value) {
+            return (seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2))) * 1099511628211ull;
+        }
+
+        constexpr bool is_expression(kind k) {
+            return k == kind::VAR || k == kind::CONST || k == kind::BINOP || k == kind::UNOP;
+        }
+
+    }
+
+    // Hash of every node computed bottom-up from its kind, operator, symbol and the hashes of its children,
+    // so structurally equal subtrees get equal hashes wherever they are and whatever their parentheses
+    constexpr memory::vector<uint64_t> structural_hashes(
+        tree const & t,
+        std::string_view sv,
+        std::pmr::memory_resource * resource = nullptr
+    ) {
+        memory::vector<uint64_t> hashes(t.size(), 0, resource);
+        for (auto node : postorder(t)) {
+            auto k = t.get_kind(node);
+            auto h = detail::hash_combine(static_cast<uint64_t>(k), static_cast<uint64_t>(t.get_operator_type(node)));
+            if (k == kind::VAR || k == kind::CONST) {
+                h = detail::hash_combine(h, detail::hash_bytes(t.get_symbol(node, sv)));
+            }
+            h = detail::hash_combine(h, t.have_left(node) ? hashes[t.get_left(node)] : 0);
+            h = detail::hash_combine(h, t.have_right(node) ? hashes[t.get_right(node)] : 0);
+            hashes[node] = h;
+        }
+        return hashes;
+    }
+
+    // Tree in which structurally identical expressions share one node. Statements are kept one per occurrence.
+    // Nodes hold no source range; the range of every occurrence is kept in a side table indexed by the
+    // position of the occurrence in the pre-order of the original tree, see `occurrences`.
+    // Two expressions are structurally equal exactly when they have the same id, which makes the ids
+    // usable for common subexpression detection without comparing hashes.
+    class consed_tree {
+    public:
+        static constexpr uint16_t npos = tree::npos;
+
+        [[nodiscard]]
+        constexpr uint16_t get_root() const {
+            return root_;
+        }
+
+        [[nodiscard]]
+        constexpr uint16_t get_left(uint16_t id) const {
+            return nodes_[id].op1;
+        }
+
+        [[nodiscard]]
+        constexpr uint16_t get_right(uint16_t id) const {
+            return nodes_[id].op2;
+        }
+
+        [[nodiscard]]
+        constexpr kind get_kind(uint16_t id) const {
+            return nodes_[id].get_kind();
+        }
+
+        [[nodiscard]]
+        constexpr lexer::operator_type get_operator_type(uint16_t id) const {
+            return nodes_[id].get_operator_type();
+        }
+
+        // name of a VAR or value of a CONST
+        [[nodiscard]]
+        constexpr std::string_view get_symbol(uint16_t id, std::string_view sv) const {
+            return sv.substr(nodes_[id].symbol_pos, nodes_[id].symbol_len);
+        }
+
+        // range of the `occurrence`-th node of the original tree in pre-order
+        [[nodiscard]]
+        constexpr std::pair<uint32_t, uint32_t> get_range(uint32_t occurrence) const {
+            return {ranges_[occurrence].start_pos, ranges_[occurrence].end_pos};
+        }
+
+        // unique nodes
+        [[nodiscard]]
+        constexpr uint16_t size() const {
+            return nodes_.size();
+        }
+
+        // nodes of the original tree
+        [[nodiscard]]
+        constexpr uint32_t occurrences() const {
+            return ranges_.size();
+        }
+
+        [[nodiscard]]
+        constexpr bool empty() const {
+            return ranges_.empty();
+        }
+
+        [[nodiscard]]
+        constexpr size_t memory_usage() const {
+            return nodes_.capacity() * sizeof(node) + ranges_.capacity() * sizeof(range);
+        }
+
+        // Expands the shared nodes back into a tree equal to the original one
+        [[nodiscard]]
+        constexpr tree to_tree() const {
+            tree result;
+            if (empty()) {
+                return result;
+            }
+            builder b(result);
+
+            struct frame {
+                uint16_t id;
+                uint16_t parent;
+                bool left;
+            };
+            memory::vector<frame> stack{{root_, npos, false}};
+            uint32_t occurrence = 0;
+            while (!stack.empty()) {
+                auto [id, parent, left] = stack.back();
+                stack.pop_back();
+
+                auto const & n = nodes_[id];
+                auto [start, end] = get_range(occurrence++);
+                auto idx = n.get_kind() == kind::BINOP ? b.new_node_binop(n.get_operator_type(), start, end)
+                         : n.get_kind() == kind::UNOP ? b.new_node_unop(n.get_operator_type(), start, end)
+                         : b.new_node(n.get_kind(), start, end);
+
+                if (parent == npos) {
+                    b.set_root(idx);
+                } else if (left) {
+                    b.set_left(parent, idx);
+                } else {
+                    b.set_right(parent, idx);
+                }
+
+                if (n.op2 != npos) {
+                    stack.push_back({n.op2, idx, false});
+                }
+                if (n.op1 != npos) {
+                    stack.push_back({n.op1, idx, true});
+                }
+            }
+            return result;
+        }
+
+    private:
+        struct node {
+            uint32_t symbol_pos = 0;
+            uint32_t symbol_len = 0;
+            uint16_t op1 = npos;
+            uint16_t op2 = npos;
+            uint8_t type = 0;
+            uint8_t op_type = lexer::operator_type::UNDEFINED;
+
+            [[nodiscard]]
+            constexpr kind get_kind() const {
+                return static_cast<kind>(type);
+            }
+
+            [[nodiscard]]
+            constexpr lexer::operator_type get_operator_type() const {
+                return static_cast<lexer::operator_type>(op_type);
+            }
+        };
+
+        struct range {
+            uint32_t start_pos;
+            uint32_t end_pos;
+        };
+
+        constexpr explicit consed_tree(std::pmr::memory_resource * resource) : nodes_(resource), ranges_(resource) {}
+
+        memory::vector<node> nodes_;
+        memory::vector<range> ranges_;
+        uint16_t root_ = npos;
+
+        friend constexpr consed_tree hash_cons(tree const & t, std::string_view sv, std::pmr::memory_resource * resource);
+    };
+
+    // Builds the hash-consed form of `t`: expressions are interned bottom-up keyed by kind, operator,
+    // symbol and the ids of their (already interned) children
+    constexpr consed_tree hash_cons(tree const & t, std::string_view sv, std::pmr::memory_resource * resource = nullptr) {
+        consed_tree result(resource);
+        if (t.empty()) {
+            return result;
+        }
+
+        memory::vector<uint16_t> ids(t.size(), consed_tree::npos, resource);
+        memory::vector<uint16_t> slots(resource); // open addressing over unique expression ids
+        uint32_t interned = 0;
+
+        auto key_hash = [&](consed_tree::node const & n) {
+            auto h = detail::hash_combine(static_cast<uint64_t>(n.type), static_cast<uint64_t>(n.op_type));
+            h = detail::hash_combine(h, detail::hash_bytes(sv.substr(n.symbol_pos, n.symbol_len)));
+            return detail::hash_combine(h, static_cast<uint64_t>(n.op1) << 16 | n.op2);
+        };
+        auto same = [&](consed_tree::node const & l, consed_tree::node const & r) {
+            return l.type == r.type && l.op_type == r.op_type && l.op1 == r.op1 && l.op2 == r.op2
+                   && sv.substr(l.symbol_pos, l.symbol_len) == sv.substr(r.symbol_pos, r.symbol_len);
+        };
+        auto find = [&](consed_tree::node const & n) {
+            auto mask = slots.size() - 1;
+            auto slot = key_hash(n) & mask;
+            while (slots[slot] != consed_tree::npos && !same(result.nodes_[slots[slot]], n)) {
+                slot = (slot + 1) & mask;
+            }
+            return slot;
+        };
+
+        for (auto idx : postorder(t)) {
+            consed_tree::node n{
+                .op1 = t.have_left(idx) ? ids[t.get_left(idx)] : consed_tree::npos,
+                .op2 = t.have_right(idx) ? ids[t.get_right(idx)] : consed_tree::npos,
+                .type = static_cast<uint8_t>(t.get_kind(idx)),
+                .op_type = static_cast<uint8_t>(t.get_operator_type(idx)),
+            };
+            if (n.get_kind() == kind::VAR || n.get_kind() == kind::CONST) {
+                auto symbol = t.get_symbol(idx, sv);
+                n.symbol_pos = symbol.data() - sv.data();
+                n.symbol_len = symbol.size();
+            }
+
+            if (!detail::is_expression(n.get_kind())) {
+                ids[idx] = result.nodes_.size();
+                result.nodes_.push_back(n);
+                continue;
+            }
+
+            if ((interned + 1) * 2 > slots.size()) {
+                slots.assign(std::max<size_t>(16, slots.size() * 2), consed_tree::npos);
+                for (uint16_t id = 0; id < result.nodes_.size(); ++id) {
+                    if (detail::is_expression(result.nodes_[id].get_kind())) {
+                        slots[find(result.nodes_[id])] = id;
+                    }
+                }
+            }
+            auto & slot = slots[find(n)];
+            if (slot == consed_tree::npos) {
+                slot = result.nodes_.size();
+                result.nodes_.push_back(n);
+                ++interned;
+            }
+            ids[idx] = slot;
+        }
+        result.root_ = ids[t.get_root()];
+
+        result.ranges_.reserve(t.size());
+        for (auto idx : preorder(t)) {
+            auto [start, end] = t.get_range(idx);
+            result.ranges_.push_back({start, end});
+        }
+        return result;
+    }
+
+}
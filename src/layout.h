@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <memory_resource>
+#include "allocator.h"
+#include "parser.h"
+#include "visitor.h"
+
+namespace parser::ast {
+
+    // Order of the nodes in memory after `relayout`
+    enum class layout {
+        PREORDER,      // depth-first, parents right before their left subtree
+        VAN_EMDE_BOAS, // recursively blocked by height, a subtree of any size spans few cache lines
+    };
+
+    namespace detail {
+
+        constexpr uint32_t height(tree const & t, uint16_t root) {
+            uint32_t result = 0;
+            walk(t, root, [&](uint16_t, uint32_t depth) {
+                result = std::max(result, depth + 1);
+            }, [](uint16_t, uint32_t) {});
+            return result;
+        }
+
+        struct level_frame {
+            uint16_t node;
+            uint32_t depth;
+        };
+
+        // Calls `f(node)` from left to right for the nodes `levels` below `root`, `frames` is scratch space
+        template <typename F>
+        constexpr void for_each_at_depth(tree const & t, uint16_t root, uint32_t levels, memory::vector<level_frame> & frames, F f) {
+            frames.assign(1, {root, 0});
+            while (!frames.empty()) {
+                auto [node, depth] = frames.back();
+                frames.pop_back();
+                if (depth == levels) {
+                    f(node);
+                    continue;
+                }
+                if (t.have_right(node)) {
+                    frames.push_back({t.get_right(node), depth + 1});
+                }
+                if (t.have_left(node)) {
+                    frames.push_back({t.get_left(node), depth + 1});
+                }
+            }
+        }
+
+        // The top half of the levels is laid out first, then every subtree hanging below it, each recursively
+        constexpr memory::vector<uint16_t> van_emde_boas_order(tree const & t, std::pmr::memory_resource * resource) {
+            struct task {
+                uint16_t root;
+                uint32_t levels;
+            };
+
+            memory::vector<uint16_t> order(resource);
+            order.reserve(t.size());
+            memory::vector<task> tasks(1, {t.get_root(), height(t, t.get_root())}, resource);
+            memory::vector<uint16_t> bottoms(resource);
+            memory::vector<level_frame> frames(resource);
+
+            while (!tasks.empty()) {
+                auto [root, levels] = tasks.back();
+                tasks.pop_back();
+                if (levels == 1) {
+                    order.push_back(root);
+                    continue;
+                }
+
+                auto top = levels / 2;
+                bottoms.clear();
+                for_each_at_depth(t, root, top, frames, [&](uint16_t node) {
+                    bottoms.push_back(node);
+                });
+                // the stack runs the top first, then the bottom subtrees from left to right
+                for (auto it = bottoms.rbegin(); it != bottoms.rend(); ++it) {
+                    tasks.push_back({*it, levels - top});
+                }
+                tasks.push_back({root, top});
+            }
+            return order;
+        }
+
+    }
+
+    // Copy of `t` with its nodes renumbered in `l` order and the links rewritten accordingly.
+    // The parser numbers nodes in completion order (operands before operators, the statement spine last),
+    // so traversals of a parsed tree jump around; after relayout the root is node 0 and traversals
+    // read the node array mostly forward.
+    constexpr tree relayout(tree const & t, layout l = layout::PREORDER, std::pmr::memory_resource * resource = nullptr) {
+        tree result(resource);
+        if (t.empty()) {
+            return result;
+        }
+
+        memory::vector<uint16_t> order(resource);
+        if (l == layout::PREORDER) {
+            order.reserve(t.size());
+            for (auto node : preorder(t)) {
+                order.push_back(node);
+            }
+        } else {
+            order = detail::van_emde_boas_order(t, resource);
+        }
+
+        memory::vector<uint16_t> renumbered(t.size(), tree::npos, resource);
+        builder b(result);
+        for (auto node : order) {
+            auto [start, end] = t.get_range(node);
+            auto k = t.get_kind(node);
+            renumbered[node] = k == kind::BINOP ? b.new_node_binop(t.get_operator_type(node), start, end)
+                             : k == kind::UNOP ? b.new_node_unop(t.get_operator_type(node), start, end)
+                             : b.new_node(k, start, end);
+        }
+        for (auto node : order) {
+            if (t.have_left(node)) {
+                b.set_left(renumbered[node], renumbered[t.get_left(node)]);
+            }
+            if (t.have_right(node)) {
+                b.set_right(renumbered[node], renumbered[t.get_right(node)]);
+            }
+        }
+        b.set_root(renumbered[t.get_root()]);
+        return result;
+    }
+
+}
@@ -0,0 +1,365 @@
+#pragma once
+
+#include <algorithm>
+#include <memory_resource>
+#include <optional>
+#include <string_view>
+#include <variant>
+#include "allocator.h"
+#include "lexer.h"
+#include "parser.h"
+#include "streaming.h"
+#include "visitor.h"
+
+namespace lazy {
+
+    constexpr uint32_t npos = -1;
+
+    // A node of the materialised ast of a top level statement
+    struct node_ref {
+        parser::ast::tree const * tree;
+        uint16_t node;
+    };
+
+    namespace detail {
+
+        struct statement {
+            parser::ast::kind kind;
+            uint32_t start;
+            uint32_t end = 0;
+            uint32_t parent = npos;
+            uint32_t next = npos; // next statement of the same block
+            uint32_t top = 0;     // index of the top level statement holding it
+        };
+
+        // length of the longest symbol of `table` at `pos`, 0 if none
+        template <size_t N>
+        constexpr uint32_t match(lexer::operator_info const (&table)[N], std::string_view sv, uint32_t pos) {
+            uint32_t longest = 0;
+            for (auto const & info : table) {
+                if (sv.substr(pos, info.symbol.size()) == info.symbol) {
+                    longest = std::max<uint32_t>(longest, info.symbol.size());
+                }
+            }
+            return longest;
+        }
+
+        // Finds the statements and blocks of `sv` the way `lexer::statement` splits them, without emitting
+        // tokens. A statement the scan cannot follow ends the skeleton, spanning up to the end of the input,
+        // so that materialising it reports the lexer's own error.
+        class scanner {
+        public:
+            constexpr scanner(std::string_view sv, memory::vector<statement> & statements, memory::vector<uint32_t> & tops)
+                : sv_(sv), statements_(statements), tops_(tops), blocks_(statements.get_allocator()), last_(statements.get_allocator()) {}
+
+            constexpr void run() && {
+                last_.push_back(npos);
+                while (true) {
+                    skip_whitespaces();
+                    if (pos_ == sv_.size()) {
+                        break;
+                    }
+
+                    // like the lexer, `end` only closes a block that has a statement, else it is a name
+                    if (!blocks_.empty() && last_.back() != npos && sv_.substr(pos_, 3) == lexer::token_strings::END) {
+                        pos_ += 3;
+                        statements_[blocks_.back()].end = pos_;
+                        blocks_.pop_back();
+                        last_.pop_back();
+                        continue;
+                    }
+
+                    // keywords are matched as prefixes, like `lexer::k_while` and `lexer::k_if` do
+                    std::string_view keyword = lexer::token_strings::WHILE;
+                    auto k = parser::ast::kind::WHILE;
+                    if (sv_.substr(pos_, keyword.size()) != keyword) {
+                        keyword = lexer::token_strings::IF;
+                        k = parser::ast::kind::IF;
+                    }
+                    if (sv_.substr(pos_, keyword.size()) == keyword) {
+                        auto id = add(k);
+                        pos_ += keyword.size();
+                        if (expression() == npos) {
+                            return give_up(id);
+                        }
+                        blocks_.push_back(id);
+                        last_.push_back(npos);
+                        continue;
+                    }
+
+                    auto id = add(parser::ast::kind::ASSIGNMENT);
+                    auto name = pos_;
+                    while (pos_ < sv_.size() && lexer::chars::is_alpha(sv_[pos_])) {
+                        ++pos_;
+                    }
+                    skip_whitespaces();
+                    if (pos_ == name || pos_ == sv_.size() || sv_[pos_] != '=') {
+                        return give_up(id);
+                    }
+                    ++pos_;
+                    if ((statements_[id].end = expression()) == npos) {
+                        return give_up(id);
+                    }
+                }
+
+                if (!blocks_.empty()) {
+                    give_up(blocks_.back());
+                }
+            }
+
+        private:
+            constexpr void skip_whitespaces() {
+                while (pos_ < sv_.size() && lexer::chars::is_whitespace(sv_[pos_])) {
+                    ++pos_;
+                }
+            }
+
+            constexpr uint32_t add(parser::ast::kind k) {
+                uint32_t id = statements_.size();
+                auto parent = blocks_.empty() ? npos : blocks_.back();
+                if (last_.back() != npos) {
+                    statements_[last_.back()].next = id;
+                }
+                last_.back() = id;
+                if (parent == npos) {
+                    tops_.push_back(id);
+                }
+                statements_.push_back({.kind = k, .start = pos_, .parent = parent, .top = static_cast<uint32_t>(tops_.size() - 1)});
+                return id;
+            }
+
+            // the same shape as `lexer::expression`; returns where the expression ends, npos if it does not fit
+            constexpr uint32_t expression() {
+                uint32_t opened = 0;
+                while (true) {
+                    skip_whitespaces();
+                    while (pos_ < sv_.size()) {
+                        if (sv_[pos_] == '(') {
+                            ++opened;
+                            ++pos_;
+                        } else if (auto len = match(lexer::prefix_operators, sv_, pos_)) {
+                            pos_ += len;
+                        } else {
+                            break;
+                        }
+                        skip_whitespaces();
+                    }
+
+                    auto operand = pos_;
+                    auto is_operand_char = pos_ < sv_.size() && lexer::chars::is_digit(sv_[pos_])
+                                         ? lexer::chars::is_digit : lexer::chars::is_alpha;
+                    while (pos_ < sv_.size() && is_operand_char(sv_[pos_])) {
+                        ++pos_;
+                    }
+                    if (pos_ == operand) {
+                        return npos;
+                    }
+
+                    auto end = pos_;
+                    skip_whitespaces();
+                    while (opened && pos_ < sv_.size() && sv_[pos_] == ')') {
+                        --opened;
+                        end = ++pos_;
+                        skip_whitespaces();
+                    }
+
+                    if (auto len = match(lexer::binary_operators, sv_, pos_)) {
+                        pos_ += len;
+                        continue;
+                    }
+                    return opened ? npos : end;
+                }
+            }
+
+            // drops what was found of the top level statement holding `id`, which now spans the rest of the input
+            constexpr void give_up(uint32_t id) {
+                auto top = tops_[statements_[id].top];
+                statements_.erase(statements_.begin() + top + 1, statements_.end());
+                statements_[top].end = sv_.size();
+                statements_[top].next = npos;
+            }
+
+            std::string_view sv_;
+            uint32_t pos_ = 0;
+            memory::vector<statement> & statements_;
+            memory::vector<uint32_t> & tops_;
+            memory::vector<uint32_t> blocks_; // open if and while statements
+            memory::vector<uint32_t> last_;   // last statement of every open block, the top level first
+        };
+
+    }
+
+    // A program of which only the statement skeleton is known up front: the kind, range and nesting of
+    // every statement, found by a scan that builds no token and no node. The ast of a top level statement
+    // is lexed and parsed the first time one of its statements is materialised, so a query touching a few
+    // statements costs the scan plus the parsing of those statements, whatever the size of the program.
+    // Errors of a statement show up when it is materialised and are the ones `parser::parse` reports.
+    class program {
+    public:
+        // the ast are allocated from `resource`, the heap if null
+        explicit program(std::string_view sv, std::pmr::memory_resource * resource = nullptr)
+            : sv_(sv), resource_(resource), statements_(resource), tops_(resource), tokens_(resource) {
+            detail::scanner(sv, statements_, tops_).run();
+            trees_.resize(tops_.size());
+        }
+
+        [[nodiscard]]
+        std::string_view source() const {
+            return sv_;
+        }
+
+        // statements at any depth, ids follow the source order
+        [[nodiscard]]
+        uint32_t size() const {
+            return statements_.size();
+        }
+
+        [[nodiscard]]
+        uint32_t top_level_size() const {
+            return tops_.size();
+        }
+
+        // id of the `idx`-th top level statement
+        [[nodiscard]]
+        uint32_t get_top_level(uint32_t idx) const {
+            return tops_[idx];
+        }
+
+        // IF, WHILE or ASSIGNMENT
+        [[nodiscard]]
+        parser::ast::kind get_kind(uint32_t id) const {
+            return statements_[id].kind;
+        }
+
+        [[nodiscard]]
+        std::pair<uint32_t, uint32_t> get_range(uint32_t id) const {
+            return {statements_[id].start, statements_[id].end};
+        }
+
+        // enclosing if or while, npos at the top level
+        [[nodiscard]]
+        uint32_t get_parent(uint32_t id) const {
+            return statements_[id].parent;
+        }
+
+        // first statement of the body of an if or while, npos for an assignment
+        [[nodiscard]]
+        uint32_t get_first_child(uint32_t id) const {
+            return id + 1 < size() && statements_[id + 1].parent == id ? id + 1 : npos;
+        }
+
+        // next statement of the same block, npos after the last one
+        [[nodiscard]]
+        uint32_t get_next(uint32_t id) const {
+            return statements_[id].next;
+        }
+
+        // innermost statement whose range holds `pos`, npos if none does
+        [[nodiscard]]
+        uint32_t find(uint32_t pos) const {
+            auto top = std::upper_bound(tops_.begin(), tops_.end(), pos, [&](uint32_t p, uint32_t id) {
+                return p < statements_[id].start;
+            });
+            if (top == tops_.begin()) {
+                return npos;
+            }
+
+            auto id = *--top;
+            if (pos >= statements_[id].end) {
+                return npos;
+            }
+            for (auto child = get_first_child(id); child != npos;) {
+                if (pos < statements_[child].start) {
+                    break;
+                }
+                if (pos < statements_[child].end) {
+                    id = child;
+                    child = get_first_child(child);
+                } else {
+                    child = get_next(child);
+                }
+            }
+            return id;
+        }
+
+        // The ast node of statement `id`, parsing its top level statement on first access
+        std::variant<node_ref, lexer::error> materialize(uint32_t id) {
+            auto const & s = statements_[id];
+            auto & tree = trees_[s.top];
+            if (!tree) {
+                tokens_.clear();
+                auto result = lexer::statement::parse(tokens_, statements_[tops_[s.top]].start, sv_);
+                if (auto error = std::get_if<lexer::error>(&result)) {
+                    return *error;
+                }
+                if (auto error = parser::detail::check_node_count(tokens_)) {
+                    return *error;
+                }
+                lexer::token_storage storage(tokens_);
+                tree = parser::detail::parse_from_token_list(storage, sv_, resource_);
+                ++materialized_;
+            }
+
+            for (auto node : parser::ast::preorder(*tree)) {
+                if (tree->get_kind(node) == s.kind && tree->get_range(node).first == s.start) {
+                    return node_ref{&*tree, node};
+                }
+            }
+            return node_ref{&*tree, tree->get_root()};
+        }
+
+        // top level statements parsed so far
+        [[nodiscard]]
+        uint32_t materialized() const {
+            return materialized_;
+        }
+
+    private:
+        std::string_view sv_;
+        std::pmr::memory_resource * resource_;
+        memory::vector<detail::statement> statements_;
+        memory::vector<uint32_t> tops_;
+        std::vector<std::optional<parser::ast::tree>> trees_; // by top level statement
+        lexer::token_list tokens_;
+        uint32_t materialized_ = 0;
+    };
+
+    // Whether the value stored by `assignment` may be read, with the answer `find_unused_assignments`
+    // gives for the whole program. Only the top level statements from the assignment up to the next
+    // read or overwrite of its variable are materialised.
+    inline std::variant<bool, lexer::error> is_used(program & p, uint32_t assignment) {
+        auto start = p.get_range(assignment).first;
+        bool reported = false;
+        streaming::detail::dataflow dataflow([&](std::pair<uint32_t, uint32_t> range) {
+            reported |= range.first == start;
+        });
+
+        auto materialized = p.materialize(assignment);
+        if (auto error = std::get_if<lexer::error>(&materialized)) {
+            return *error;
+        }
+        auto [tree, node] = std::get<node_ref>(materialized);
+        auto name = tree->get_symbol(tree->get_left(node), p.source());
+
+        auto top = assignment;
+        while (p.get_parent(top) != npos) {
+            top = p.get_parent(top);
+        }
+        for (; top != npos; top = p.get_next(top)) {
+            auto statement = p.materialize(top);
+            if (auto error = std::get_if<lexer::error>(&statement)) {
+                return *error;
+            }
+            dataflow.analyze(*std::get<node_ref>(statement).tree, p.source(), 0);
+
+            if (reported) {
+                return false;
+            }
+            if (auto pending = dataflow.pending(name); !pending || pending->start != start) {
+                return true;
+            }
+        }
+        return false; // still pending at the end of the program
+    }
+
+}
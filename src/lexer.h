@@ -1,9 +1,13 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
+#include <string_view>
 #include <vector>
 #include <variant>
 #include <cctype>
+#include "allocator.h"
+#include "trace.h"
 
 namespace lexer {
 
@@ -17,7 +21,7 @@ namespace lexer {
         IF,         // if
         WHILE,      // while
         END,        // end
-        OPERATOR,   // <>+-*/
+        OPERATOR,   // see binary_operators and prefix_operators
         EXPRESSION_FINISH_META,
     };
 
@@ -26,10 +30,12 @@ namespace lexer {
         uint32_t len;
         kind type;
 
-        token (uint32_t begin, uint32_t len, kind type)
+        constexpr token (uint32_t begin, uint32_t len, kind type)
             : begin(begin), len(len), type(type) {} // Required for clang
     };
 
+    using token_list = memory::vector<token>;
+
     struct error {
         char const * cause;
         uint32_t pos;
@@ -37,23 +43,100 @@ namespace lexer {
 
     using lexer_result = std::variant<uint32_t, error>;
 
+    // Values are part of the C API and of the binary AST format, new operators go to the end
+    enum operator_type {
+        PLUS,
+        MINUS,
+        MULTIPLICATION,
+        DIVISION,
+        LESS,
+        GREATER,
+        UNDEFINED,
+        EQUAL,
+        NOT_EQUAL,
+        LESS_EQUAL,
+        GREATER_EQUAL,
+        AND,
+        OR,
+        NEGATION,
+    };
+
+    enum class associativity {
+        LEFT,
+        RIGHT,
+    };
+
+    struct operator_info {
+        std::string_view symbol;
+        operator_type type;
+        uint8_t precedence; // higher binds tighter
+        associativity assoc;
+    };
+
+    // A new operator needs a row here and its meaning in semantics.h
+    inline constexpr operator_info binary_operators[] = {
+        {"||", OR,             1, associativity::LEFT},
+        {"&&", AND,            2, associativity::LEFT},
+        {"==", EQUAL,          3, associativity::LEFT},
+        {"!=", NOT_EQUAL,      3, associativity::LEFT},
+        {"<",  LESS,           4, associativity::LEFT},
+        {">",  GREATER,        4, associativity::LEFT},
+        {"<=", LESS_EQUAL,     4, associativity::LEFT},
+        {">=", GREATER_EQUAL,  4, associativity::LEFT},
+        {"+",  PLUS,           5, associativity::LEFT},
+        {"-",  MINUS,          5, associativity::LEFT},
+        {"*",  MULTIPLICATION, 6, associativity::LEFT},
+        {"/",  DIVISION,       6, associativity::LEFT},
+    };
+
+    inline constexpr operator_info prefix_operators[] = {
+        {"-",  NEGATION,       7, associativity::RIGHT},
+    };
+
+    // Row of the table with exactly this symbol, nullptr if there is none
+    template <size_t N>
+    constexpr operator_info const * find_operator(operator_info const (&table)[N], std::string_view symbol) {
+        for (auto const & info : table) {
+            if (info.symbol == symbol) {
+                return &info;
+            }
+        }
+        return nullptr;
+    }
+
+    constexpr operator_info const * find_operator(operator_type type) {
+        for (auto const & info : binary_operators) {
+            if (info.type == type) {
+                return &info;
+            }
+        }
+        for (auto const & info : prefix_operators) {
+            if (info.type == type) {
+                return &info;
+            }
+        }
+        return nullptr;
+    }
+
     bool constexpr is_success(lexer_result const & l) {
         return std::holds_alternative<uint32_t>(l);
     }
 
     template<typename T>
-    concept Lexer = requires(std::vector<token> &vector, uint32_t uint, std::string_view string_view) {
+    concept Lexer = requires(token_list &vector, uint32_t uint, std::string_view string_view) {
         { T::parse(vector, uint, string_view) } -> std::same_as<lexer_result>;
     };
 
     namespace errors {
-    #define CREATE_ERROR(message) constexpr char message[] = #message
+    #define CREATE_ERROR(message) inline constexpr char message[] = #message
 
         CREATE_ERROR(STRING_IS_TOO_SHORT);
         CREATE_ERROR(INVALID_SYMBOL);
         CREATE_ERROR(IDENTIFIER_OR_CONSTANT_EXPECTED);
         CREATE_ERROR(UNCLOSED_PARENTHESIS);
         CREATE_ERROR(UNFINISHED_STATEMENT);
+        CREATE_ERROR(NESTING_TOO_DEEP);
+        CREATE_ERROR(TOO_MANY_NODES);
 
     #undef CREATE_ERROR
     }
@@ -63,7 +146,7 @@ namespace lexer {
         template<uint32_t LEN, char const (&TOK)[LEN + 1], kind KIND>
         requires (LEN > 0)
         struct token_match {
-            static lexer_result parse(std::vector<token> &output, uint32_t pos, std::string_view str) {
+            static constexpr lexer_result parse(token_list &output, uint32_t pos, std::string_view str) {
                 if (str.size() < pos + LEN) {
                     return error {
                         .cause = errors::STRING_IS_TOO_SHORT,
@@ -88,7 +171,7 @@ namespace lexer {
         template<uint32_t LEN, char const (&CHARS)[LEN + 1], kind KIND>
         requires (LEN > 0)
         struct any_char {
-            static lexer_result parse(std::vector<token> &output, uint32_t pos, std::string_view str) {
+            static constexpr lexer_result parse(token_list &output, uint32_t pos, std::string_view str) {
                 if (str.size() < pos + 1) {
                     return error {
                         .cause = errors::STRING_IS_TOO_SHORT,
@@ -113,7 +196,7 @@ namespace lexer {
         template<int (*GOOD_CHAR)(int), kind KIND>
         requires (bool(GOOD_CHAR))
         struct symbols {
-            static lexer_result parse(std::vector<token> &output, uint32_t pos, std::string_view str) {
+            static constexpr lexer_result parse(token_list &output, uint32_t pos, std::string_view str) {
                 if (str.size() <= pos) {
                     return error {
                         .cause = errors::STRING_IS_TOO_SHORT,
@@ -140,7 +223,7 @@ namespace lexer {
 
         template<char SYM, kind KIND>
         struct symbol {
-            static lexer_result parse(std::vector<token> &output, uint32_t pos, std::string_view str) {
+            static constexpr lexer_result parse(token_list &output, uint32_t pos, std::string_view str) {
                 if (str.size() <= pos) {
                     return error {
                         .cause = errors::STRING_IS_TOO_SHORT,
@@ -160,10 +243,39 @@ namespace lexer {
             }
         };
 
+        // longest symbol of an operator table
+        template<auto const & TABLE, kind KIND>
+        struct longest_symbol {
+            static constexpr lexer_result parse(token_list &output, uint32_t pos, std::string_view str) {
+                if (str.size() <= pos) {
+                    return error {
+                        .cause = errors::STRING_IS_TOO_SHORT,
+                        .pos = static_cast<uint32_t>(str.size()),
+                    };
+                }
+
+                size_t len = 0;
+                for (auto const & info : TABLE) {
+                    if (info.symbol.size() > len && str.substr(pos).starts_with(info.symbol)) {
+                        len = info.symbol.size();
+                    }
+                }
+                if (!len) {
+                    return error {
+                        .cause = errors::INVALID_SYMBOL,
+                        .pos = pos,
+                    };
+                }
+
+                output.emplace_back(pos, len, KIND);
+                return static_cast<uint32_t>(pos + len);
+            }
+        };
+
         template<Lexer ... LEXERS>
         requires (sizeof ... (LEXERS) > 0)
         struct sequence {
-            static lexer_result parse(std::vector<token> &output, uint32_t pos, std::string_view str) {
+            static constexpr lexer_result parse(token_list &output, uint32_t pos, std::string_view str) {
                 lexer_result status(pos);
                 (void) (
                     (status = LEXERS::parse(output, std::get<uint32_t>(status), str)
@@ -177,7 +289,7 @@ namespace lexer {
         template<Lexer ... LEXERS>
         requires (sizeof ... (LEXERS) > 0)
         struct alternative {
-            static lexer_result parse(std::vector<token> &output, uint32_t pos, std::string_view str) {
+            static constexpr lexer_result parse(token_list &output, uint32_t pos, std::string_view str) {
                 lexer_result status;
                 auto initial_size = output.size();
                 (void) (
@@ -192,14 +304,14 @@ namespace lexer {
 
         template<Lexer LEXER, bool AT_LEAST_ONE = true, bool MERGE_TOKENS = false>
         struct many {
-            static lexer_result parse(std::vector<token> &output, uint32_t pos, std::string_view str) {
+            static constexpr lexer_result parse(token_list &output, uint32_t pos, std::string_view str) {
                 lexer_result status = LEXER::parse(output, pos, str);
 
                 if (!is_success(status)) {
                     if constexpr (AT_LEAST_ONE) {
                         return status;
                     } else {
-                        status = pos;
+                        return pos;
                     }
                 }
 
@@ -223,52 +335,92 @@ namespace lexer {
     }
 
     namespace token_strings {
-        constexpr char IF[] = "if";
-        constexpr char WHILE[] = "while";
-        constexpr char END[] = "end";
-        constexpr char WHITESPACE[] = " \t\r\n";
-        constexpr char OPERATOR[] = "><+-*/";
+        inline constexpr char IF[] = "if";
+        inline constexpr char WHILE[] = "while";
+        inline constexpr char END[] = "end";
+        inline constexpr char WHITESPACE[] = " \t\r\n";
     }
 
 #define MAKE_TOKEN_LEX(str, kind) combinators::token_match<sizeof(str) - 1, str, kind>
-#define MAKE_ANYCHAR_LEX(str, kind) combinators::any_char<sizeof(str) - 1, str, kind>
 
-    using identifier = combinators::symbols<std::isalpha, kind::IDENTIFIER>;
-    using constant = combinators::symbols<std::isdigit, kind::CONSTANT>;
-    using whitespaces = combinators::many<MAKE_ANYCHAR_LEX(token_strings::WHITESPACE, kind::WHITESPACE), false, true>;
+    // ASCII classes, independent of the locale and defined for any char value
+    namespace chars {
+        constexpr int is_alpha(int c) {
+            return (c | 0x20) >= 'a' && (c | 0x20) <= 'z';
+        }
+
+        constexpr int is_digit(int c) {
+            return c >= '0' && c <= '9';
+        }
+
+        constexpr int is_whitespace(int c) { // token_strings::WHITESPACE
+            return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        }
+    }
+
+    using identifier = combinators::symbols<chars::is_alpha, kind::IDENTIFIER>;
+    using constant = combinators::symbols<chars::is_digit, kind::CONSTANT>;
+    // a whole run is one token, an empty run is no token
+    using whitespaces = combinators::many<combinators::symbols<chars::is_whitespace, kind::WHITESPACE>, false>;
     using k_if = MAKE_TOKEN_LEX(token_strings::IF, kind::IF);
     using k_while = MAKE_TOKEN_LEX(token_strings::WHILE, kind::WHILE);
     using k_end = MAKE_TOKEN_LEX(token_strings::END, kind::END);
-    using operator_sym = MAKE_ANYCHAR_LEX(token_strings::OPERATOR, kind::OPERATOR);
+    using binary_operator = combinators::longest_symbol<binary_operators, kind::OPERATOR>;
+    using prefix_operator = combinators::longest_symbol<prefix_operators, kind::OPERATOR>;
 
-#undef MAKE_ANYCHAR_LEX
 #undef MAKE_TOKEN_LEX
 
     template <Lexer LEX>
-    void maybe(std::vector<token> & output, uint32_t & pos, std::string_view str) {
+    constexpr void maybe(token_list & output, uint32_t & pos, std::string_view str) {
         auto tok = LEX::parse(output, pos, str);
         if (is_success(tok)) {
             pos = std::get<uint32_t>(tok);
         }
     }
 
+    // Bound on the parser's recursion depth: open parentheses plus prefix operators still applying
+    inline constexpr uint32_t MAX_NESTING = 256;
+
     struct expression {
-        static lexer_result parse(std::vector<token> & output, uint32_t pos, std::string_view str) {
+        static constexpr lexer_result parse(token_list & output, uint32_t pos, std::string_view str) {
             using namespace combinators;
 
+            // depth of the parser when it started the operand an open parenthesis belongs to
+            std::array<uint32_t, MAX_NESTING> outer; // written before read, no need to clear it
             auto opened = 0u;
+            auto depth = 0u;
+            auto operand_start = 0u;
             lexer_result tok;
 
             while (true) {
-                if (is_success(tok = symbol<'(', kind::OPEN>::parse(output, pos, str))) {
+                while (true) {
+                    if (is_success(tok = symbol<'(', kind::OPEN>::parse(output, pos, str))) {
+                        if (depth == MAX_NESTING) {
+                            return error {
+                                .cause = errors::NESTING_TOO_DEEP,
+                                .pos = pos,
+                            };
+                        }
+                        outer[opened++] = operand_start;
+                        operand_start = ++depth;
+                    } else if (is_success(tok = prefix_operator::parse(output, pos, str))) {
+                        if (depth == MAX_NESTING) {
+                            return error {
+                                .cause = errors::NESTING_TOO_DEEP,
+                                .pos = pos,
+                            };
+                        }
+                        ++depth;
+                    } else {
+                        break;
+                    }
                     pos = std::get<uint32_t>(tok);
-                    ++opened;
+                    maybe<whitespaces>(output, pos, str);
                 }
 
-                maybe<whitespaces>(output, pos, str);
-
                 if (is_success(tok = alternative<identifier, constant>::parse(output, pos, str))) {
                     pos = std::get<uint32_t>(tok);
+                    depth = operand_start;
                 } else {
                     return error {
                         .cause = errors::IDENTIFIER_OR_CONSTANT_EXPECTED,
@@ -278,14 +430,13 @@ namespace lexer {
 
                 maybe<whitespaces>(output, pos, str);
 
-                if (is_success(tok = symbol<')', kind::CLOSE>::parse(output, pos, str))) {
+                while (opened && is_success(tok = symbol<')', kind::CLOSE>::parse(output, pos, str))) {
                     pos = std::get<uint32_t>(tok);
-                    --opened;
-
+                    depth = operand_start = outer[--opened];
                     maybe<whitespaces>(output, pos, str);
                 }
 
-                if (is_success(tok = operator_sym::parse(output, pos, str))) {
+                if (is_success(tok = binary_operator::parse(output, pos, str))) {
                     pos = std::get<uint32_t>(tok);
                     maybe<whitespaces>(output, pos, str);
                     continue;
@@ -310,7 +461,7 @@ namespace lexer {
             identifier, whitespaces, combinators::symbol<'=', kind::ASSIGNMENT>, whitespaces, expression>; // id = expr
 
     struct statement {
-        static lexer_result parse(std::vector<token> & output, uint32_t pos, std::string_view str) {
+        static constexpr lexer_result parse(token_list & output, uint32_t pos, std::string_view str) {
             using namespace combinators;
 
             auto opened = 0u;
@@ -361,33 +512,27 @@ namespace lexer {
         }
     };
 
-    using program = combinators::sequence<whitespaces, combinators::many<statement>>;
-
-    enum operator_type {
-        PLUS,
-        MINUS,
-        MULTIPLICATION,
-        DIVISION,
-        LESS,
-        GREATER,
-        UNDEFINED
+    // The whole input has to be statements, a statement failing after the first one is an error too
+    struct program {
+        static constexpr lexer_result parse(token_list & output, uint32_t pos, std::string_view str) {
+            trace::span span("lex");
+            auto status = combinators::sequence<whitespaces, statement>::parse(output, pos, str);
+            while (is_success(status) && std::get<uint32_t>(status) < str.size()) {
+                status = statement::parse(output, std::get<uint32_t>(status), str);
+            }
+            return status;
+        }
     };
 
-    operator_type get_operator_type(token tok, std::string_view sv) {
-        switch (sv[tok.begin]) {
-            case '+': return PLUS;
-            case '-': return MINUS;
-            case '*': return MULTIPLICATION;
-            case '/': return DIVISION;
-            case '<': return LESS;
-            case '>': return GREATER;
-        }
-        return UNDEFINED;
+    // Binary operator of an OPERATOR token
+    constexpr operator_type get_operator_type(token tok, std::string_view sv) {
+        auto info = find_operator(binary_operators, sv.substr(tok.begin, tok.len));
+        return info ? info->type : UNDEFINED;
     }
 
     class token_storage {
     public:
-        explicit token_storage(std::vector<lexer::token> const & tokens) {
+        constexpr explicit token_storage(token_list const & tokens) {
             it_ = tokens.begin();
             end_ = tokens.end();
             while (end_ != it_ && (end_ - 1)->type == lexer::kind::WHITESPACE) {
@@ -395,11 +540,11 @@ namespace lexer {
             }
         }
 
-        explicit operator bool() const {
+        constexpr explicit operator bool() const {
             return it_ != end_;
         }
 
-        lexer::token next() {
+        constexpr lexer::token next() {
             while (it_->type == lexer::kind::WHITESPACE && it_ != end_) {
                 ++it_;
             }
@@ -407,7 +552,7 @@ namespace lexer {
         }
 
         [[nodiscard]]
-        lexer::token peek() const {
+        constexpr lexer::token peek() const {
             auto itt = it_;
             while (itt->type == lexer::kind::WHITESPACE && it_ != end_) {
                 ++itt;
@@ -416,8 +561,8 @@ namespace lexer {
         }
 
     private:
-        std::vector<lexer::token>::const_iterator it_;
-        std::vector<lexer::token>::const_iterator end_;
+        token_list::const_iterator it_;
+        token_list::const_iterator end_;
     };
 
 }
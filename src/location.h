@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <string_view>
+#include <vector>
+#include "lexer.h"
+#include "parser.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace location {
+
+    // 1-based line and byte column
+    struct position {
+        uint32_t line;
+        uint32_t column;
+
+        bool operator==(position const &) const = default;
+    };
+
+    struct span {
+        position begin;
+        position end;
+    };
+
+    struct located_error {
+        char const * cause;
+        uint32_t pos;
+        position where;
+    };
+
+    struct located_node {
+        uint16_t node;
+        span where;
+    };
+
+    // Offsets of line starts, built in one pass over the source; lookups are binary searches.
+    class line_index {
+    public:
+        explicit line_index(std::string_view sv) {
+            line_starts_.push_back(0);
+
+            auto data = sv.data();
+            auto size = static_cast<uint32_t>(sv.size());
+            uint32_t pos = 0;
+
+        #if defined(__SSE2__)
+            auto const newline = _mm_set1_epi8('\n');
+            for (; pos + 16 <= size; pos += 16) {
+                auto chunk = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + pos));
+                auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+                while (mask) {
+                    line_starts_.push_back(pos + std::countr_zero(mask) + 1);
+                    mask &= mask - 1;
+                }
+            }
+        #endif
+
+            for (; pos < size; ++pos) {
+                if (data[pos] == '\n') {
+                    line_starts_.push_back(pos + 1);
+                }
+            }
+        }
+
+        [[nodiscard]]
+        uint32_t line_count() const {
+            return line_starts_.size();
+        }
+
+        [[nodiscard]]
+        position get_position(uint32_t offset) const {
+            auto line = std::upper_bound(line_starts_.begin(), line_starts_.end(), offset) - line_starts_.begin();
+            return {
+                .line = static_cast<uint32_t>(line),
+                .column = offset - line_starts_[line - 1] + 1,
+            };
+        }
+
+        [[nodiscard]]
+        span get_span(parser::ast::tree const & tree, uint16_t node) const {
+            auto [from, to] = tree.get_range(node);
+            return {get_position(from), get_position(to)};
+        }
+
+        [[nodiscard]]
+        located_error locate(lexer::error const & err) const {
+            return {err.cause, err.pos, get_position(err.pos)};
+        }
+
+        // e.g. for the result of `find_unused_assignments`
+        template <typename Nodes>
+        [[nodiscard]]
+        std::vector<located_node> locate(parser::ast::tree const & tree, Nodes const & nodes) const {
+            std::vector<located_node> result;
+            result.reserve(nodes.size());
+            for (auto idx : nodes) {
+                result.push_back({static_cast<uint16_t>(idx), get_span(tree, idx)});
+            }
+            return result;
+        }
+
+    private:
+        std::vector<uint32_t> line_starts_;
+    };
+
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+#include "parser.h"
+#include "semantics.h"
+
+namespace optimizer {
+
+    struct folded_tree {
+        parser::ast::tree tree;
+        std::vector<semantics::value> constants; // values of CONST nodes, indexed by node
+    };
+
+    namespace detail {
+
+        using environment = std::map<std::string_view, semantics::value>;
+
+        inline void collect_assigned_variables(
+            parser::ast::tree const & tree,
+            uint16_t node,
+            std::string_view sv,
+            std::set<std::string_view> & assigned
+        ) {
+            repeat: switch (tree.get_kind(node)) {
+                case parser::ast::kind::IF:
+                case parser::ast::kind::WHILE: {
+                    node = tree.get_right(node);
+                    goto repeat;
+                }
+                case parser::ast::kind::ASSIGNMENT: {
+                    assigned.insert(tree.get_symbol(tree.get_left(node), sv));
+                    break;
+                }
+                case parser::ast::kind::STATEMENTS: {
+                    collect_assigned_variables(tree, tree.get_left(node), sv, assigned);
+                    node = tree.get_right(node);
+                    goto repeat;
+                }
+                default:
+                    break;
+            }
+        }
+
+        class folder {
+        public:
+            folder(parser::ast::tree const & tree, std::string_view sv, folded_tree & out)
+                : in_(tree), sv_(sv), out_(out), builder_(out.tree) {}
+
+            // returns the folded statement list or `npos` if every statement was eliminated
+            uint16_t fold_statements(uint16_t node) {
+                std::vector<uint16_t> statements;
+                fold_statement(node, statements);
+
+                if (statements.empty()) {
+                    return parser::ast::tree::npos;
+                }
+
+                auto chain = statements.back();
+                for (auto it = statements.rbegin() + 1; it != statements.rend(); ++it) {
+                    auto seq = builder_.new_node(
+                            parser::ast::kind::STATEMENTS,
+                            out_.tree.get_range(*it).first,
+                            out_.tree.get_range(chain).second
+                    );
+                    builder_.set_left(seq, *it);
+                    builder_.set_right(seq, chain);
+                    chain = seq;
+                }
+                return chain;
+            }
+
+        private:
+            void fold_statement(uint16_t node, std::vector<uint16_t> & statements) {
+                auto [from, to] = in_.get_range(node);
+
+                switch (in_.get_kind(node)) {
+                    case parser::ast::kind::ASSIGNMENT: {
+                        auto rhs = fold_expression(in_.get_right(node));
+                        auto [var_from, var_to] = in_.get_range(in_.get_left(node));
+                        auto lhs = builder_.new_node(parser::ast::kind::VAR, var_from, var_to);
+                        auto assignment = builder_.new_node(parser::ast::kind::ASSIGNMENT, from, to);
+                        builder_.set_left(assignment, lhs);
+                        builder_.set_right(assignment, rhs);
+
+                        auto var = in_.get_symbol(in_.get_left(node), sv_);
+                        if (is_constant(rhs)) {
+                            env_[var] = out_.constants[rhs];
+                        } else {
+                            env_.erase(var);
+                        }
+                        statements.push_back(assignment);
+                        break;
+                    }
+                    case parser::ast::kind::IF: {
+                        auto mark = builder_.size();
+                        auto cond = fold_expression(in_.get_left(node));
+
+                        if (is_constant(cond)) {
+                            auto taken = semantics::is_true(out_.constants[cond]);
+                            builder_.rollback(mark);
+                            if (taken) {
+                                fold_statement(in_.get_right(node), statements); // inline the body
+                            }
+                            break;
+                        }
+
+                        auto before = env_;
+                        auto body = fold_statements(in_.get_right(node));
+                        merge_environment(before);
+
+                        if (body == parser::ast::tree::npos) {
+                            builder_.rollback(mark);
+                            break;
+                        }
+
+                        auto idx = builder_.new_node(parser::ast::kind::IF, from, to);
+                        builder_.set_left(idx, cond);
+                        builder_.set_right(idx, body);
+                        statements.push_back(idx);
+                        break;
+                    }
+                    case parser::ast::kind::WHILE: {
+                        auto before = env_;
+
+                        // values of variables assigned in the body are unknown at every check of the condition
+                        std::set<std::string_view> assigned;
+                        collect_assigned_variables(in_, in_.get_right(node), sv_, assigned);
+                        for (auto const & var : assigned) {
+                            env_.erase(var);
+                        }
+
+                        auto mark = builder_.size();
+                        auto cond = fold_expression(in_.get_left(node));
+
+                        if (is_constant(cond) && !semantics::is_true(out_.constants[cond])) {
+                            builder_.rollback(mark);
+                            env_ = std::move(before);
+                            break;
+                        }
+
+                        auto entry = env_;
+                        auto body_mark = builder_.size();
+                        auto body = fold_statements(in_.get_right(node));
+                        env_ = std::move(entry);
+
+                        if (body == parser::ast::tree::npos) {
+                            // a loop body cannot be empty, keep it as it was
+                            builder_.rollback(body_mark);
+                            body = copy(in_.get_right(node));
+                        }
+
+                        auto idx = builder_.new_node(parser::ast::kind::WHILE, from, to);
+                        builder_.set_left(idx, cond);
+                        builder_.set_right(idx, body);
+                        statements.push_back(idx);
+                        break;
+                    }
+                    case parser::ast::kind::STATEMENTS: {
+                        while (in_.get_kind(node) == parser::ast::kind::STATEMENTS) {
+                            fold_statement(in_.get_left(node), statements);
+                            node = in_.get_right(node);
+                        }
+                        fold_statement(node, statements);
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+
+            uint16_t fold_expression(uint16_t node) {
+                auto [from, to] = in_.get_range(node);
+
+                switch (in_.get_kind(node)) {
+                    case parser::ast::kind::VAR: {
+                        auto it = env_.find(in_.get_symbol(node, sv_));
+                        if (it != env_.end()) {
+                            return new_constant(from, to, it->second);
+                        }
+                        return builder_.new_node(parser::ast::kind::VAR, from, to);
+                    }
+                    case parser::ast::kind::CONST: {
+                        return new_constant(from, to, semantics::parse_constant(in_.get_symbol(node, sv_)));
+                    }
+                    case parser::ast::kind::BINOP: {
+                        auto lhs = fold_expression(in_.get_left(node));
+                        auto rhs = fold_expression(in_.get_right(node));
+                        auto op = in_.get_operator_type(node);
+
+                        if (is_constant(lhs) && is_constant(rhs)) {
+                            auto result = semantics::apply_operator(op, out_.constants[lhs], out_.constants[rhs]);
+                            builder_.rollback(lhs); // both operands are leaves, `rhs == lhs + 1`
+                            return new_constant(from, to, result);
+                        }
+
+                        auto binop = builder_.new_node_binop(op, from, to);
+                        builder_.set_left(binop, lhs);
+                        builder_.set_right(binop, rhs);
+                        return binop;
+                    }
+                    case parser::ast::kind::UNOP: {
+                        auto operand = fold_expression(in_.get_left(node));
+                        auto op = in_.get_operator_type(node);
+
+                        if (is_constant(operand)) {
+                            auto result = semantics::apply_prefix_operator(op, out_.constants[operand]);
+                            builder_.rollback(operand);
+                            return new_constant(from, to, result);
+                        }
+
+                        auto unop = builder_.new_node_unop(op, from, to);
+                        builder_.set_left(unop, operand);
+                        return unop;
+                    }
+                    default:
+                        return copy(node);
+                }
+            }
+
+            uint16_t copy(uint16_t node) {
+                auto [from, to] = in_.get_range(node);
+                auto lhs = in_.have_left(node) ? copy(in_.get_left(node)) : parser::ast::tree::npos;
+                auto rhs = in_.have_right(node) ? copy(in_.get_right(node)) : parser::ast::tree::npos;
+
+                uint16_t idx;
+                switch (in_.get_kind(node)) {
+                    case parser::ast::kind::CONST:
+                        idx = new_constant(from, to, semantics::parse_constant(in_.get_symbol(node, sv_)));
+                        break;
+                    case parser::ast::kind::BINOP:
+                        idx = builder_.new_node_binop(in_.get_operator_type(node), from, to);
+                        break;
+                    case parser::ast::kind::UNOP:
+                        idx = builder_.new_node_unop(in_.get_operator_type(node), from, to);
+                        break;
+                    default:
+                        idx = builder_.new_node(in_.get_kind(node), from, to);
+                        break;
+                }
+
+                if (lhs != parser::ast::tree::npos) {
+                    builder_.set_left(idx, lhs);
+                }
+                if (rhs != parser::ast::tree::npos) {
+                    builder_.set_right(idx, rhs);
+                }
+                return idx;
+            }
+
+            uint16_t new_constant(uint32_t from, uint32_t to, semantics::value v) {
+                auto idx = builder_.new_node(parser::ast::kind::CONST, from, to);
+                out_.constants.resize(builder_.size());
+                out_.constants[idx] = v;
+                return idx;
+            }
+
+            [[nodiscard]]
+            bool is_constant(uint16_t idx) const {
+                return out_.tree.get_kind(idx) == parser::ast::kind::CONST;
+            }
+
+            // keeps only the facts that hold on both paths
+            void merge_environment(environment const & other) {
+                for (auto it = env_.begin(); it != env_.end();) {
+                    auto same = other.find(it->first);
+                    if (same == other.end() || same->second != it->second) {
+                        it = env_.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+
+            parser::ast::tree const & in_;
+            std::string_view sv_;
+            folded_tree & out_;
+            parser::ast::builder builder_;
+            environment env_;
+        };
+
+    }
+
+    // Folds constant expressions, propagates known variable values through the program and
+    // eliminates `if` and `while` statements whose conditions are statically false.
+    // The result references the same source string; it is empty if the whole program was eliminated.
+    inline folded_tree fold_constants(parser::ast::tree const & tree, std::string_view sv) {
+        folded_tree result;
+        detail::folder folder(tree, sv, result);
+
+        auto root = folder.fold_statements(tree.get_root());
+        if (root != parser::ast::tree::npos) {
+            parser::ast::builder(result.tree).set_root(root);
+        }
+        result.constants.resize(result.tree.size());
+        return result;
+    }
+
+}
@@ -1,18 +1,27 @@
 #pragma once
 
+#include <memory_resource>
+#include <optional>
 #include <vector>
+#include "allocator.h"
 #include "lexer.h"
+#include "stats.h"
+#include "trace.h"
 
 namespace parser {
 
     namespace ast {
         class tree;
+        class builder;
     }
 
     namespace detail {
-        uint16_t parse_expression_from_token_list(
+        constexpr uint16_t parse_operand_from_token_list(
                 ast::tree &tree, lexer::token_storage & storage, std::string_view sv);
-        ast::tree parse_from_token_list(lexer::token_storage & tokens, std::string_view sv);
+        constexpr uint16_t parse_expression_from_token_list(
+                ast::tree &tree, lexer::token_storage & storage, std::string_view sv, uint8_t min_precedence = 0);
+        constexpr ast::tree parse_from_token_list(
+                lexer::token_storage & tokens, std::string_view sv, std::pmr::memory_resource * resource);
     }
 
     namespace ast {
@@ -25,6 +34,7 @@ namespace parser {
             CONST,
             BINOP,
             STATEMENTS,
+            UNOP,       // operand on the left
         };
 
         class tree {
@@ -42,7 +52,7 @@ namespace parser {
                 lexer::operator_type op_type = lexer::operator_type::UNDEFINED;
             };
 
-            uint16_t new_node(kind k, uint32_t start, uint32_t end) {
+            constexpr uint16_t new_node(kind k, uint32_t start, uint32_t end) {
                 nodes_.push_back(node{
                     .type = k,
                     .start_pos = start,
@@ -51,7 +61,7 @@ namespace parser {
                 return nodes_.size() - 1;
             }
 
-            uint16_t new_node_binop(lexer::operator_type type, uint32_t start, uint8_t end) {
+            constexpr uint16_t new_node_binop(lexer::operator_type type, uint32_t start, uint32_t end) {
                 nodes_.push_back(node{
                         .type = kind::BINOP,
                         .start_pos = start,
@@ -61,205 +71,294 @@ namespace parser {
                 return nodes_.size() - 1;
             }
 
-            void set_left(uint16_t par_idx, uint16_t ch_idx) {
+            constexpr uint16_t new_node_unop(lexer::operator_type type, uint32_t start, uint32_t end) {
+                nodes_.push_back(node{
+                        .type = kind::UNOP,
+                        .start_pos = start,
+                        .end_pos = end,
+                        .op_type = type
+                });
+                return nodes_.size() - 1;
+            }
+
+            constexpr void set_left(uint16_t par_idx, uint16_t ch_idx) {
                 auto parent = get_node(par_idx);
                 auto child = get_node(ch_idx);
                 parent->op1 = ch_idx;
                 child->par = par_idx;
             }
 
-            void set_right(uint16_t par_idx, uint16_t ch_idx) {
+            constexpr void set_right(uint16_t par_idx, uint16_t ch_idx) {
                 auto parent = get_node(par_idx);
                 auto child = get_node(ch_idx);
                 parent->op2 = ch_idx;
                 child->par = par_idx;
             }
 
-            node * get_node(uint16_t idx) {
+            constexpr node * get_node(uint16_t idx) {
                 return &nodes_[idx];
             }
 
             [[nodiscard]]
-            node const * get_node(uint16_t idx) const {
+            constexpr node const * get_node(uint16_t idx) const {
                 return &nodes_[idx];
             }
 
-            bool is_scope_unfinished(uint16_t idx) {
+            constexpr bool is_scope_unfinished(uint16_t idx) {
                 auto nod = get_node(idx);
                 return (nod->type == kind::IF || nod->type == kind::WHILE) && nod->op2 == node::npos;
             }
 
         public:
+            static constexpr uint16_t npos = node::npos;
+            // node indices are 16 bit and npos is taken
+            static constexpr uint32_t MAX_NODES = npos - 1;
+
+            constexpr tree() = default;
+
+            // nodes are allocated from `resource`, the heap if null
+            constexpr explicit tree(std::pmr::memory_resource * resource) : nodes_(resource) {}
 
             [[nodiscard]]
-            uint16_t get_root() const {
+            constexpr uint16_t get_root() const {
                 return root_;
             }
 
             [[nodiscard]]
-            uint16_t get_left(uint16_t idx) const {
+            constexpr uint16_t get_left(uint16_t idx) const {
                 return get_node(idx)->op1;
             }
 
             [[nodiscard]]
-            uint16_t get_right(uint16_t idx) const {
+            constexpr uint16_t get_right(uint16_t idx) const {
                 return get_node(idx)->op2;
             }
 
             [[nodiscard]]
-            uint16_t get_parent(uint16_t idx) const {
+            constexpr uint16_t get_parent(uint16_t idx) const {
                 return get_node(idx)->par;
             }
 
             [[nodiscard]]
-            uint16_t have_left(uint16_t idx) const {
+            constexpr uint16_t have_left(uint16_t idx) const {
                 return get_left(idx) != node::npos;
             }
 
             [[nodiscard]]
-            uint16_t have_right(uint16_t idx) const {
+            constexpr uint16_t have_right(uint16_t idx) const {
                 return get_right(idx) != node::npos;
             }
 
             [[nodiscard]]
-            uint16_t have_parent(uint16_t idx) const {
+            constexpr uint16_t have_parent(uint16_t idx) const {
                 return get_parent(idx) != node::npos;
             }
 
             [[nodiscard]]
-            lexer::operator_type get_operator_type(uint16_t idx) const {
+            constexpr lexer::operator_type get_operator_type(uint16_t idx) const {
                 return get_node(idx)->op_type;
             }
 
             [[nodiscard]]
-            kind get_kind(uint16_t idx) const {
+            constexpr kind get_kind(uint16_t idx) const {
                 return get_node(idx)->type;
             }
 
             [[nodiscard]]
-            std::pair<uint16_t, uint16_t> get_range(uint16_t idx) const {
+            constexpr std::pair<uint32_t, uint32_t> get_range(uint16_t idx) const {
                 auto node = get_node(idx);
                 return {node->start_pos, node->end_pos};
             }
 
             [[nodiscard]]
-            auto get_string(uint16_t idx, std::string_view sv) const {
+            constexpr auto get_string(uint16_t idx, std::string_view sv) const {
                 auto [from, to] = get_range(idx);
                 return sv.substr(from, to - from);
             }
 
+            // text of a VAR or CONST node without the parentheses its range may include
+            [[nodiscard]]
+            constexpr std::string_view get_symbol(uint16_t idx, std::string_view sv) const {
+                auto str = get_string(idx, sv);
+                while (!str.empty() && !lexer::chars::is_alpha(str.front()) && !lexer::chars::is_digit(str.front())) {
+                    str.remove_prefix(1);
+                }
+                while (!str.empty() && !lexer::chars::is_alpha(str.back()) && !lexer::chars::is_digit(str.back())) {
+                    str.remove_suffix(1);
+                }
+                return str;
+            }
+
+            [[nodiscard]]
+            constexpr uint16_t size() const {
+                return nodes_.size();
+            }
+
+            [[nodiscard]]
+            constexpr bool empty() const {
+                return nodes_.empty();
+            }
+
+            [[nodiscard]]
+            constexpr size_t memory_usage() const {
+                return nodes_.capacity() * sizeof(node);
+            }
+
         private:
-            std::vector<node> nodes_;
+            memory::vector<node> nodes_;
             uint16_t root_ = 0;
 
-            friend uint16_t detail::parse_expression_from_token_list(
+            friend class builder;
+
+            friend constexpr uint16_t detail::parse_operand_from_token_list(
                     ast::tree &tree, lexer::token_storage & storage, std::string_view sv);
-            friend ast::tree detail::parse_from_token_list(lexer::token_storage & tokens, std::string_view sv);
+            friend constexpr uint16_t detail::parse_expression_from_token_list(
+                    ast::tree &tree, lexer::token_storage & storage, std::string_view sv, uint8_t min_precedence);
+            friend constexpr ast::tree detail::parse_from_token_list(
+                    lexer::token_storage & tokens, std::string_view sv, std::pmr::memory_resource * resource);
         };
 
-    }
-
-    uint8_t get_operator_priority(lexer::operator_type t) {
-        switch (t) {
-            case lexer::PLUS:
-            case lexer::MINUS:
-                return 5;
-            case lexer::MULTIPLICATION:
-            case lexer::DIVISION:
-                return 6;
-            default:
-                return 0;
-        }
-    }
-
-    namespace detail {
-        uint16_t parse_expression_from_token_list(ast::tree &tree, lexer::token_storage & storage, std::string_view sv) {
-            std::vector<uint16_t> nodes;
-            std::vector<std::pair<lexer::token, uint8_t>> pending;
+        // Construction interface for passes that produce new trees (optimizer, transforms, ...)
+        class builder {
+        public:
+            constexpr explicit builder(tree & t) : tree_(t) {}
 
-            auto apply_operator_from_stack = [&]() {
-                auto op = pending.back();
-                pending.pop_back();
+            constexpr uint16_t new_node(kind k, uint32_t start, uint32_t end) {
+                return tree_.new_node(k, start, end);
+            }
 
-                auto op1 = nodes.back();
-                nodes.pop_back();
+            constexpr uint16_t new_node_binop(lexer::operator_type type, uint32_t start, uint32_t end) {
+                return tree_.new_node_binop(type, start, end);
+            }
 
-                auto op2 = nodes.back();
-                nodes.pop_back();
+            constexpr uint16_t new_node_unop(lexer::operator_type type, uint32_t start, uint32_t end) {
+                return tree_.new_node_unop(type, start, end);
+            }
 
-                auto binop = tree.new_node_binop(
-                    lexer::get_operator_type(op.first, sv),
-                    tree.get_node(op2)->start_pos,
-                    tree.get_node(op1)->end_pos
-                );
-                nodes.push_back(binop);
-                tree.set_left(binop, op2);
-                tree.set_right(binop, op1);
-            };
+            constexpr void set_left(uint16_t par_idx, uint16_t ch_idx) {
+                tree_.set_left(par_idx, ch_idx);
+            }
 
-            bool ok = true;
-            while (ok && storage) {
-                lexer::token tok = storage.peek();
+            constexpr void set_right(uint16_t par_idx, uint16_t ch_idx) {
+                tree_.set_right(par_idx, ch_idx);
+            }
 
-                switch (tok.type) {
-                    case lexer::kind::IDENTIFIER:
-                        nodes.push_back(tree.new_node(ast::kind::VAR, tok.begin, tok.begin + tok.len));
-                        break;
+            constexpr void set_root(uint16_t idx) {
+                tree_.root_ = idx;
+            }
 
-                    case lexer::kind::CONSTANT:
-                        nodes.push_back(tree.new_node(ast::kind::CONST, tok.begin, tok.begin + tok.len));
-                        break;
+            [[nodiscard]]
+            constexpr uint16_t size() const {
+                return tree_.size();
+            }
 
-                    case lexer::kind::OPEN:
-                        pending.emplace_back(tok, 10);
-                        break;
+            // drops every node created after the tree had `size` nodes
+            constexpr void rollback(uint16_t size) {
+                tree_.nodes_.erase(tree_.nodes_.begin() + size, tree_.nodes_.end());
+            }
 
-                    case lexer::kind::CLOSE:
-                        while (pending.back().first.type != lexer::kind::OPEN) {
-                            apply_operator_from_stack();
-                        }
-                        tree.get_node(nodes.back())->start_pos--;
-                        tree.get_node(nodes.back())->end_pos++;
-                        pending.pop_back();
-                        break;
+        private:
+            tree & tree_;
+        };
 
-                    case lexer::kind::OPERATOR: {
-                        auto priority = get_operator_priority(lexer::get_operator_type(tok, sv));
-                        while (!pending.empty()) {
-                            auto[p_tok, p_pri] = pending.back();
-                            if (p_pri > priority) {
-                                break;
-                            }
-                            apply_operator_from_stack();
-                        }
+    }
 
-                        pending.emplace_back(tok, priority);
-                        break;
-                    }
+    namespace detail {
+        // Operand with its prefix operators, a parenthesized expression is one operand
+        constexpr uint16_t parse_operand_from_token_list(ast::tree &tree, lexer::token_storage & storage, std::string_view sv) {
+            auto tok = storage.next();
+            switch (tok.type) {
+                case lexer::kind::IDENTIFIER:
+                    return tree.new_node(ast::kind::VAR, tok.begin, tok.begin + tok.len);
+
+                case lexer::kind::CONSTANT:
+                    return tree.new_node(ast::kind::CONST, tok.begin, tok.begin + tok.len);
+
+                case lexer::kind::OPEN: {
+                    auto inner = parse_expression_from_token_list(tree, storage, sv);
+                    auto close = storage.next();
+                    // the range covers the parentheses, get_symbol strips them
+                    tree.get_node(inner)->start_pos = tok.begin;
+                    tree.get_node(inner)->end_pos = close.begin + close.len;
+                    return inner;
+                }
 
-                    case lexer::kind::EXPRESSION_FINISH_META:
-                        storage.next();
-                        ok = false;
+                default: { // prefix operator, the lexer allows nothing else here
+                    auto info = lexer::find_operator(lexer::prefix_operators, sv.substr(tok.begin, tok.len));
+                    auto operand = parse_expression_from_token_list(tree, storage, sv, info->precedence);
+                    auto unop = tree.new_node_unop(info->type, tok.begin, tree.get_node(operand)->end_pos);
+                    tree.set_left(unop, operand);
+                    return unop;
+                }
+            }
+        }
 
-                    default:
-                        ok = false;
-                        break;
+        // Precedence climbing: takes binary operators binding at least as tight as `min_precedence`,
+        // leaves the first looser one to the caller. Recursion is bounded by lexer::MAX_NESTING.
+        constexpr uint16_t parse_expression_from_token_list(
+                ast::tree &tree, lexer::token_storage & storage, std::string_view sv, uint8_t min_precedence) {
+            auto lhs = parse_operand_from_token_list(tree, storage, sv);
+            while (true) {
+                auto tok = storage.peek();
+                if (tok.type != lexer::kind::OPERATOR) {
+                    return lhs;
                 }
 
-                if (ok) storage.next();
+                auto info = lexer::find_operator(lexer::binary_operators, sv.substr(tok.begin, tok.len));
+                if (info->precedence < min_precedence) {
+                    return lhs;
+                }
+                storage.next();
+
+                auto rhs = parse_expression_from_token_list(
+                    tree, storage, sv, info->assoc == lexer::associativity::LEFT ? info->precedence + 1 : info->precedence);
+                auto binop = tree.new_node_binop(info->type, tree.get_node(lhs)->start_pos, tree.get_node(rhs)->end_pos);
+                tree.set_left(binop, lhs);
+                tree.set_right(binop, rhs);
+                lhs = binop;
             }
+        }
 
-            while (!pending.empty()) {
-                apply_operator_from_stack();
+        // The error at the token that takes the tree of `tokens` past `ast::tree::MAX_NODES`, to be checked
+        // before `parse_from_token_list`. Operands and operators are a node each, so are if and while; an
+        // assignment is one and the STATEMENTS node joining it to the statement before.
+        constexpr std::optional<lexer::error> check_node_count(lexer::token_list const & tokens) {
+            uint32_t nodes = 0; // one more than the tree gets, the first statement is joined to nothing
+            for (auto const & tok : tokens) {
+                switch (tok.type) {
+                    case lexer::kind::IDENTIFIER:
+                    case lexer::kind::CONSTANT:
+                    case lexer::kind::OPERATOR:
+                    case lexer::kind::IF:
+                    case lexer::kind::WHILE:
+                        ++nodes;
+                        break;
+                    case lexer::kind::ASSIGNMENT:
+                        nodes += 2;
+                        break;
+                    default:
+                        continue;
+                }
+                if (nodes > ast::tree::MAX_NODES + 1) {
+                    return lexer::error{.cause = lexer::errors::TOO_MANY_NODES, .pos = tok.begin};
+                }
             }
-
-            return nodes.back();
+            return std::nullopt;
         }
 
-        ast::tree parse_from_token_list(lexer::token_storage & tokens, std::string_view sv) {
-            ast::tree tree;
+        constexpr ast::tree parse_from_token_list(
+                lexer::token_storage & tokens, std::string_view sv, std::pmr::memory_resource * resource) {
+            trace::span span("parse");
+            ast::tree tree(resource);
+
+            memory::vector<uint16_t> pending(resource);
 
-            std::vector<uint16_t> pending;
+            // a whole expression, closed by the lexer's meta-token
+            auto expression = [&] {
+                auto root = parse_expression_from_token_list(tree, tokens, sv);
+                tokens.next(); // EXPRESSION_FINISH_META
+                return root;
+            };
 
             while (tokens) {
                 auto tok = tokens.next();
@@ -267,14 +366,14 @@ namespace parser {
                     case lexer::kind::IF: {
                         auto idx = tree.new_node(ast::kind::IF, tok.begin, tok.begin + tok.len);
                         pending.push_back(idx);
-                        tree.set_left(idx, parse_expression_from_token_list(tree, tokens, sv));
+                        tree.set_left(idx, expression());
                         break;
                     }
 
                     case lexer::kind::WHILE: {
                         auto idx = tree.new_node(ast::kind::WHILE, tok.begin, tok.begin + tok.len);
                         pending.push_back(idx);
-                        tree.set_left(idx, parse_expression_from_token_list(tree, tokens, sv));
+                        tree.set_left(idx, expression());
                         break;
                     }
 
@@ -301,7 +400,7 @@ namespace parser {
 
                     default: {
                         tokens.next(); // token '='
-                        auto expr = parse_expression_from_token_list(tree, tokens, sv);
+                        auto expr = expression();
 
                         auto node = tree.new_node(ast::kind::ASSIGNMENT, tok.begin, tree.get_node(expr)->end_pos);
 
@@ -338,16 +437,57 @@ namespace parser {
         }
     }
 
-    std::variant<ast::tree, lexer::error> parse(std::string_view sv) {
-        std::vector<lexer::token> tokens;
-        auto result = lexer::program::parse(tokens, 0, sv);
+    namespace detail {
+        template <typename Recorder>
+        constexpr std::variant<ast::tree, lexer::error> parse(
+                std::string_view sv, Recorder & recorder, std::pmr::memory_resource * resource) {
+            lexer::token_list tokens(resource);
+            lexer::lexer_result result;
+            {
+                [[maybe_unused]] auto scope = recorder.measure(stats::LEX);
+                result = lexer::program::parse(tokens, 0, sv);
+            }
 
-        if (std::holds_alternative<lexer::error>(result)) {
-            return std::get<lexer::error>(result);
+            recorder.update([&](stats::pipeline_stats & s) {
+                s.tokens = tokens.size();
+                s.token_bytes = std::max<uint64_t>(s.token_bytes, tokens.capacity() * sizeof(lexer::token));
+            });
+
+            if (std::holds_alternative<lexer::error>(result)) {
+                return std::get<lexer::error>(result);
+            }
+            if (auto error = check_node_count(tokens)) {
+                return *error;
+            }
+
+            [[maybe_unused]] auto scope = recorder.measure(stats::PARSE);
+            lexer::token_storage storage(tokens);
+            auto tree = parse_from_token_list(storage, sv, resource);
+
+            recorder.update([&](stats::pipeline_stats & s) {
+                s.nodes = tree.size();
+                s.node_bytes = std::max<uint64_t>(s.node_bytes, tree.memory_usage());
+            });
+            return tree;
         }
+    }
+
+    constexpr std::variant<ast::tree, lexer::error> parse(std::string_view sv) {
+        stats::disabled recorder;
+        return detail::parse(sv, recorder, nullptr);
+    }
+
+    // Same as `parse`, also fills lexing and parsing statistics; the tokens and the tree come from
+    // `stats::counting_heap` so that their allocations are counted
+    inline std::variant<ast::tree, lexer::error> parse(std::string_view sv, stats::pipeline_stats & statistics) {
+        stats::recorder recorder(statistics);
+        return detail::parse(sv, recorder, stats::counting_heap());
+    }
 
-        lexer::token_storage storage(tokens);
-        return detail::parse_from_token_list(storage, sv);
+    // Same as `parse`, the tokens and the tree are allocated from `resource`; the tree must not outlive it
+    inline std::variant<ast::tree, lexer::error> parse(std::string_view sv, std::pmr::memory_resource * resource) {
+        stats::disabled recorder;
+        return detail::parse(sv, recorder, resource);
     }
 
-}
\ No newline at end of file
+}
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <charconv>
+#include <ostream>
+#include <string>
+#include <vector>
 #include "lexer.h"
 #include "parser.h"
+#include "visitor.h"
 
 namespace detail {
-    auto kind_to_string(parser::ast::kind k) {
+    inline auto kind_to_string(parser::ast::kind k) {
         switch (k) {
             case parser::ast::kind::IF:
                 return "IF";
@@ -20,11 +25,13 @@ namespace detail {
                 return "BINOP";
             case parser::ast::kind::STATEMENTS:
                 return "STATEMENTS";
+            case parser::ast::kind::UNOP:
+                return "UNOP";
         }
         return "";
     }
 
-    auto type_to_string(lexer::operator_type t) {
+    inline auto type_to_string(lexer::operator_type t) {
         switch (t) {
             case lexer::PLUS:
                 return "PLUS";
@@ -40,45 +47,207 @@ namespace detail {
                 return "GREATER";
             case lexer::UNDEFINED:
                 return "UNDEFINED";
+            case lexer::EQUAL:
+                return "EQUAL";
+            case lexer::NOT_EQUAL:
+                return "NOT_EQUAL";
+            case lexer::LESS_EQUAL:
+                return "LESS_EQUAL";
+            case lexer::GREATER_EQUAL:
+                return "GREATER_EQUAL";
+            case lexer::AND:
+                return "AND";
+            case lexer::OR:
+                return "OR";
+            case lexer::NEGATION:
+                return "NEGATION";
         }
         return "";
     }
 
-    void print(
-            std::ostream &out,
-            parser::ast::tree const &tree,
-            std::string const &prefix,
-            std::string_view sv,
-            uint16_t node
-    ) {
-        auto op_type = tree.get_operator_type(node);
-        auto[from, to] = tree.get_range(node);
-
-        out << prefix << "{ " << kind_to_string(tree.get_kind(node))
-            << (op_type == lexer::UNDEFINED ? "" : std::string(" ") + type_to_string(op_type))
-            << " [" << from << ".." << to << "] '" << tree.get_string(node, sv) << "'";
-
-        if (!tree.have_left(node) && !tree.have_right(node)) {
-            out << '}' << std::endl;
-            return;
+    class output_buffer {
+    public:
+        static constexpr size_t chunk_size = 1 << 16;
+
+        explicit output_buffer(std::ostream &out) : out_(&out), buffer_(own_) {
+            buffer_.reserve(chunk_size * 2);
         }
 
-        out << std::endl;
+        // appends to `target` directly, nothing is flushed
+        explicit output_buffer(std::string &target) : buffer_(target) {}
+
+        output_buffer(output_buffer const &) = delete;
+        output_buffer &operator=(output_buffer const &) = delete;
 
-        if (tree.have_left(node)) {
-            print(out, tree, prefix + "   ", sv, tree.get_left(node));
+        ~output_buffer() {
+            flush();
         }
-        if (tree.have_right(node)) {
-            print(out, tree, prefix + "   ", sv, tree.get_right(node));
+
+        void append(std::string_view str) {
+            buffer_.append(str);
+            maybe_flush();
         }
 
-        out << prefix << "}" << std::endl;
-    }
+        void append(char c) {
+            buffer_.push_back(c);
+            maybe_flush();
+        }
+
+        void append_number(uint32_t value) {
+            char digits[10];
+            auto [end, _] = std::to_chars(digits, digits + sizeof(digits), value);
+            append(std::string_view(digits, end - digits));
+        }
+
+        void append_indent(uint32_t width) {
+            buffer_.append(width, ' ');
+            maybe_flush();
+        }
+
+        template <typename T>
+        void append_binary(T value) { // little-endian
+            for (auto idx = 0u; idx < sizeof(T); ++idx) {
+                buffer_.push_back(static_cast<char>(static_cast<uint64_t>(value) >> (8 * idx)));
+            }
+            maybe_flush();
+        }
+
+        void flush() {
+            if (out_) {
+                out_->write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+                buffer_.clear();
+            }
+        }
+
+    private:
+        void maybe_flush() {
+            if (out_ && buffer_.size() >= chunk_size) {
+                flush();
+            }
+        }
+
+        std::ostream *out_ = nullptr;
+        std::string own_;
+        std::string &buffer_;
+    };
 }
 
 namespace printer {
-    void print(std::ostream &out, parser::ast::tree const &tree, std::string_view sv) {
-        detail::print(out, tree, "", sv, tree.get_root());
+    inline void print(std::ostream &out, parser::ast::tree const &tree, std::string_view sv) {
+        detail::output_buffer buffer(out);
+
+        parser::ast::walk(tree, [&](uint16_t node, uint32_t depth) {
+            auto op_type = tree.get_operator_type(node);
+            auto [from, to] = tree.get_range(node);
+
+            buffer.append_indent(depth * 3);
+            buffer.append("{ ");
+            buffer.append(detail::kind_to_string(tree.get_kind(node)));
+            if (op_type != lexer::UNDEFINED) {
+                buffer.append(' ');
+                buffer.append(detail::type_to_string(op_type));
+            }
+            buffer.append(" [");
+            buffer.append_number(from);
+            buffer.append("..");
+            buffer.append_number(to);
+            buffer.append("] '");
+            buffer.append(tree.get_string(node, sv));
+            buffer.append('\'');
+
+            if (!tree.have_left(node) && !tree.have_right(node)) {
+                buffer.append('}');
+            }
+            buffer.append('\n');
+        }, [&](uint16_t node, uint32_t depth) {
+            if (tree.have_left(node) || tree.have_right(node)) {
+                buffer.append_indent(depth * 3);
+                buffer.append("}\n");
+            }
+        });
     }
-}
 
+    // One JSON object per line in pre-order:
+    // {"id":3,"kind":"BINOP","operator":"PLUS","range":[4,9],"children":[1,2]}
+    inline void print_json(detail::output_buffer &buffer, parser::ast::tree const &tree) {
+        for (auto node : parser::ast::preorder(tree)) {
+            auto op_type = tree.get_operator_type(node);
+            auto [from, to] = tree.get_range(node);
+
+            buffer.append("{\"id\":");
+            buffer.append_number(node);
+            buffer.append(",\"kind\":\"");
+            buffer.append(detail::kind_to_string(tree.get_kind(node)));
+            buffer.append("\",\"operator\":");
+            if (op_type == lexer::UNDEFINED) {
+                buffer.append("null");
+            } else {
+                buffer.append('"');
+                buffer.append(detail::type_to_string(op_type));
+                buffer.append('"');
+            }
+            buffer.append(",\"range\":[");
+            buffer.append_number(from);
+            buffer.append(',');
+            buffer.append_number(to);
+            buffer.append("],\"children\":[");
+            auto children = parser::ast::children(tree, node);
+            for (auto child : children) {
+                if (child != *children.begin()) {
+                    buffer.append(',');
+                }
+                buffer.append_number(child);
+            }
+            buffer.append("]}\n");
+        }
+    }
+
+    inline void print_json(std::ostream &out, parser::ast::tree const &tree) {
+        detail::output_buffer buffer(out);
+        print_json(buffer, tree);
+    }
+
+    // Appends to `out`, e.g. to reuse one buffer for many trees
+    inline void print_json(std::string &out, parser::ast::tree const &tree) {
+        detail::output_buffer buffer(out);
+        print_json(buffer, tree);
+    }
+
+    namespace binary {
+        constexpr char MAGIC[] = "SPAST";
+        constexpr uint8_t VERSION = 2;
+        constexpr uint8_t HAS_LEFT = 1;
+        constexpr uint8_t HAS_RIGHT = 2;
+    }
+
+    // Compact pre-order dump, all integers are little-endian:
+    //   header: "SPAST" u8 version, u32 node count
+    //   node:   u8 kind, u8 operator, u8 child flags (HAS_LEFT | HAS_RIGHT), u32 from, u32 to
+    // Children follow their parent (left subtree first), so the tree is restored with a single stack.
+    inline void print_binary(detail::output_buffer &buffer, parser::ast::tree const &tree) {
+        buffer.append(std::string_view(binary::MAGIC, sizeof(binary::MAGIC) - 1));
+        buffer.append_binary<uint8_t>(binary::VERSION);
+        buffer.append_binary<uint32_t>(tree.size());
+
+        for (auto node : parser::ast::preorder(tree)) {
+            auto [from, to] = tree.get_range(node);
+            uint8_t flags = (tree.have_left(node) ? binary::HAS_LEFT : 0) | (tree.have_right(node) ? binary::HAS_RIGHT : 0);
+
+            buffer.append_binary<uint8_t>(static_cast<uint8_t>(tree.get_kind(node)));
+            buffer.append_binary<uint8_t>(static_cast<uint8_t>(tree.get_operator_type(node)));
+            buffer.append_binary<uint8_t>(flags);
+            buffer.append_binary<uint32_t>(from);
+            buffer.append_binary<uint32_t>(to);
+        }
+    }
+
+    inline void print_binary(std::ostream &out, parser::ast::tree const &tree) {
+        detail::output_buffer buffer(out);
+        print_binary(buffer, tree);
+    }
+
+    inline void print_binary(std::string &out, parser::ast::tree const &tree) {
+        detail::output_buffer buffer(out);
+        print_binary(buffer, tree);
+    }
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "eval.h"
+#include "location.h"
+#include "visitor.h"
+
+// Reports of an `eval::profile`: the hot spots of a program with their source ranges, and the
+// folded stacks flamegraph.pl and speedscope read, one `outer;inner;statement cycles` line per statement.
+namespace profiler {
+
+    struct hot_spot {
+        uint16_t node;
+        std::pair<uint32_t, uint32_t> range;
+        uint64_t count;
+        uint64_t self_cycles;
+        uint64_t total_cycles; // with the statements of its body
+    };
+
+    namespace detail {
+
+        inline bool is_statement(parser::ast::tree const & tree, uint16_t node) {
+            auto k = tree.get_kind(node);
+            return k == parser::ast::kind::IF || k == parser::ast::kind::WHILE || k == parser::ast::kind::ASSIGNMENT;
+        }
+
+        // innermost if or while holding every node, npos at the top level; one pass, the glue of long
+        // statement lists is not climbed for every statement
+        inline std::vector<uint16_t> enclosing_statements(parser::ast::tree const & tree) {
+            std::vector<uint16_t> result(tree.size(), parser::ast::tree::npos);
+            for (auto node : parser::ast::preorder(tree)) {
+                for (auto child : parser::ast::children(tree, node)) {
+                    result[child] = is_statement(tree, node) ? node : result[node];
+                }
+            }
+            return result;
+        }
+
+        // `while x < 10 @2:1`: the whole assignment or the condition of an if or a while, on one line
+        inline std::string label(parser::ast::tree const & tree, std::string_view sv, location::line_index const & lines, uint16_t node) {
+            std::string result;
+            std::string_view text = tree.get_string(node, sv);
+            if (tree.get_kind(node) == parser::ast::kind::IF) {
+                result = lexer::token_strings::IF;
+                text = tree.get_string(tree.get_left(node), sv);
+            } else if (tree.get_kind(node) == parser::ast::kind::WHILE) {
+                result = lexer::token_strings::WHILE;
+                text = tree.get_string(tree.get_left(node), sv);
+            }
+            if (!result.empty()) {
+                result.push_back(' ');
+            }
+            for (auto c : text) {
+                if (!lexer::chars::is_whitespace(c)) {
+                    result.push_back(c);
+                } else if (!result.empty() && result.back() != ' ') {
+                    result.push_back(' ');
+                }
+            }
+
+            auto where = lines.get_position(tree.get_range(node).first);
+            result.append(" @").append(std::to_string(where.line)).append(":").append(std::to_string(where.column));
+            return result;
+        }
+
+    }
+
+    // Statements that ran, the most self cycles first
+    inline std::vector<hot_spot> hot_spots(parser::ast::tree const & tree, eval::profile const & p) {
+        // a statement is done before the one holding it, which then takes its total
+        auto enclosing = detail::enclosing_statements(tree);
+        std::vector<uint64_t> totals(tree.size());
+        for (auto node : parser::ast::postorder(tree)) {
+            if (detail::is_statement(tree, node)) {
+                totals[node] += p.cycles[node];
+                if (enclosing[node] != parser::ast::tree::npos) {
+                    totals[enclosing[node]] += totals[node];
+                }
+            }
+        }
+
+        std::vector<hot_spot> result;
+        for (uint16_t node = 0; node < tree.size(); ++node) {
+            if (detail::is_statement(tree, node) && p.counts[node]) {
+                result.push_back({node, tree.get_range(node), p.counts[node], p.cycles[node], totals[node]});
+            }
+        }
+        std::stable_sort(result.begin(), result.end(), [](hot_spot const & a, hot_spot const & b) {
+            return a.self_cycles > b.self_cycles;
+        });
+        return result;
+    }
+
+    // One hot spot per line: share of all cycles, self and total cycles, executions, statement
+    inline void write_report(std::ostream & out, parser::ast::tree const & tree, std::string_view sv, eval::profile const & p) {
+        location::line_index lines(sv);
+        auto spots = hot_spots(tree, p);
+        uint64_t all = 0;
+        for (auto const & s : spots) {
+            all += s.self_cycles;
+        }
+
+        out << "self%\tself\ttotal\tcount\tstatement\n";
+        for (auto const & s : spots) {
+            out << (all ? 100.0 * s.self_cycles / all : 0) << '\t' << s.self_cycles << '\t' << s.total_cycles << '\t'
+                << s.count << '\t' << detail::label(tree, sv, lines, s.node) << '\n';
+        }
+    }
+
+    // Folded stacks of the self cycles, a frame per enclosing statement
+    inline void write_folded(std::ostream & out, parser::ast::tree const & tree, std::string_view sv, eval::profile const & p) {
+        location::line_index lines(sv);
+        auto enclosing = detail::enclosing_statements(tree);
+        std::vector<uint16_t> stack;
+        for (auto const & s : hot_spots(tree, p)) {
+            if (!s.self_cycles) {
+                continue;
+            }
+            stack.clear();
+            for (auto holder = s.node; holder != parser::ast::tree::npos; holder = enclosing[holder]) {
+                stack.push_back(holder);
+            }
+            for (auto frame = stack.rbegin(); frame != stack.rend(); ++frame) {
+                out << detail::label(tree, sv, lines, *frame) << (frame + 1 == stack.rend() ? ' ' : ';');
+            }
+            out << s.self_cycles << '\n';
+        }
+    }
+
+}
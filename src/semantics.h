@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include "lexer.h"
+
+// Value semantics of the language: 64-bit two's complement integers.
+// Arithmetic wraps around, division truncates towards zero, `x / 0 == 0`,
+// comparisons and logical operators produce 0 or 1 and any non-zero value is true.
+namespace semantics {
+
+    using value = int64_t;
+
+    inline value parse_constant(std::string_view digits) {
+        uint64_t result = 0;
+        for (char c : digits) {
+            result = result * 10 + static_cast<uint64_t>(c - '0');
+        }
+        return static_cast<value>(result);
+    }
+
+    inline value apply_operator(lexer::operator_type type, value lhs, value rhs) {
+        auto l = static_cast<uint64_t>(lhs);
+        auto r = static_cast<uint64_t>(rhs);
+
+        switch (type) {
+            case lexer::PLUS:
+                return static_cast<value>(l + r);
+            case lexer::MINUS:
+                return static_cast<value>(l - r);
+            case lexer::MULTIPLICATION:
+                return static_cast<value>(l * r);
+            case lexer::DIVISION:
+                if (rhs == 0) {
+                    return 0;
+                }
+                if (lhs == std::numeric_limits<value>::min() && rhs == -1) {
+                    return lhs;
+                }
+                return lhs / rhs;
+            case lexer::LESS:
+                return lhs < rhs;
+            case lexer::GREATER:
+                return lhs > rhs;
+            case lexer::EQUAL:
+                return lhs == rhs;
+            case lexer::NOT_EQUAL:
+                return lhs != rhs;
+            case lexer::LESS_EQUAL:
+                return lhs <= rhs;
+            case lexer::GREATER_EQUAL:
+                return lhs >= rhs;
+            case lexer::AND:
+                return lhs != 0 && rhs != 0;
+            case lexer::OR:
+                return lhs != 0 || rhs != 0;
+            default:
+                return 0;
+        }
+    }
+
+    inline value apply_prefix_operator(lexer::operator_type type, value operand) {
+        switch (type) {
+            case lexer::NEGATION:
+                return static_cast<value>(0 - static_cast<uint64_t>(operand));
+            default:
+                return 0;
+        }
+    }
+
+    bool constexpr is_true(value v) {
+        return v != 0;
+    }
+
+}
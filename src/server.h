@@ -0,0 +1,619 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "analyze.h"
+#include "driver.h"
+#include "location.h"
+#include "parser.h"
+#include "pretty_print.h"
+#include "thread_pool.h"
+
+namespace server {
+
+    // Frames in both directions are a little-endian u32 payload length followed by the payload.
+    //   request payload:  u8 command, u8 format, program source
+    //   response payload: u8 status, body
+    //
+    // Bodies:
+    //   PARSE, BINARY      `printer::print_binary` dump
+    //   PARSE, JSON        `printer::print_json` lines
+    //   ANALYZE, BINARY    u32 count, then u32 begin, u32 end of every unused assignment in source order
+    //   ANALYZE, JSON      {"unused":[{"begin":..,"end":..,"line":..,"column":..,"text":".."}]}
+    //   SYNTAX_ERROR       BINARY: u32 offset, u32 line, u32 column, cause; JSON: {"error":{...}}
+    //   BAD_REQUEST        message text
+    namespace protocol {
+
+        enum command : uint8_t {
+            PARSE = 1,
+            ANALYZE = 2,
+        };
+
+        enum format : uint8_t {
+            BINARY = 0,
+            JSON = 1,
+        };
+
+        enum status : uint8_t {
+            OK = 0,
+            SYNTAX_ERROR = 1,
+            BAD_REQUEST = 2,
+        };
+
+        constexpr size_t HEADER_SIZE = 4;
+        constexpr uint32_t MAX_PAYLOAD = 64 << 20;
+
+        inline void append_u32(std::string & out, uint32_t value) {
+            for (auto idx = 0u; idx < 4; ++idx) {
+                out.push_back(static_cast<char>(value >> (8 * idx)));
+            }
+        }
+
+        inline uint32_t read_u32(char const * data) {
+            uint32_t value = 0;
+            for (auto idx = 0u; idx < 4; ++idx) {
+                value |= static_cast<uint32_t>(static_cast<unsigned char>(data[idx])) << (8 * idx);
+            }
+            return value;
+        }
+
+    }
+
+    // Scratch state a worker keeps between requests. Tokens, tree and analysis of a request are
+    // allocated from the arena, which is reset once the response is written.
+    struct worker_session {
+        static constexpr size_t ARENA_SIZE = 1 << 20;
+
+        std::unique_ptr<std::byte[]> buffer = std::make_unique_for_overwrite<std::byte[]>(ARENA_SIZE);
+        std::pmr::monotonic_buffer_resource arena{buffer.get(), ARENA_SIZE};
+        uint64_t requests = 0;
+    };
+
+    namespace detail {
+
+        inline void begin_frame(std::string & out, protocol::status status) {
+            out.clear();
+            out.append(protocol::HEADER_SIZE, '\0');
+            out.push_back(static_cast<char>(status));
+        }
+
+        inline void end_frame(std::string & out) {
+            auto length = static_cast<uint32_t>(out.size() - protocol::HEADER_SIZE);
+            for (auto idx = 0u; idx < 4; ++idx) {
+                out[idx] = static_cast<char>(length >> (8 * idx));
+            }
+        }
+
+        inline void syntax_error(std::string & out, protocol::format format, std::string_view source, lexer::error const & err) {
+            auto pos = location::line_index(source).get_position(err.pos);
+            begin_frame(out, protocol::SYNTAX_ERROR);
+            if (format == protocol::JSON) {
+                out += "{\"error\":{\"cause\":";
+                driver::detail::append_json_string(out, err.cause);
+                out += ",\"offset\":";
+                driver::detail::append_number(out, err.pos);
+                out += ",\"line\":";
+                driver::detail::append_number(out, pos.line);
+                out += ",\"column\":";
+                driver::detail::append_number(out, pos.column);
+                out += "}}";
+            } else {
+                protocol::append_u32(out, err.pos);
+                protocol::append_u32(out, pos.line);
+                protocol::append_u32(out, pos.column);
+                out += err.cause;
+            }
+        }
+
+        inline void analysis(std::string & out, protocol::format format, parser::ast::tree const & tree,
+                             std::string_view source, std::span<uint32_t const> unused) {
+            begin_frame(out, protocol::OK);
+            if (format == protocol::BINARY) {
+                protocol::append_u32(out, unused.size());
+                for (auto idx : unused) {
+                    auto [begin, end] = tree.get_range(idx);
+                    protocol::append_u32(out, begin);
+                    protocol::append_u32(out, end);
+                }
+                return;
+            }
+
+            location::line_index lines(source);
+            out += "{\"unused\":[";
+            for (size_t idx = 0; idx < unused.size(); ++idx) {
+                auto [begin, end] = tree.get_range(unused[idx]);
+                auto pos = lines.get_position(begin);
+                out += idx ? ",{\"begin\":" : "{\"begin\":";
+                driver::detail::append_number(out, begin);
+                out += ",\"end\":";
+                driver::detail::append_number(out, end);
+                out += ",\"line\":";
+                driver::detail::append_number(out, pos.line);
+                out += ",\"column\":";
+                driver::detail::append_number(out, pos.column);
+                out += ",\"text\":";
+                driver::detail::append_json_string(out, tree.get_string(unused[idx], source));
+                out.push_back('}');
+            }
+            out += "]}";
+        }
+
+        inline void respond(std::string_view payload, std::pmr::memory_resource * arena, std::string & out) {
+            if (payload.size() < 2 || (payload[1] != protocol::BINARY && payload[1] != protocol::JSON)
+                || (payload[0] != protocol::PARSE && payload[0] != protocol::ANALYZE)) {
+                begin_frame(out, protocol::BAD_REQUEST);
+                out += "malformed request header";
+                end_frame(out);
+                return;
+            }
+
+            auto command = static_cast<protocol::command>(payload[0]);
+            auto format = static_cast<protocol::format>(payload[1]);
+            auto source = payload.substr(2);
+
+            auto parsed = parser::parse(source, arena);
+            if (auto err = std::get_if<lexer::error>(&parsed)) {
+                syntax_error(out, format, source, *err);
+                end_frame(out);
+                return;
+            }
+            auto const & tree = std::get<parser::ast::tree>(parsed);
+
+            if (command == protocol::PARSE) {
+                begin_frame(out, protocol::OK);
+                if (format == protocol::JSON) {
+                    printer::print_json(out, tree);
+                } else {
+                    printer::print_binary(out, tree);
+                }
+            } else {
+                auto unused = find_unused_assignments(tree, source, arena);
+                std::sort(unused.begin(), unused.end(), [&](uint32_t l, uint32_t r) {
+                    return tree.get_range(l).first < tree.get_range(r).first;
+                });
+                analysis(out, format, tree, source, unused);
+            }
+            end_frame(out);
+        }
+
+    }
+
+    // Turns one request payload into a whole response frame in `out`
+    inline void handle_request(std::string_view payload, worker_session & session, std::string & out) {
+        ++session.requests;
+        detail::respond(payload, &session.arena, out);
+        session.arena.release(); // everything the request allocated, in one go
+    }
+
+    // Listens on a Unix domain socket. One epoll thread does all socket I/O, complete requests are handed
+    // to a worker pool with a warm session per worker. A connection has at most one request in flight,
+    // so pipelined requests are answered in order.
+    class daemon {
+    public:
+        explicit daemon(std::string path, unsigned workers = std::thread::hardware_concurrency())
+            : path_(std::move(path)), sessions_(std::max(workers, 1u)), pool_(std::max(workers, 1u)) {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if (path_.size() >= sizeof(address.sun_path)) {
+                throw std::system_error(ENAMETOOLONG, std::generic_category(), path_);
+            }
+            std::memcpy(address.sun_path, path_.c_str(), path_.size() + 1);
+
+            listen_fd_ = check(::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), "socket");
+            ::unlink(path_.c_str());
+            check(::bind(listen_fd_, reinterpret_cast<sockaddr const *>(&address), sizeof(address)), "bind");
+            check(::listen(listen_fd_, SOMAXCONN), "listen");
+
+            wake_fd_ = check(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC), "eventfd");
+            epoll_fd_ = check(::epoll_create1(EPOLL_CLOEXEC), "epoll_create1");
+            watch(listen_fd_, LISTEN_ID, EPOLLIN, EPOLL_CTL_ADD);
+            watch(wake_fd_, WAKE_ID, EPOLLIN, EPOLL_CTL_ADD);
+        }
+
+        daemon(daemon const &) = delete;
+        daemon & operator=(daemon const &) = delete;
+
+        ~daemon() {
+            pool_.wait();
+            for (auto & [id, conn] : connections_) {
+                ::close(conn->fd);
+            }
+            for (auto fd : {listen_fd_, wake_fd_, epoll_fd_}) {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+            }
+            ::unlink(path_.c_str());
+        }
+
+        // Runs the event loop in the calling thread until `stop`
+        void serve() {
+            epoll_event events[64];
+            while (!stopping_.load(std::memory_order_acquire)) {
+                auto count = ::epoll_wait(epoll_fd_, events, std::size(events), -1);
+                if (count < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw std::system_error(errno, std::generic_category(), "epoll_wait");
+                }
+
+                for (int idx = 0; idx < count; ++idx) {
+                    auto id = events[idx].data.u64;
+                    if (id == LISTEN_ID) {
+                        accept_connections();
+                    } else if (id == WAKE_ID) {
+                        uint64_t ignored;
+                        (void) !::read(wake_fd_, &ignored, sizeof(ignored));
+                        finish_requests();
+                    } else if (auto it = connections_.find(id); it != connections_.end()) {
+                        on_event(*it->second, events[idx].events);
+                    }
+                }
+            }
+        }
+
+        // Safe to call from any thread and from signal handlers
+        void stop() {
+            stopping_.store(true, std::memory_order_release);
+            uint64_t one = 1;
+            (void) !::write(wake_fd_, &one, sizeof(one));
+        }
+
+        [[nodiscard]]
+        std::string const & path() const {
+            return path_;
+        }
+
+    private:
+        static constexpr uint64_t LISTEN_ID = 0;
+        static constexpr uint64_t WAKE_ID = 1;
+        static constexpr size_t READ_SIZE = 1 << 16;
+
+        struct connection {
+            int fd;
+            uint64_t id;
+            std::string in;
+            size_t consumed = 0;  // frames before this offset of `in` are handed out
+            std::string out;
+            size_t written = 0;
+            bool busy = false;    // a request is being handled by a worker
+            bool closed = false;  // peer is gone, close once the worker is done
+            bool writing = false; // EPOLLOUT is watched
+            bool eof = false;     // peer is done sending, close once its requests are answered
+        };
+
+        struct completion {
+            uint64_t id;
+            std::string response;
+        };
+
+        static int check(int result, char const * what) {
+            if (result < 0) {
+                throw std::system_error(errno, std::generic_category(), what);
+            }
+            return result;
+        }
+
+        void watch(int fd, uint64_t id, uint32_t events, int op) {
+            epoll_event event{};
+            event.events = events;
+            event.data.u64 = id;
+            check(::epoll_ctl(epoll_fd_, op, fd, &event), "epoll_ctl");
+        }
+
+        static uint32_t interest(connection const & conn) {
+            return (conn.eof ? 0 : EPOLLIN | EPOLLRDHUP) | (conn.writing ? EPOLLOUT : 0);
+        }
+
+        void accept_connections() {
+            while (true) {
+                auto fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) {
+                    return; // EAGAIN, or a connection which is already gone
+                }
+                auto id = next_id_++;
+                auto conn = std::make_unique<connection>();
+                conn->fd = fd;
+                conn->id = id;
+                watch(fd, id, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+                connections_.emplace(id, std::move(conn));
+            }
+        }
+
+        void on_event(connection & conn, uint32_t events) {
+            if ((events & EPOLLOUT) && !flush(conn)) {
+                return;
+            }
+            if (events & (EPOLLHUP | EPOLLERR)) {
+                close(conn); // nothing can be sent any more
+                return;
+            }
+            if (!conn.eof && (events & (EPOLLIN | EPOLLRDHUP))) {
+                // compacted once per read rather than once per frame, which is quadratic in pipelined frames
+                conn.in.erase(0, conn.consumed);
+                conn.consumed = 0;
+                char buffer[READ_SIZE];
+                while (true) {
+                    auto n = ::read(conn.fd, buffer, sizeof(buffer));
+                    if (n > 0) {
+                        conn.in.append(buffer, n);
+                        continue;
+                    }
+                    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                        break;
+                    }
+                    if (n < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (n < 0) {
+                        close(conn);
+                        return;
+                    }
+                    // a half-closed peer still reads: the frames it sent are answered first
+                    conn.eof = true;
+                    watch(conn.fd, conn.id, interest(conn), EPOLL_CTL_MOD);
+                    break;
+                }
+                if (!dispatch(conn)) {
+                    return;
+                }
+            }
+            close_if_answered(conn);
+        }
+
+        // false if the connection was closed
+        bool dispatch(connection & conn) {
+            auto available = conn.in.size() - conn.consumed;
+            if (conn.busy || conn.closed || available < protocol::HEADER_SIZE) {
+                return true;
+            }
+
+            auto length = protocol::read_u32(conn.in.data() + conn.consumed);
+            if (length > protocol::MAX_PAYLOAD) {
+                close(conn);
+                return false;
+            }
+            if (available < protocol::HEADER_SIZE + length) {
+                return true;
+            }
+
+            auto payload = std::make_shared<std::string>(conn.in, conn.consumed + protocol::HEADER_SIZE, length);
+            conn.consumed += protocol::HEADER_SIZE + length;
+            if (conn.consumed == conn.in.size()) {
+                conn.in.clear();
+                conn.consumed = 0;
+            }
+            conn.busy = true;
+
+            pool_.submit([this, id = conn.id, payload] {
+                auto & session = sessions_[concurrency::work_stealing_pool::current_worker()];
+                completion done{id, {}};
+                handle_request(*payload, session, done.response);
+                {
+                    std::lock_guard lock(completions_mutex_);
+                    completions_.push_back(std::move(done));
+                }
+                uint64_t one = 1;
+                (void) !::write(wake_fd_, &one, sizeof(one));
+            });
+            return true;
+        }
+
+        // After EOF nothing more is coming, the connection goes once the last response is sent;
+        // a partial frame left over is dropped
+        void close_if_answered(connection & conn) {
+            if (conn.eof && !conn.busy && conn.out.empty()) {
+                close(conn);
+            }
+        }
+
+        void finish_requests() {
+            {
+                std::lock_guard lock(completions_mutex_);
+                finished_.swap(completions_);
+            }
+
+            for (auto & done : finished_) {
+                auto it = connections_.find(done.id);
+                if (it == connections_.end()) {
+                    continue;
+                }
+                auto & conn = *it->second;
+                conn.busy = false;
+                if (conn.closed) {
+                    close(conn);
+                    continue;
+                }
+                if (conn.out.empty()) {
+                    conn.out = std::move(done.response);
+                } else {
+                    conn.out += done.response;
+                }
+                if (flush(conn) && dispatch(conn)) {
+                    close_if_answered(conn);
+                }
+            }
+            finished_.clear();
+        }
+
+        // false if the connection was closed
+        bool flush(connection & conn) {
+            while (conn.written < conn.out.size()) {
+                auto n = ::send(conn.fd, conn.out.data() + conn.written, conn.out.size() - conn.written, MSG_NOSIGNAL);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        break;
+                    }
+                    close(conn);
+                    return false;
+                }
+                conn.written += n;
+            }
+
+            auto pending = conn.written < conn.out.size();
+            if (!pending) {
+                conn.out.clear();
+                conn.written = 0;
+            }
+            if (pending != conn.writing) {
+                conn.writing = pending;
+                watch(conn.fd, conn.id, interest(conn), EPOLL_CTL_MOD);
+            }
+            return true;
+        }
+
+        void close(connection & conn) {
+            if (conn.busy) {
+                // the worker still refers to the connection id, finish_requests closes it
+                if (!conn.closed) {
+                    conn.closed = true;
+                    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn.fd, nullptr);
+                }
+                return;
+            }
+            if (!conn.closed) {
+                ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn.fd, nullptr);
+            }
+            ::close(conn.fd);
+            connections_.erase(conn.id);
+        }
+
+        std::string path_;
+        int listen_fd_ = -1;
+        int wake_fd_ = -1;
+        int epoll_fd_ = -1;
+        std::atomic<bool> stopping_ = false;
+
+        std::unordered_map<uint64_t, std::unique_ptr<connection>> connections_;
+        uint64_t next_id_ = WAKE_ID + 1;
+
+        std::mutex completions_mutex_;
+        std::vector<completion> completions_;
+        std::vector<completion> finished_;
+
+        std::vector<worker_session> sessions_;
+        concurrency::work_stealing_pool pool_; // last: joined before everything its tasks use
+    };
+
+    struct response {
+        protocol::status status;
+        std::string body;
+    };
+
+    // Blocking client, one request at a time
+    class client {
+    public:
+        explicit client(std::string const & path) {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(address.sun_path)) {
+                throw std::system_error(ENAMETOOLONG, std::generic_category(), path);
+            }
+            std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+            fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd_ < 0 || ::connect(fd_, reinterpret_cast<sockaddr const *>(&address), sizeof(address)) != 0) {
+                auto error = errno;
+                if (fd_ >= 0) {
+                    ::close(fd_);
+                }
+                throw std::system_error(error, std::generic_category(), "connect " + path);
+            }
+        }
+
+        client(client const &) = delete;
+        client & operator=(client const &) = delete;
+
+        ~client() {
+            ::close(fd_);
+        }
+
+        response request(protocol::command command, protocol::format format, std::string_view source) {
+            send(command, format, source);
+            return receive();
+        }
+
+        // Requests may be pipelined: several `send`s, then their responses in the same order
+        void send(protocol::command command, protocol::format format, std::string_view source) {
+            request_.clear();
+            protocol::append_u32(request_, source.size() + 2);
+            request_.push_back(static_cast<char>(command));
+            request_.push_back(static_cast<char>(format));
+            request_.append(source);
+            send_all(request_);
+        }
+
+        response receive() {
+            char header[protocol::HEADER_SIZE];
+            receive_all(header, sizeof(header));
+            auto length = protocol::read_u32(header);
+
+            std::string payload(length, '\0');
+            receive_all(payload.data(), length);
+            if (payload.empty()) {
+                throw std::runtime_error("empty response");
+            }
+            return {static_cast<protocol::status>(payload[0]), payload.substr(1)};
+        }
+
+        // Half-closes the connection; requests sent so far are still answered
+        void finish_sending() {
+            ::shutdown(fd_, SHUT_WR);
+        }
+
+        // Sends raw bytes, e.g. to test malformed requests
+        void send_all(std::string_view data) {
+            while (!data.empty()) {
+                auto n = ::send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw std::system_error(errno, std::generic_category(), "send");
+                }
+                data.remove_prefix(n);
+            }
+        }
+
+    private:
+        void receive_all(char * data, size_t size) {
+            while (size) {
+                auto n = ::recv(fd_, data, size, 0);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    throw std::system_error(n ? errno : ECONNRESET, std::generic_category(), "recv");
+                }
+                data += n;
+                size -= n;
+            }
+        }
+
+        int fd_ = -1;
+        std::string request_;
+    };
+
+}
@@ -0,0 +1,217 @@
+#include "simple_parser.h"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <new>
+#include "analyze.h"
+#include "location.h"
+#include "parser.h"
+#include "stats.h"
+
+static_assert(SP_NODE_IF == static_cast<int>(parser::ast::kind::IF));
+static_assert(SP_NODE_STATEMENTS == static_cast<int>(parser::ast::kind::STATEMENTS));
+static_assert(SP_NODE_UNOP == static_cast<int>(parser::ast::kind::UNOP));
+static_assert(SP_OP_PLUS == static_cast<int>(lexer::PLUS));
+static_assert(SP_OP_UNDEFINED == static_cast<int>(lexer::UNDEFINED));
+static_assert(SP_OP_EQUAL == static_cast<int>(lexer::EQUAL));
+static_assert(SP_OP_NEGATION == static_cast<int>(lexer::NEGATION));
+static_assert(SP_PHASE_COUNT == static_cast<int>(stats::PHASE_COUNT));
+static_assert(SP_NPOS == parser::ast::tree::npos);
+
+struct sp_session {
+    stats::pipeline_stats statistics;
+    uint64_t sources = 0;
+    uint64_t bytes = 0;
+    uint64_t nodes = 0;
+};
+
+struct sp_tree {
+    parser::ast::tree tree;
+    std::string_view source;
+};
+
+namespace {
+
+    // Exceptions must not cross the C boundary
+    template <typename F>
+    sp_status guarded(F && f) {
+        try {
+            return f();
+        } catch (std::bad_alloc const &) {
+            return SP_OUT_OF_MEMORY;
+        } catch (...) {
+            return SP_INTERNAL_ERROR;
+        }
+    }
+
+    void fill_error(sp_error * error, std::string_view source, lexer::error const & err) {
+        if (!error) {
+            return;
+        }
+        auto located = location::line_index(source).locate(err);
+        *error = {
+            .cause = located.cause,
+            .offset = located.pos,
+            .line = located.where.line,
+            .column = located.where.column,
+        };
+    }
+
+    // Parses into `tree`, counts the source in the session statistics
+    sp_status parse_into(sp_session * session, std::string_view source, parser::ast::tree & tree, sp_error * error) {
+        auto result = parser::parse(source, session->statistics);
+        ++session->sources;
+        session->bytes += source.size();
+
+        if (auto err = std::get_if<lexer::error>(&result)) {
+            fill_error(error, source, *err);
+            return SP_SYNTAX_ERROR;
+        }
+
+        tree = std::move(std::get<parser::ast::tree>(result));
+        session->nodes += tree.size();
+        return SP_OK;
+    }
+
+    bool valid_source(char const * source, size_t length) {
+        return (source || !length) && length <= std::numeric_limits<uint32_t>::max();
+    }
+
+    // Writes what fits, reports the full size
+    template <typename Write>
+    sp_status copy_out(size_t size, size_t capacity, size_t * count, Write write) {
+        *count = size;
+        auto fits = std::min(size, capacity);
+        for (size_t idx = 0; idx < fits; ++idx) {
+            write(idx);
+        }
+        return fits == size ? SP_OK : SP_BUFFER_TOO_SMALL;
+    }
+
+}
+
+uint32_t sp_api_version(void) {
+    return SP_API_VERSION;
+}
+
+char const * sp_status_string(sp_status status) {
+    switch (status) {
+        case SP_OK: return "ok";
+        case SP_SYNTAX_ERROR: return "syntax error";
+        case SP_BUFFER_TOO_SMALL: return "buffer too small";
+        case SP_INVALID_ARGUMENT: return "invalid argument";
+        case SP_OUT_OF_MEMORY: return "out of memory";
+        case SP_INTERNAL_ERROR: return "internal error";
+    }
+    return "unknown status";
+}
+
+sp_session * sp_session_create(void) {
+    return new (std::nothrow) sp_session();
+}
+
+void sp_session_destroy(sp_session * session) {
+    delete session;
+}
+
+void sp_session_stats(sp_session const * session, sp_stats * stats) {
+    if (!session || !stats) {
+        return;
+    }
+    for (size_t idx = 0; idx < SP_PHASE_COUNT; ++idx) {
+        stats->phase_ns[idx] = session->statistics.phases[idx].time.count();
+    }
+    stats->sources = session->sources;
+    stats->bytes = session->bytes;
+    stats->nodes = session->nodes;
+}
+
+sp_status sp_parse(sp_session * session, char const * source, size_t length, sp_tree ** tree, sp_error * error) {
+    if (!session || !tree || !valid_source(source, length)) {
+        return SP_INVALID_ARGUMENT;
+    }
+    *tree = nullptr;
+
+    return guarded([&] {
+        auto result = std::make_unique<sp_tree>();
+        result->source = {source, length};
+
+        auto status = parse_into(session, result->source, result->tree, error);
+        if (status == SP_OK) {
+            *tree = result.release();
+        }
+        return status;
+    });
+}
+
+void sp_tree_destroy(sp_tree * tree) {
+    delete tree;
+}
+
+uint32_t sp_tree_size(sp_tree const * tree) {
+    return tree ? tree->tree.size() : 0;
+}
+
+uint16_t sp_tree_root(sp_tree const * tree) {
+    return !tree || tree->tree.empty() ? SP_NPOS : tree->tree.get_root();
+}
+
+sp_status sp_tree_nodes(sp_tree const * tree, sp_node * nodes, size_t capacity, size_t * count) {
+    if (!tree || !count || (!nodes && capacity)) {
+        return SP_INVALID_ARGUMENT;
+    }
+
+    auto const & t = tree->tree;
+    return copy_out(t.size(), capacity, count, [&](size_t idx) {
+        auto [begin, end] = t.get_range(idx);
+        nodes[idx] = {
+            .begin = begin,
+            .end = end,
+            .left = t.get_left(idx),
+            .right = t.get_right(idx),
+            .parent = t.get_parent(idx),
+            .kind = static_cast<uint8_t>(t.get_kind(idx)),
+            .op = static_cast<uint8_t>(t.get_operator_type(idx)),
+        };
+    });
+}
+
+sp_status sp_find_unused_assignments(
+    sp_session * session, sp_tree const * tree, uint16_t * assignments, size_t capacity, size_t * count
+) {
+    if (!session || !tree || !count || (!assignments && capacity)) {
+        return SP_INVALID_ARGUMENT;
+    }
+
+    return guarded([&] {
+        auto unused = find_unused_assignments(tree->tree, tree->source, session->statistics);
+        return copy_out(unused.size(), capacity, count, [&](size_t idx) {
+            assignments[idx] = unused[idx];
+        });
+    });
+}
+
+sp_status sp_analyze(
+    sp_session * session, char const * source, size_t length, uint32_t * ranges, size_t capacity, size_t * count,
+    sp_error * error
+) {
+    if (!session || !count || !valid_source(source, length) || (!ranges && capacity)) {
+        return SP_INVALID_ARGUMENT;
+    }
+
+    return guarded([&] {
+        std::string_view sv(source, length);
+        parser::ast::tree tree;
+        if (auto status = parse_into(session, sv, tree, error); status != SP_OK) {
+            return status;
+        }
+
+        auto unused = find_unused_assignments(tree, sv, session->statistics);
+        return copy_out(unused.size(), capacity, count, [&](size_t idx) {
+            auto [begin, end] = tree.get_range(unused[idx]);
+            ranges[2 * idx] = begin;
+            ranges[2 * idx + 1] = end;
+        });
+    });
+}
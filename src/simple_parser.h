@@ -0,0 +1,133 @@
+#ifndef SIMPLE_PARSER_H
+#define SIMPLE_PARSER_H
+
+/*
+ * C interface of libsimpleparser.
+ *
+ * Sources are passed as (pointer, length) and are never copied: a tree refers to the caller's buffer,
+ * which has to outlive it. Results are written into arrays owned by the caller; when an array is too
+ * small the call writes as much as fits, stores the required size into `*count` and returns
+ * SP_BUFFER_TOO_SMALL. A session must not be used by two threads at once, trees are immutable and
+ * may be shared between threads.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define SP_API __attribute__((visibility("default")))
+#else
+#define SP_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SP_API_VERSION 2
+#define SP_NPOS 0xFFFFu
+
+typedef struct sp_session sp_session;
+typedef struct sp_tree sp_tree;
+
+typedef enum sp_status {
+    SP_OK = 0,
+    SP_SYNTAX_ERROR = 1,
+    SP_BUFFER_TOO_SMALL = 2,
+    SP_INVALID_ARGUMENT = 3,
+    SP_OUT_OF_MEMORY = 4,
+    SP_INTERNAL_ERROR = 5
+} sp_status;
+
+typedef enum sp_node_kind {
+    SP_NODE_IF = 0,
+    SP_NODE_WHILE = 1,
+    SP_NODE_ASSIGNMENT = 2,
+    SP_NODE_VAR = 3,
+    SP_NODE_CONST = 4,
+    SP_NODE_BINOP = 5,
+    SP_NODE_STATEMENTS = 6,
+    SP_NODE_UNOP = 7        /* operand in `left` */
+} sp_node_kind;
+
+typedef enum sp_operator {
+    SP_OP_PLUS = 0,
+    SP_OP_MINUS = 1,
+    SP_OP_MULTIPLICATION = 2,
+    SP_OP_DIVISION = 3,
+    SP_OP_LESS = 4,
+    SP_OP_GREATER = 5,
+    SP_OP_UNDEFINED = 6,
+    SP_OP_EQUAL = 7,
+    SP_OP_NOT_EQUAL = 8,
+    SP_OP_LESS_EQUAL = 9,
+    SP_OP_GREATER_EQUAL = 10,
+    SP_OP_AND = 11,
+    SP_OP_OR = 12,
+    SP_OP_NEGATION = 13     /* SP_NODE_UNOP */
+} sp_operator;
+
+typedef enum sp_phase {
+    SP_PHASE_LEX = 0,
+    SP_PHASE_PARSE = 1,
+    SP_PHASE_FREE_VARIABLES = 2,
+    SP_PHASE_UNUSED_DETECTION = 3,
+    SP_PHASE_COUNT = 4
+} sp_phase;
+
+/* Node `i` of a tree; children and parent are node indices or SP_NPOS */
+typedef struct sp_node {
+    uint32_t begin; /* byte range in the source */
+    uint32_t end;
+    uint16_t left;
+    uint16_t right;
+    uint16_t parent;
+    uint8_t kind;   /* sp_node_kind */
+    uint8_t op;     /* sp_operator, SP_OP_UNDEFINED for everything but SP_NODE_BINOP and SP_NODE_UNOP */
+} sp_node;
+
+typedef struct sp_error {
+    const char *cause; /* static string, e.g. "UNFINISHED_STATEMENT" */
+    uint32_t offset;
+    uint32_t line;     /* 1-based */
+    uint32_t column;   /* 1-based, in bytes */
+} sp_error;
+
+/* Totals over every call made with a session */
+typedef struct sp_stats {
+    uint64_t phase_ns[SP_PHASE_COUNT];
+    uint64_t sources;
+    uint64_t bytes;
+    uint64_t nodes;
+} sp_stats;
+
+SP_API uint32_t sp_api_version(void);
+SP_API const char *sp_status_string(sp_status status);
+
+SP_API sp_session *sp_session_create(void);
+SP_API void sp_session_destroy(sp_session *session);
+SP_API void sp_session_stats(const sp_session *session, sp_stats *stats);
+
+/* On SP_SYNTAX_ERROR `*error` (if not NULL) describes the first error and `*tree` is NULL */
+SP_API sp_status sp_parse(sp_session *session, const char *source, size_t length, sp_tree **tree, sp_error *error);
+SP_API void sp_tree_destroy(sp_tree *tree);
+
+SP_API uint32_t sp_tree_size(const sp_tree *tree);
+SP_API uint16_t sp_tree_root(const sp_tree *tree); /* SP_NPOS for an empty tree */
+SP_API sp_status sp_tree_nodes(const sp_tree *tree, sp_node *nodes, size_t capacity, size_t *count);
+
+/* Indices of ASSIGNMENT nodes whose value is never read */
+SP_API sp_status sp_find_unused_assignments(
+    sp_session *session, const sp_tree *tree, uint16_t *assignments, size_t capacity, size_t *count);
+
+/* Parse and analyze without creating a tree handle; byte ranges of unused assignments go to `ranges`
+ * as (begin, end) pairs, so `capacity` and `*count` are in pairs */
+SP_API sp_status sp_analyze(
+    sp_session *session, const char *source, size_t length, uint32_t *ranges, size_t capacity, size_t *count,
+    sp_error *error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+namespace stats {
+
+    enum phase {
+        LEX,
+        PARSE,
+        FREE_VARIABLES,
+        UNUSED_DETECTION,
+        PHASE_COUNT
+    };
+
+    namespace detail {
+        inline thread_local uint64_t allocations = 0;
+    }
+
+    // Allocations made on this thread through a `counting_resource`
+    inline uint64_t allocation_count() {
+        return detail::allocations;
+    }
+
+    // Forwards to `upstream` and counts the allocations of the calling thread. The count is kept per
+    // thread rather than in the resource, so memory may be freed from any thread.
+    class counting_resource : public std::pmr::memory_resource {
+    public:
+        explicit counting_resource(std::pmr::memory_resource * upstream = std::pmr::new_delete_resource())
+            : upstream_(upstream) {}
+
+    private:
+        void * do_allocate(std::size_t bytes, std::size_t alignment) override {
+            ++detail::allocations;
+            return upstream_->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void * ptr, std::size_t bytes, std::size_t alignment) override {
+            upstream_->deallocate(ptr, bytes, alignment);
+        }
+
+        [[nodiscard]]
+        bool do_is_equal(std::pmr::memory_resource const & other) const noexcept override {
+            return this == &other;
+        }
+
+        std::pmr::memory_resource * upstream_;
+    };
+
+    // The heap as the pipeline sees it while statistics are recorded: tokens, nodes and analysis state
+    // come from here, and trees built from it may live as long as they like
+    inline counting_resource * counting_heap() {
+        static counting_resource heap;
+        return &heap;
+    }
+
+    struct phase_stats {
+        std::chrono::nanoseconds time{0};
+        uint64_t allocations = 0;
+    };
+
+    struct pipeline_stats {
+        std::array<phase_stats, PHASE_COUNT> phases{};
+
+        uint64_t tokens = 0;
+        uint64_t nodes = 0;
+        uint64_t token_bytes = 0; // peak capacity of the token vector
+        uint64_t node_bytes = 0;  // peak capacity of the node vector
+
+        // pluggable source of a monotonic per-thread allocation count
+        uint64_t (*allocation_counter)() = allocation_count;
+    };
+
+    // Recorder which is passed when statistics are not requested, every call compiles to nothing
+    struct disabled {
+        struct scope {};
+
+        constexpr scope measure(phase) {
+            return {};
+        }
+
+        template <typename F>
+        constexpr void update(F &&) {}
+    };
+
+    class recorder {
+    public:
+        explicit recorder(pipeline_stats & stats) : stats_(stats) {}
+
+        class scope {
+        public:
+            scope(pipeline_stats & stats, phase p)
+                : stats_(stats)
+                , phase_(p)
+                , allocations_(stats.allocation_counter())
+                , start_(std::chrono::steady_clock::now()) {}
+
+            scope(scope const &) = delete;
+            scope & operator=(scope const &) = delete;
+
+            ~scope() {
+                auto & result = stats_.phases[phase_];
+                result.time += std::chrono::steady_clock::now() - start_;
+                result.allocations += stats_.allocation_counter() - allocations_;
+            }
+
+        private:
+            pipeline_stats & stats_;
+            phase phase_;
+            uint64_t allocations_;
+            std::chrono::steady_clock::time_point start_;
+        };
+
+        scope measure(phase p) {
+            return {stats_, p};
+        }
+
+        template <typename F>
+        void update(F && f) {
+            f(stats_);
+        }
+
+    private:
+        pipeline_stats & stats_;
+    };
+
+}
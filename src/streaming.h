@@ -0,0 +1,335 @@
+#pragma once
+
+#include <algorithm>
+#include <istream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "analyze.h"
+#include "lexer.h"
+#include "parser.h"
+#include "visitor.h"
+
+namespace streaming {
+
+    // Memory high-water marks of a streaming analysis
+    struct footprint {
+        uint64_t statements = 0;   // top level statements analyzed
+        uint64_t max_buffered = 0; // bytes of input held waiting for the end of a statement
+        uint64_t max_nodes = 0;    // nodes of the largest statement tree
+        uint64_t variables = 0;
+    };
+
+    namespace detail {
+
+        constexpr uint32_t NONE = -1;
+
+        // An expression may go on with a binary operator right after the end of a statement, so a
+        // statement is known to be over only once the longest operator fits in the input after it
+        constexpr uint32_t lookahead() {
+            size_t longest = 0;
+            for (auto const & info : lexer::binary_operators) {
+                longest = std::max(longest, info.symbol.size());
+            }
+            return longest;
+        }
+
+        // Last assignment of a variable not read yet; `node` refers to the tree of statement `statement`
+        struct pending_assignment {
+            uint32_t start = NONE;
+            uint32_t end = 0;
+            uint64_t statement = 0;
+            uint16_t node = parser::ast::tree::npos;
+        };
+
+        struct name_hash {
+            using is_transparent = void;
+
+            size_t operator()(std::string_view name) const {
+                return std::hash<std::string_view>()(name);
+            }
+        };
+
+        // Same rules as `::detail::unused_finder` over the tree of one top level statement,
+        // with the pending assignments kept across statements by source range
+        template <typename Report>
+        class statement_finder : parser::ast::visitor<statement_finder<Report>> {
+            using base = parser::ast::visitor<statement_finder<Report>>;
+            using base::tree_;
+            using base::visit;
+
+        public:
+            statement_finder(
+                parser::ast::tree const & tree,
+                ::detail::scopes const & scopes,
+                std::vector<uint32_t> const & globals,
+                std::vector<pending_assignment> & pending,
+                std::vector<std::vector<uint16_t>> & reentering,
+                uint32_t offset,
+                uint64_t statement,
+                Report & report
+            )
+                : base(tree)
+                , scopes_(scopes)
+                , globals_(globals)
+                , pending_(pending)
+                , reentering_(reentering)
+                , offset_(offset)
+                , statement_(statement)
+                , report_(report) {
+                reentering_.resize(std::max<size_t>(reentering_.size(), scopes.max_depth + 1));
+            }
+
+            void run() && {
+                visit();
+            }
+
+        private:
+            friend base;
+
+            pending_assignment & pending(uint16_t var_node) {
+                return pending_[globals_[scopes_.variables[var_node]]];
+            }
+
+            void visit_if(uint16_t node) {
+                read_expression(tree_.get_left(node));
+                visit(tree_.get_right(node));
+            }
+
+            void visit_while(uint16_t node) {
+                read_expression(tree_.get_left(node));
+                visit(tree_.get_right(node));
+
+                auto & reentering = reentering_[scopes_.loop_depths[node]];
+                for (auto assignment : reentering) {
+                    auto & p = pending(tree_.get_left(assignment));
+                    if (p.statement == statement_ && p.node == assignment) {
+                        p.start = NONE;
+                    }
+                }
+                reentering.clear();
+            }
+
+            void visit_assignment(uint16_t node) {
+                read_expression(tree_.get_right(node));
+
+                auto & p = pending(tree_.get_left(node));
+                if (p.start != NONE) {
+                    report_(std::pair<uint32_t, uint32_t>(p.start, p.end));
+                }
+                auto [start, end] = tree_.get_range(node);
+                p = {.start = offset_ + start, .end = offset_ + end, .statement = statement_, .node = node};
+
+                if (auto loop = scopes_.reentries[node]; loop != parser::ast::tree::npos) {
+                    reentering_[scopes_.loop_depths[loop]].push_back(node);
+                }
+            }
+
+            void read_expression(uint16_t expression) {
+                ::detail::for_each_variable(tree_, expression, [this](uint16_t var_node) {
+                    pending(var_node).start = NONE;
+                });
+            }
+
+            ::detail::scopes const & scopes_;
+            std::vector<uint32_t> const & globals_;
+            std::vector<pending_assignment> & pending_;
+            std::vector<std::vector<uint16_t>> & reentering_;
+            uint32_t offset_;
+            uint64_t statement_;
+            Report & report_;
+        };
+
+        // Pending assignments of a program analyzed one top level statement at a time,
+        // variables of different statement trees are matched by name
+        template <typename Report>
+        class dataflow {
+        public:
+            explicit dataflow(Report report) : report_(std::move(report)) {}
+
+            // `tree` holds one top level statement, its ranges plus `offset` are positions in the whole input
+            void analyze(parser::ast::tree const & tree, std::string_view sv, uint32_t offset) {
+                auto scopes = ::detail::calculate_free_variables_for_scopes(tree, sv);
+
+                globals_.assign(scopes.variable_count, NONE);
+                for (uint16_t node = 0; node < tree.size(); ++node) {
+                    if (tree.get_kind(node) == parser::ast::kind::VAR && globals_[scopes.variables[node]] == NONE) {
+                        globals_[scopes.variables[node]] = intern(tree.get_symbol(node, sv));
+                    }
+                }
+
+                statement_finder(tree, scopes, globals_, pending_, reentering_, offset, statements_++, report_).run();
+            }
+
+            // reports the assignments still pending, as at the end of the program
+            void finish() {
+                for (auto & p : pending_) {
+                    if (p.start != NONE) {
+                        report_(std::pair<uint32_t, uint32_t>(p.start, p.end));
+                        p.start = NONE;
+                    }
+                }
+            }
+
+            // last assignment of `name` not read yet, nullptr if there is none
+            [[nodiscard]]
+            pending_assignment const * pending(std::string_view name) const {
+                auto found = ids_.find(name);
+                return found == ids_.end() || pending_[found->second].start == NONE ? nullptr : &pending_[found->second];
+            }
+
+            [[nodiscard]]
+            uint64_t statements() const {
+                return statements_;
+            }
+
+            [[nodiscard]]
+            uint64_t variables() const {
+                return ids_.size();
+            }
+
+        private:
+            uint32_t intern(std::string_view name) {
+                auto found = ids_.find(name);
+                if (found != ids_.end()) {
+                    return found->second;
+                }
+                ids_.emplace(std::string(name), pending_.size());
+                pending_.emplace_back();
+                return pending_.size() - 1;
+            }
+
+            Report report_;
+            std::unordered_map<std::string, uint32_t, name_hash, std::equal_to<>> ids_;
+            std::vector<pending_assignment> pending_;    // by variable id
+            std::vector<uint32_t> globals_;              // variable id of every statement-local id
+            std::vector<std::vector<uint16_t>> reentering_;
+            uint64_t statements_ = 0;
+        };
+
+    }
+
+    // Finds unused assignments while the program is still arriving, one top level statement at a time.
+    // Each statement is lexed, parsed and analyzed as soon as its end is seen, then its tokens and tree
+    // are dropped; only the input of the unfinished statement and one pending assignment per variable
+    // are kept. `report(std::pair<uint32_t, uint32_t>)` receives the source range of every unused
+    // assignment once a later assignment proves it dead, and of those still pending at `finish`.
+    // Reported assignments and errors are the same as with `parse` and `find_unused_assignments`.
+    template <typename Report>
+    class analyzer {
+    public:
+        explicit analyzer(Report report) : dataflow_(std::move(report)) {}
+
+        // Analyzes the statements completed by `data`; the first error stops the analysis
+        std::optional<lexer::error> feed(std::string_view data) {
+            if (!error_) {
+                consume(data, false);
+            }
+            return error_;
+        }
+
+        // End of input: analyzes the last statement and reports the assignments left pending
+        std::optional<lexer::error> finish() {
+            if (!error_) {
+                consume({}, true);
+            }
+            if (!error_) {
+                dataflow_.finish();
+            }
+            return error_;
+        }
+
+        [[nodiscard]]
+        footprint const & memory() const {
+            return footprint_;
+        }
+
+    private:
+        void consume(std::string_view data, bool eof) {
+            // the unfinished statement is copied, whole statements are read from `data` in place
+            std::string_view input = data;
+            bool buffered = !buffer_.empty();
+            if (buffered) {
+                buffer_.append(data);
+                input = buffer_;
+            }
+
+            uint32_t pos = 0;
+            while (true) {
+                while (pos < input.size() && lexer::chars::is_whitespace(input[pos])) {
+                    ++pos;
+                }
+                if (pos == input.size() && (!eof || footprint_.statements)) {
+                    break;
+                }
+
+                tokens_.clear();
+                auto result = lexer::statement::parse(tokens_, pos, input);
+                if (!eof && (!lexer::is_success(result) || input.size() - std::get<uint32_t>(result) < detail::lookahead())) {
+                    break; // the statement may go on in the data to come
+                }
+                if (auto error = std::get_if<lexer::error>(&result)) {
+                    error_ = lexer::error{.cause = error->cause, .pos = offset_ + error->pos};
+                    return;
+                }
+                if (auto error = parser::detail::check_node_count(tokens_)) {
+                    error_ = lexer::error{.cause = error->cause, .pos = offset_ + error->pos};
+                    return;
+                }
+
+                analyze(input);
+                pos = std::get<uint32_t>(result);
+            }
+
+            offset_ += pos;
+            if (buffered) {
+                buffer_.erase(0, pos);
+            } else {
+                buffer_.assign(input.substr(pos));
+            }
+            footprint_.max_buffered = std::max<uint64_t>(footprint_.max_buffered, buffer_.size());
+        }
+
+        void analyze(std::string_view input) {
+            lexer::token_storage storage(tokens_);
+            auto tree = parser::detail::parse_from_token_list(storage, input, nullptr);
+            dataflow_.analyze(tree, input, offset_);
+
+            footprint_.statements = dataflow_.statements();
+            footprint_.max_nodes = std::max<uint64_t>(footprint_.max_nodes, tree.size());
+            footprint_.variables = dataflow_.variables();
+        }
+
+        detail::dataflow<Report> dataflow_;
+        std::string buffer_;
+        uint32_t offset_ = 0; // position of the unfinished statement in the whole input
+        lexer::token_list tokens_;
+
+        std::optional<lexer::error> error_;
+        footprint footprint_;
+    };
+
+    // Streams `in` through an analyzer in fixed-size reads
+    template <typename Report>
+    std::optional<lexer::error> analyze(std::istream & in, Report report, footprint * memory = nullptr) {
+        constexpr size_t READ_SIZE = 1 << 16;
+
+        analyzer<Report> a(std::move(report));
+        std::string chunk(READ_SIZE, '\0');
+        std::optional<lexer::error> error;
+        while (!error && in) {
+            in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+            error = a.feed(std::string_view(chunk.data(), static_cast<size_t>(in.gcount())));
+        }
+        if (!error) {
+            error = a.finish();
+        }
+        if (memory) {
+            *memory = a.memory();
+        }
+        return error;
+    }
+
+}
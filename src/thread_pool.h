@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace concurrency {
+
+    // Every worker owns a deque: it pushes and pops its own tasks at the back and steals
+    // from the front of the others' when it runs dry. Tasks submitted from outside are spread round-robin.
+    class work_stealing_pool {
+    public:
+        explicit work_stealing_pool(unsigned threads = std::thread::hardware_concurrency()) {
+            threads = std::max(threads, 1u);
+            for (unsigned idx = 0; idx < threads; ++idx) {
+                queues_.push_back(std::make_unique<queue>());
+            }
+            for (unsigned idx = 0; idx < threads; ++idx) {
+                threads_.emplace_back([this, idx] { run(idx); });
+            }
+        }
+
+        work_stealing_pool(work_stealing_pool const &) = delete;
+        work_stealing_pool & operator=(work_stealing_pool const &) = delete;
+
+        // Finishes every submitted task first
+        ~work_stealing_pool() {
+            wait();
+            {
+                std::lock_guard lock(mutex_);
+                stop_ = true;
+            }
+            wake_.notify_all();
+            for (auto & thread : threads_) {
+                thread.join();
+            }
+        }
+
+        void submit(std::function<void()> task) {
+            auto target = current_worker_ >= 0 && owner_ == this
+                ? static_cast<size_t>(current_worker_)
+                : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+
+            unfinished_.fetch_add(1, std::memory_order_relaxed);
+            {
+                std::lock_guard lock(queues_[target]->mutex);
+                queues_[target]->tasks.push_back(std::move(task));
+            }
+            {
+                std::lock_guard lock(mutex_);
+                ++queued_;
+            }
+            wake_.notify_one();
+        }
+
+        // Blocks until every submitted task has finished, must not be called from a task
+        void wait() {
+            std::unique_lock lock(mutex_);
+            idle_.wait(lock, [this] { return unfinished_.load() == 0; });
+        }
+
+        [[nodiscard]]
+        unsigned size() const {
+            return threads_.size();
+        }
+
+        // Index of the calling worker of any pool, -1 outside of workers
+        static int current_worker() {
+            return current_worker_;
+        }
+
+    private:
+        struct queue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        void run(unsigned self) {
+            current_worker_ = self;
+            owner_ = this;
+
+            std::function<void()> task;
+            while (true) {
+                if (!take(self, task)) {
+                    std::unique_lock lock(mutex_);
+                    wake_.wait(lock, [this] { return queued_ > 0 || stop_; });
+                    if (queued_ == 0 && stop_) {
+                        return;
+                    }
+                    continue;
+                }
+
+                task();
+                task = nullptr;
+
+                if (unfinished_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard lock(mutex_);
+                    idle_.notify_all();
+                }
+            }
+        }
+
+        bool take(unsigned self, std::function<void()> & task) {
+            auto count = queues_.size();
+            for (size_t step = 0; step < count; ++step) {
+                auto & q = *queues_[(self + step) % count];
+                std::lock_guard lock(q.mutex);
+                if (q.tasks.empty()) {
+                    continue;
+                }
+                if (step == 0) {
+                    task = std::move(q.tasks.back());
+                    q.tasks.pop_back();
+                } else {
+                    task = std::move(q.tasks.front());
+                    q.tasks.pop_front();
+                }
+                std::lock_guard counter(mutex_);
+                --queued_;
+                return true;
+            }
+            return false;
+        }
+
+        std::vector<std::unique_ptr<queue>> queues_;
+        std::vector<std::thread> threads_;
+        std::atomic<size_t> next_queue_ = 0;
+        std::atomic<size_t> unfinished_ = 0;
+
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable idle_;
+        size_t queued_ = 0;
+        bool stop_ = false;
+
+        static inline thread_local int current_worker_ = -1;
+        static inline thread_local work_stealing_pool * owner_ = nullptr;
+    };
+
+    // Calls `f(idx)` for every idx in [0, count) on the pool and waits for all of them
+    template <typename F>
+    void parallel_for(work_stealing_pool & pool, size_t count, F const & f) {
+        for (size_t idx = 0; idx < count; ++idx) {
+            pool.submit([&f, idx] { f(idx); });
+        }
+        pool.wait();
+    }
+
+}
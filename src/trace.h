@@ -0,0 +1,283 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#ifdef SIMPLE_PARSER_TRACE
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#endif
+
+// Chrome trace events of the pipeline phases. With SIMPLE_PARSER_TRACE defined (for the whole program,
+// it changes inline functions) every `span` records a complete event into a ring buffer owned by its
+// thread, and `write_chrome_json` drains the rings as JSON for Perfetto or chrome://tracing.
+// Without it `span` and `file_scope` are empty and every call compiles to nothing.
+namespace trace {
+
+#ifdef SIMPLE_PARSER_TRACE
+    inline constexpr bool enabled = true;
+#else
+    inline constexpr bool enabled = false;
+#endif
+
+    inline constexpr uint32_t NO_FILE = -1;
+
+#ifdef SIMPLE_PARSER_TRACE
+    namespace detail {
+
+        struct event {
+            char const * name;
+            uint32_t file;
+            uint64_t begin; // nanoseconds since `origin`
+            uint64_t end;
+        };
+
+        // events a thread keeps until the next flush, later ones are dropped and counted
+        inline constexpr uint64_t RING_SIZE = 1 << 14;
+
+        inline uint64_t now() {
+            static auto const origin = std::chrono::steady_clock::now();
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+        }
+
+        // Written by the thread leasing it and read by the flush, so the positions are the only synchronisation
+        class ring {
+        public:
+            explicit ring(uint32_t thread) : thread_(thread), events_(RING_SIZE) {}
+
+            void push(event e) {
+                auto head = head_.load(std::memory_order_relaxed);
+                if (head - tail_.load(std::memory_order_acquire) == RING_SIZE) {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                events_[head % RING_SIZE] = e;
+                head_.store(head + 1, std::memory_order_release);
+            }
+
+            // hands the recorded events to `f` and frees their slots
+            template <typename F>
+            void drain(F && f) {
+                auto tail = tail_.load(std::memory_order_relaxed);
+                auto head = head_.load(std::memory_order_acquire);
+                for (; tail != head; ++tail) {
+                    f(events_[tail % RING_SIZE]);
+                }
+                tail_.store(tail, std::memory_order_release);
+            }
+
+            [[nodiscard]]
+            uint32_t thread() const {
+                return thread_;
+            }
+
+            [[nodiscard]]
+            uint64_t dropped() const {
+                return dropped_.load(std::memory_order_relaxed);
+            }
+
+            bool leased = false; // a live thread records into it, guarded by the registry mutex
+
+        private:
+            uint32_t thread_;
+            std::atomic<uint64_t> head_{0};
+            std::atomic<uint64_t> tail_{0};
+            std::atomic<uint64_t> dropped_{0};
+            std::vector<event> events_;
+        };
+
+        // Rings of the threads that recorded something. A ring outlives its thread, so that workers of a
+        // pool that is gone can still be flushed, and is then leased to the next new thread: there are
+        // as many rings as threads ever recorded at the same time, threads that did not overlap share a
+        // track. The mutex guards leases and flushes only.
+        struct registry {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<ring>> rings;
+        };
+
+        inline registry & rings() {
+            static registry r;
+            return r;
+        }
+
+        // The ring of the calling thread, given back when the thread exits
+        class lease {
+        public:
+            lease() {
+                auto & r = rings();
+                std::lock_guard lock(r.mutex);
+                for (auto const & free : r.rings) {
+                    if (!free->leased) {
+                        ring_ = free.get();
+                        break;
+                    }
+                }
+                if (!ring_) {
+                    ring_ = r.rings.emplace_back(std::make_unique<ring>(r.rings.size() + 1)).get();
+                }
+                ring_->leased = true;
+            }
+
+            lease(lease const &) = delete;
+            lease & operator=(lease const &) = delete;
+
+            ~lease() {
+                auto & r = rings();
+                std::lock_guard lock(r.mutex);
+                ring_->leased = false;
+            }
+
+            ring & get() {
+                return *ring_;
+            }
+
+        private:
+            ring * ring_ = nullptr;
+        };
+
+        inline ring & local() {
+            thread_local lease mine;
+            return mine.get();
+        }
+
+        inline thread_local uint32_t current_file = NO_FILE;
+
+        // microseconds with the nanoseconds as decimals, the unit of trace events
+        inline void append_micros(std::string & out, uint64_t nanos) {
+            char buf[24];
+            auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), nanos / 1000);
+            out.append(buf, end);
+            out.push_back('.');
+            auto fraction = nanos % 1000;
+            out.push_back(static_cast<char>('0' + fraction / 100));
+            out.push_back(static_cast<char>('0' + fraction / 10 % 10));
+            out.push_back(static_cast<char>('0' + fraction % 10));
+        }
+
+        inline void append_number(std::string & out, uint64_t value) {
+            char buf[24];
+            auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+            out.append(buf, end);
+        }
+
+    }
+#endif
+
+    // Records the time from its construction to its destruction under `name`, which has to be a
+    // string literal. Nothing is recorded during constant evaluation.
+    class span {
+    public:
+        constexpr explicit span([[maybe_unused]] char const * name) {
+        #ifdef SIMPLE_PARSER_TRACE
+            if (!std::is_constant_evaluated()) {
+                name_ = name;
+                begin_ = detail::now();
+            }
+        #endif
+        }
+
+        span(span const &) = delete;
+        span & operator=(span const &) = delete;
+
+        constexpr ~span() {
+        #ifdef SIMPLE_PARSER_TRACE
+            if (!std::is_constant_evaluated()) {
+                detail::local().push({name_, detail::current_file, begin_, detail::now()});
+            }
+        #endif
+        }
+
+    private:
+    #ifdef SIMPLE_PARSER_TRACE
+        char const * name_ = nullptr;
+        uint64_t begin_ = 0;
+    #endif
+    };
+
+    // Spans of the calling thread carry `file` until the scope ends
+    class file_scope {
+    public:
+        explicit file_scope([[maybe_unused]] uint32_t file) {
+        #ifdef SIMPLE_PARSER_TRACE
+            outer_ = std::exchange(detail::current_file, file);
+        #endif
+        }
+
+        file_scope(file_scope const &) = delete;
+        file_scope & operator=(file_scope const &) = delete;
+
+        ~file_scope() {
+        #ifdef SIMPLE_PARSER_TRACE
+            detail::current_file = outer_;
+        #endif
+        }
+
+    private:
+    #ifdef SIMPLE_PARSER_TRACE
+        uint32_t outer_;
+    #endif
+    };
+
+#ifdef SIMPLE_PARSER_TRACE
+    // Events lost to full rings since the start
+    inline uint64_t dropped() {
+        auto & r = detail::rings();
+        std::lock_guard lock(r.mutex);
+        uint64_t result = 0;
+        for (auto const & ring : r.rings) {
+            result += ring->dropped();
+        }
+        return result;
+    }
+
+    // Drains the events recorded so far as a trace-event JSON object, one track per ring.
+    // Threads keep recording meanwhile; their newer events are left for the next flush.
+    inline void write_chrome_json(std::ostream & out) {
+        auto & r = detail::rings();
+        std::lock_guard lock(r.mutex);
+
+        std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        auto separate = [&] {
+            if (!first) {
+                json.append(",\n");
+            }
+            first = false;
+        };
+        for (auto const & ring : r.rings) {
+            separate();
+            json.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":");
+            detail::append_number(json, ring->thread());
+            json.append(",\"args\":{\"name\":\"thread ");
+            detail::append_number(json, ring->thread());
+            json.append("\"}}");
+
+            ring->drain([&](detail::event const & e) {
+                separate();
+                json.append("{\"name\":\"").append(e.name).append("\",\"cat\":\"pipeline\",\"ph\":\"X\",\"ts\":");
+                detail::append_micros(json, e.begin);
+                json.append(",\"dur\":");
+                detail::append_micros(json, e.end - e.begin);
+                json.append(",\"pid\":1,\"tid\":");
+                detail::append_number(json, ring->thread());
+                if (e.file != NO_FILE) {
+                    json.append(",\"args\":{\"file\":");
+                    detail::append_number(json, e.file);
+                    json.push_back('}');
+                }
+                json.push_back('}');
+            });
+        }
+        json.append("]}\n");
+        out.write(json.data(), static_cast<std::streamsize>(json.size()));
+    }
+#endif
+
+}
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "analyze.h"
+#include "parser.h"
+
+namespace transform {
+
+    struct dead_store_elimination_result {
+        std::string source;
+        uint32_t rounds = 0;  // rewriting passes which changed the program
+        uint32_t removed = 0; // removed assignments (including those inside removed `if`s)
+    };
+
+    namespace detail {
+
+        bool constexpr is_blank(char c) {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        bool constexpr is_word(char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+        }
+
+        inline uint16_t first_statement(parser::ast::tree const & tree, uint16_t node) {
+            while (tree.get_kind(node) == parser::ast::kind::STATEMENTS) {
+                node = tree.get_left(node);
+            }
+            return node;
+        }
+
+        inline void keep_first_statement(parser::ast::tree const & tree, uint16_t node, std::vector<char> & removed) {
+            while (true) {
+                node = first_statement(tree, node);
+                removed[node] = false;
+                if (tree.get_kind(node) != parser::ast::kind::IF && tree.get_kind(node) != parser::ast::kind::WHILE) {
+                    return;
+                }
+                node = tree.get_right(node);
+            }
+        }
+
+        // Marks statements to remove, returns true if something in the statement list is kept.
+        // An `if` whose body would become empty is removed as a whole,
+        // a `while` keeps its first statement since the loop itself may not terminate.
+        inline bool plan_removal(parser::ast::tree const & tree, uint16_t node, std::vector<char> & removed) {
+            bool kept = false;
+
+            while (true) {
+                auto statement = tree.get_kind(node) == parser::ast::kind::STATEMENTS ? tree.get_left(node) : node;
+
+                switch (tree.get_kind(statement)) {
+                    case parser::ast::kind::ASSIGNMENT:
+                        kept |= !removed[statement];
+                        break;
+                    case parser::ast::kind::IF:
+                        if (plan_removal(tree, tree.get_right(statement), removed)) {
+                            kept = true;
+                        } else {
+                            removed[statement] = true;
+                        }
+                        break;
+                    case parser::ast::kind::WHILE:
+                        if (!plan_removal(tree, tree.get_right(statement), removed)) {
+                            keep_first_statement(tree, tree.get_right(statement), removed);
+                        }
+                        kept = true;
+                        break;
+                    case parser::ast::kind::STATEMENTS:
+                        kept |= plan_removal(tree, statement, removed);
+                        break;
+                    default:
+                        break;
+                }
+
+                if (statement == node) {
+                    return kept;
+                }
+                node = tree.get_right(node);
+            }
+        }
+
+        class splicer {
+        public:
+            splicer(std::string_view sv, std::string & out) : sv_(sv), out_(out) {
+                out_.clear();
+                out_.reserve(sv.size());
+            }
+
+            // Drops the statement together with the rest of its line if nothing else is on it
+            void cut(uint32_t from, uint32_t to) {
+                auto line_from = from;
+                while (line_from > copied_ && is_blank(sv_[line_from - 1])) {
+                    --line_from;
+                }
+                while (to < sv_.size() && is_blank(sv_[to])) {
+                    ++to;
+                }
+
+                bool line_head = line_from == 0 || sv_[line_from - 1] == '\n';
+                bool line_tail = to == sv_.size() || sv_[to] == '\n';
+                if (line_head && line_tail) {
+                    from = line_from;
+                    to += to != sv_.size();
+                }
+
+                out_.append(sv_.data() + copied_, from - copied_);
+                if (!out_.empty() && to < sv_.size() && is_word(out_.back()) && is_word(sv_[to])) {
+                    out_.push_back(' '); // keep adjacent tokens apart
+                }
+                copied_ = to;
+            }
+
+            void finish() {
+                out_.append(sv_.data() + copied_, sv_.size() - copied_);
+            }
+
+        private:
+            std::string_view sv_;
+            std::string & out_;
+            uint32_t copied_ = 0;
+        };
+
+        inline uint32_t count_assignments(parser::ast::tree const & tree, uint16_t node) {
+            repeat: switch (tree.get_kind(node)) {
+                case parser::ast::kind::ASSIGNMENT:
+                    return 1;
+                case parser::ast::kind::IF:
+                case parser::ast::kind::WHILE:
+                    node = tree.get_right(node);
+                    goto repeat;
+                case parser::ast::kind::STATEMENTS:
+                    return count_assignments(tree, tree.get_left(node)) + count_assignments(tree, tree.get_right(node));
+                default:
+                    return 0;
+            }
+        }
+
+        inline uint32_t splice(
+            parser::ast::tree const & tree,
+            uint16_t node,
+            std::vector<char> const & removed,
+            splicer & out
+        ) {
+            uint32_t count = 0;
+
+            while (true) {
+                auto statement = tree.get_kind(node) == parser::ast::kind::STATEMENTS ? tree.get_left(node) : node;
+
+                if (removed[statement]) {
+                    auto [from, to] = tree.get_range(statement);
+                    out.cut(from, to);
+                    count += count_assignments(tree, statement);
+                } else {
+                    switch (tree.get_kind(statement)) {
+                        case parser::ast::kind::IF:
+                        case parser::ast::kind::WHILE:
+                            count += splice(tree, tree.get_right(statement), removed, out);
+                            break;
+                        case parser::ast::kind::STATEMENTS:
+                            count += splice(tree, statement, removed, out);
+                            break;
+                        default:
+                            break;
+                    }
+                }
+
+                if (statement == node) {
+                    return count;
+                }
+                node = tree.get_right(node);
+            }
+        }
+
+        // Single linear pass: copies every kept span of `sv` into `out` in source order
+        inline uint32_t remove_assignments(
+            parser::ast::tree const & tree,
+            std::string_view sv,
+            std::vector<uint32_t> const & unused,
+            std::string & out
+        ) {
+            std::vector<char> removed(tree.size(), false);
+            for (auto idx : unused) {
+                removed[idx] = true;
+            }
+
+            plan_removal(tree, tree.get_root(), removed);
+
+            splicer splicer(sv, out);
+            auto count = splice(tree, tree.get_root(), removed, splicer);
+            splicer.finish();
+            return count;
+        }
+
+    }
+
+    // Removes unused assignments from the source until none are left.
+    // Every round re-parses and re-analyzes the rewritten program, since removing `y = x`
+    // can make an earlier `x = ...` unused. The result is empty if the whole program was removed.
+    inline dead_store_elimination_result eliminate_dead_stores(
+        parser::ast::tree const & tree,
+        std::string_view sv,
+        std::vector<uint32_t> const & unused
+    ) {
+        dead_store_elimination_result result;
+        std::string buffer;
+
+        auto removed = detail::remove_assignments(tree, sv, unused, result.source);
+
+        while (removed) {
+            result.removed += removed;
+            ++result.rounds;
+
+            auto parsed = parser::parse(result.source);
+            if (!std::holds_alternative<parser::ast::tree>(parsed)) {
+                break; // nothing but whitespace is left
+            }
+
+            auto const & next = std::get<parser::ast::tree>(parsed);
+            removed = detail::remove_assignments(next, result.source, find_unused_assignments(next, result.source), buffer);
+            std::swap(buffer, result.source);
+        }
+
+        if (result.source.find_first_not_of(" \t\r\n") == std::string::npos) {
+            result.source.clear();
+        }
+
+        return result;
+    }
+
+}
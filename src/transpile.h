@@ -0,0 +1,344 @@
+#pragma once
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+#include "parser.h"
+#include "semantics.h"
+#include "visitor.h"
+
+#if __has_include(<dlfcn.h>)
+#include <dlfcn.h>
+#include <stdlib.h>
+#endif
+
+// Ahead-of-time translation of programs to C. A program becomes one self-contained translation unit
+// with a single function; variables are locals, if and while are C if and while, and the arithmetic
+// goes through helpers that give the results of `semantics` whatever the C implementation does on
+// overflow. The generated function:
+//
+//     int <name>(int64_t * variables, uint64_t max_tests)
+//
+// reads the initial values of the variables, in the order of `translation::variables`, runs the program
+// and writes the final values back. Like `eval::run` it returns 0 when `max_tests` condition tests were
+// not enough to finish, the variables then hold the values they had at that point.
+namespace transpile {
+
+    using semantics::value;
+
+    struct translation {
+        std::string source;
+        std::vector<std::string> variables; // in order of first appearance
+        std::string function;
+    };
+
+    namespace detail {
+
+        // Unsigned arithmetic wraps around in C; converting back is written so that it is defined
+        // for every value, compilers turn it into nothing.
+        constexpr std::string_view PRELUDE =
+            "#include <stdint.h>\n"
+            "\n"
+            "typedef int64_t value;\n"
+            "\n"
+            "static inline value sp_wrap(uint64_t u) {\n"
+            "    return u <= (uint64_t) INT64_MAX ? (value) u : -(value) ~u - 1;\n"
+            "}\n"
+            "\n"
+            "static inline value sp_add(value l, value r) {\n"
+            "    return sp_wrap((uint64_t) l + (uint64_t) r);\n"
+            "}\n"
+            "\n"
+            "static inline value sp_sub(value l, value r) {\n"
+            "    return sp_wrap((uint64_t) l - (uint64_t) r);\n"
+            "}\n"
+            "\n"
+            "static inline value sp_mul(value l, value r) {\n"
+            "    return sp_wrap((uint64_t) l * (uint64_t) r);\n"
+            "}\n"
+            "\n"
+            "static inline value sp_div(value l, value r) {\n"
+            "    if (r == 0) {\n"
+            "        return 0;\n"
+            "    }\n"
+            "    if (l == INT64_MIN && r == -1) {\n"
+            "        return l;\n"
+            "    }\n"
+            "    return l / r;\n"
+            "}\n"
+            "\n"
+            "static inline value sp_neg(value v) {\n"
+            "    return sp_wrap(0 - (uint64_t) v);\n"
+            "}\n"
+            "\n";
+
+        // C literal of `v`, INT64_MIN has none
+        inline std::string literal(value v) {
+            if (v == std::numeric_limits<value>::min()) {
+                return "INT64_MIN";
+            }
+            return v < 0 ? "(" + std::to_string(v) + "LL)" : std::to_string(v) + "LL";
+        }
+
+        class translator : parser::ast::visitor<translator> {
+        public:
+            translator(parser::ast::tree const & tree, std::string_view sv, std::string_view function) : visitor(tree), sv_(sv) {
+                out_.function = function;
+                for (auto node : parser::ast::preorder(tree)) {
+                    if (tree.get_kind(node) == parser::ast::kind::VAR) {
+                        auto [it, added] = variables_.emplace(tree.get_symbol(node, sv), variables_.size());
+                        if (added) {
+                            out_.variables.emplace_back(it->first);
+                        }
+                    }
+                }
+            }
+
+            translation run() && {
+                auto & s = out_.source;
+                s = PRELUDE;
+                s.append("int ").append(out_.function).append("(value * variables, uint64_t max_tests) {\n");
+                s.append("    uint64_t tests = 0;\n");
+                s.append("    int finished = 0;\n");
+                for (size_t var = 0; var < out_.variables.size(); ++var) {
+                    s.append("    value v").append(std::to_string(var)).append(" = variables[").append(std::to_string(var)).append("];\n");
+                }
+                s.append("\n");
+                depth_ = 1;
+                visit();
+                s.append("    finished = 1;\n");
+                s.append("stop:\n");
+                for (size_t var = 0; var < out_.variables.size(); ++var) {
+                    s.append("    variables[").append(std::to_string(var)).append("] = v").append(std::to_string(var)).append(";\n");
+                }
+                s.append("    return finished;\n");
+                s.append("}\n");
+                return std::move(out_);
+            }
+
+        private:
+            friend visitor;
+
+            void visit_if(uint16_t node) {
+                test();
+                indent().append("if (");
+                visit(tree_.get_left(node));
+                out_.source.append(") {\n");
+                block(tree_.get_right(node));
+            }
+
+            void visit_while(uint16_t node) {
+                indent().append("for (;;) {\n");
+                ++depth_;
+                test();
+                indent().append("if (!(");
+                visit(tree_.get_left(node));
+                out_.source.append(")) {\n");
+                indent().append("    break;\n");
+                indent().append("}\n");
+                --depth_;
+                block(tree_.get_right(node));
+            }
+
+            void visit_assignment(uint16_t node) {
+                indent();
+                visit(tree_.get_left(node));
+                out_.source.append(" = ");
+                visit(tree_.get_right(node));
+                out_.source.append(";\n");
+            }
+
+            void visit_var(uint16_t node) {
+                out_.source.append("v").append(std::to_string(variables_.at(tree_.get_symbol(node, sv_))));
+            }
+
+            void visit_const(uint16_t node) {
+                out_.source.append(literal(semantics::parse_constant(tree_.get_symbol(node, sv_))));
+            }
+
+            void visit_unop(uint16_t node) {
+                out_.source.append("sp_neg(");
+                visit(tree_.get_left(node));
+                out_.source.append(")");
+            }
+
+            void visit_binop(uint16_t node) {
+                auto & s = out_.source;
+                auto call = [&](std::string_view helper) {
+                    s.append(helper).append("(");
+                    visit(tree_.get_left(node));
+                    s.append(", ");
+                    visit(tree_.get_right(node));
+                    s.append(")");
+                };
+                // comparisons and logical operators give 0 or 1 in C as well; operands have no side effects,
+                // so short-circuiting changes nothing
+                auto infix = [&](std::string_view op) {
+                    s.append("(value) ((");
+                    visit(tree_.get_left(node));
+                    s.append(") ").append(op).append(" (");
+                    visit(tree_.get_right(node));
+                    s.append("))");
+                };
+
+                switch (tree_.get_operator_type(node)) {
+                    case lexer::PLUS:
+                        return call("sp_add");
+                    case lexer::MINUS:
+                        return call("sp_sub");
+                    case lexer::MULTIPLICATION:
+                        return call("sp_mul");
+                    case lexer::DIVISION:
+                        return call("sp_div");
+                    case lexer::LESS:
+                        return infix("<");
+                    case lexer::GREATER:
+                        return infix(">");
+                    case lexer::EQUAL:
+                        return infix("==");
+                    case lexer::NOT_EQUAL:
+                        return infix("!=");
+                    case lexer::LESS_EQUAL:
+                        return infix("<=");
+                    case lexer::GREATER_EQUAL:
+                        return infix(">=");
+                    case lexer::AND:
+                        return infix("&&");
+                    case lexer::OR:
+                        return infix("||");
+                    default:
+                        s.append("0");
+                }
+            }
+
+            // the body of an if or while up to the closing brace
+            void block(uint16_t body) {
+                ++depth_;
+                visit(body);
+                --depth_;
+                indent().append("}\n");
+            }
+
+            void test() {
+                indent().append("if (tests++ == max_tests) {\n");
+                indent().append("    goto stop;\n");
+                indent().append("}\n");
+            }
+
+            std::string & indent() {
+                return out_.source.append(4 * depth_, ' ');
+            }
+
+            std::string_view sv_;
+            std::unordered_map<std::string_view, uint32_t> variables_;
+            uint32_t depth_ = 0;
+            translation out_;
+        };
+
+    }
+
+    // `function` must be a C identifier
+    inline translation to_c(parser::ast::tree const & tree, std::string_view sv, std::string_view function = "run") {
+        return detail::translator(tree, sv, function).run();
+    }
+
+#if __has_include(<dlfcn.h>)
+
+    struct load_error {
+        std::string message;
+    };
+
+    // A translation compiled to a shared object and loaded; the object is unloaded with the library
+    class library {
+    public:
+        using function = int (*)(value *, uint64_t);
+
+        library(library && other) noexcept : handle_(std::exchange(other.handle_, nullptr)), function_(other.function_) {}
+
+        library & operator=(library && other) noexcept {
+            std::swap(handle_, other.handle_);
+            function_ = other.function_;
+            return *this;
+        }
+
+        ~library() {
+            if (handle_) {
+                dlclose(handle_);
+            }
+        }
+
+        // Runs the program for one environment, the variables in the order of the translation.
+        // Returns false when `max_tests` condition tests were not enough to finish.
+        bool run(std::span<value> variables, uint64_t max_tests = std::numeric_limits<uint64_t>::max()) const {
+            return function_(variables.data(), max_tests) != 0;
+        }
+
+    private:
+        library(void * handle, function f) : handle_(handle), function_(f) {}
+
+        void * handle_;
+        function function_;
+
+        friend std::variant<library, load_error> load(translation const &, std::string_view);
+    };
+
+    // Compiles `t` with the C compiler `compiler` (`$CC` when empty, else `cc`) in a temporary directory
+    // and loads the result
+    inline std::variant<library, load_error> load(translation const & t, std::string_view compiler = "") {
+        if (compiler.empty()) {
+            auto cc = std::getenv("CC");
+            compiler = cc && *cc ? cc : "cc";
+        }
+
+        std::string pattern = (std::filesystem::temp_directory_path() / "simple_parser_XXXXXX").string();
+        if (!mkdtemp(pattern.data())) {
+            return load_error{"cannot create a temporary directory"};
+        }
+        std::filesystem::path dir = pattern;
+        auto source = dir / "program.c";
+        auto object = dir / "program.so";
+        auto log = dir / "compiler.log";
+
+        auto fail = [&](std::string message) {
+            std::ifstream in(log);
+            std::stringstream output;
+            output << in.rdbuf();
+            std::error_code ignored;
+            std::filesystem::remove_all(dir, ignored);
+            return load_error{message + output.str()};
+        };
+
+        std::ofstream(source) << t.source;
+        std::string command = std::string(compiler) + " -O2 -shared -fPIC -o '" + object.string() + "' '" + source.string()
+                            + "' > '" + log.string() + "' 2>&1";
+        if (std::system(command.c_str()) != 0) {
+            return fail("compilation failed: ");
+        }
+
+        auto handle = dlopen(object.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle) {
+            return fail(std::string("dlopen failed: ") + dlerror());
+        }
+        auto f = reinterpret_cast<library::function>(dlsym(handle, t.function.c_str()));
+        if (!f) {
+            dlclose(handle);
+            return fail("no function " + t.function);
+        }
+
+        std::error_code ignored;
+        std::filesystem::remove_all(dir, ignored); // the loaded object stays mapped
+        return library(handle, f);
+    }
+
+#endif
+
+}
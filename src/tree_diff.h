@@ -0,0 +1,499 @@
+#pragma once
+
+#include <algorithm>
+#include <ostream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "hash_cons.h"
+#include "parser.h"
+#include "pretty_print.h"
+#include "visitor.h"
+
+namespace tree_diff {
+
+    enum class operation {
+        INSERT, // subtree of the new tree with no counterpart
+        DELETE, // subtree of the old tree with no counterpart
+        UPDATE, // same node, different operator or symbol
+        MOVE,   // same subtree, different parent or position
+    };
+
+    // Node indices are npos on the side the node does not exist on
+    struct edit {
+        operation op;
+        uint16_t old_node = parser::ast::tree::npos;
+        uint16_t new_node = parser::ast::tree::npos;
+        std::pair<uint32_t, uint32_t> old_range{};
+        std::pair<uint32_t, uint32_t> new_range{};
+    };
+
+    struct script {
+        std::vector<edit> edits;
+        std::vector<uint16_t> old_of_new; // matched node of the old tree for every new node, or npos
+    };
+
+    namespace detail {
+
+        using parser::ast::kind;
+        using parser::ast::tree;
+
+        // One side of the diff: the tree, its hashes and the position of every statement in its block
+        struct side {
+            side(tree const & t, std::string_view sv)
+                : t(t)
+                , sv(sv)
+                , hashes(parser::ast::structural_hashes(t, sv))
+                , matched(t.size(), tree::npos)
+                , owner(t.size(), tree::npos)
+                , position(t.size(), 0) {
+                for (auto node : parser::ast::preorder(t)) {
+                    for (auto child : parser::ast::children(t, node)) {
+                        owner[child] = is_glue(node) ? owner[node] : node;
+                    }
+                    if (t.get_kind(node) == kind::STATEMENTS && !is_glue(t.get_parent(node))) {
+                        uint32_t idx = 0;
+                        for_each_statement(node, [&](uint16_t statement) {
+                            position[statement] = idx++;
+                        });
+                    }
+                }
+            }
+
+            [[nodiscard]]
+            bool is_glue(uint16_t node) const {
+                return node != tree::npos && t.get_kind(node) == kind::STATEMENTS;
+            }
+
+            // statements of a list from first to last
+            template <typename F>
+            void for_each_statement(uint16_t node, F f) const {
+                while (t.get_kind(node) == kind::STATEMENTS) {
+                    if (t.get_kind(t.get_left(node)) == kind::STATEMENTS) {
+                        for_each_statement(t.get_left(node), f);
+                    } else {
+                        f(t.get_left(node));
+                    }
+                    node = t.get_right(node);
+                }
+                f(node);
+            }
+
+            // parent with statement lists seen through, npos for top level statements
+            [[nodiscard]]
+            uint16_t logical_parent(uint16_t node) const {
+                return owner[node];
+            }
+
+            [[nodiscard]]
+            bool is_statement(uint16_t node) const {
+                return is_glue(t.get_parent(node)) || node == t.get_root()
+                       || ((t.get_kind(t.get_parent(node)) == kind::IF || t.get_kind(t.get_parent(node)) == kind::WHILE)
+                           && t.get_right(t.get_parent(node)) == node);
+            }
+
+            // first statement of a list, any other node is its own
+            [[nodiscard]]
+            uint16_t first_statement(uint16_t node) const {
+                while (t.get_kind(node) == kind::STATEMENTS) {
+                    node = t.get_left(node);
+                }
+                return node;
+            }
+
+            // statement after `node` in its block, npos for the last one
+            [[nodiscard]]
+            uint16_t next_statement(uint16_t node) const {
+                auto parent = t.get_parent(node);
+                while (is_glue(parent) && t.get_right(parent) == node) {
+                    node = parent;
+                    parent = t.get_parent(node);
+                }
+                return is_glue(parent) ? first_statement(t.get_right(parent)) : tree::npos;
+            }
+
+            [[nodiscard]]
+            std::string_view label(uint16_t node) const {
+                auto k = t.get_kind(node);
+                return k == kind::VAR || k == kind::CONST ? t.get_symbol(node, sv) : std::string_view();
+            }
+
+            tree const & t;
+            std::string_view sv;
+            memory::vector<uint64_t> hashes;
+            std::vector<uint16_t> matched;
+            std::vector<uint16_t> owner;    // logical parent
+            std::vector<uint32_t> position; // index of a statement in its block
+        };
+
+        class matcher {
+        public:
+            matcher(side & old_side, side & new_side) : old_(old_side), new_(new_side) {
+                for (auto node : parser::ast::preorder(old_.t)) {
+                    old_by_hash_[old_.hashes[node]].nodes.push_back(node);
+                }
+                for (auto node : parser::ast::preorder(new_.t)) {
+                    ++new_count_[new_.hashes[node]];
+                }
+            }
+
+            void run() {
+                if (old_.t.empty() || new_.t.empty()) {
+                    return;
+                }
+                match_unique_subtrees();
+                match_slot(old_.t.get_root(), new_.t.get_root());
+                match_children_of_matched();
+                match_parents_of_matched();
+                match_children_of_matched();
+                match_repeated_subtrees();
+            }
+
+        private:
+            struct candidates {
+                std::vector<uint16_t> nodes; // pre-order
+                size_t next = 0;             // nodes before it are matched
+            };
+
+            [[nodiscard]]
+            bool same_kind(uint16_t old_node, uint16_t new_node) const {
+                return old_.t.get_kind(old_node) == new_.t.get_kind(new_node);
+            }
+
+            void match_pair(uint16_t old_node, uint16_t new_node) {
+                old_.matched[old_node] = new_node;
+                new_.matched[new_node] = old_node;
+            }
+
+            // subtrees are equal, not only their hashes
+            [[nodiscard]]
+            bool equal_subtrees(uint16_t old_node, uint16_t new_node) const {
+                auto old_range = parser::ast::preorder(old_.t, old_node);
+                auto new_range = parser::ast::preorder(new_.t, new_node);
+                auto it = new_range.begin();
+                for (auto o : old_range) {
+                    auto n = *it++;
+                    if (old_.t.get_kind(o) != new_.t.get_kind(n)
+                        || old_.t.get_operator_type(o) != new_.t.get_operator_type(n)
+                        || old_.t.have_left(o) != new_.t.have_left(n)
+                        || old_.t.have_right(o) != new_.t.have_right(n)
+                        || old_.label(o) != new_.label(n)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            // Matches equal subtrees node by node, only if none of their nodes has a counterpart yet so that
+            // earlier matches stay and every node keeps one counterpart at most
+            bool try_match_subtrees(uint16_t old_node, uint16_t new_node) {
+                if (old_.matched[old_node] != tree::npos || !equal_subtrees(old_node, new_node)) {
+                    return false;
+                }
+                auto old_range = parser::ast::preorder(old_.t, old_node);
+                auto new_range = parser::ast::preorder(new_.t, new_node);
+                auto it = new_range.begin();
+                for (auto o : old_range) {
+                    if (old_.matched[o] != tree::npos || new_.matched[*it++] != tree::npos) {
+                        return false;
+                    }
+                }
+                it = new_range.begin();
+                for (auto o : old_range) {
+                    match_pair(o, *it++);
+                }
+                return true;
+            }
+
+            // Subtrees occurring exactly once on both sides are the same code, largest first
+            void match_unique_subtrees() {
+                for (auto node : parser::ast::preorder(new_.t)) {
+                    auto h = new_.hashes[node];
+                    if (new_.matched[node] != tree::npos || new_count_[h] != 1) {
+                        continue;
+                    }
+                    auto found = old_by_hash_.find(h);
+                    if (found != old_by_hash_.end() && found->second.nodes.size() == 1) {
+                        try_match_subtrees(found->second.nodes.front(), node);
+                    }
+                }
+            }
+
+            // Children in the same slot of matched parents correspond if they are of the same kind
+            void match_children_of_matched() {
+                for (auto node : parser::ast::preorder(new_.t)) {
+                    auto old_node = new_.matched[node];
+                    if (old_node == tree::npos || new_.is_glue(node)) {
+                        continue;
+                    }
+                    match_slot(old_.t.get_left(old_node), new_.t.get_left(node));
+                    match_slot(old_.t.get_right(old_node), new_.t.get_right(node));
+                    if (new_.is_statement(node)) {
+                        match_slot(old_.next_statement(old_node), new_.next_statement(node));
+                    }
+                }
+            }
+
+            // Children in the same slot of matched parents correspond if they are of the same kind,
+            // statement lists are compared by their first statements since their glue nodes carry no meaning
+            void match_slot(uint16_t old_child, uint16_t new_child) {
+                if (old_child == tree::npos || new_child == tree::npos) {
+                    return;
+                }
+                old_child = old_.first_statement(old_child);
+                new_child = new_.first_statement(new_child);
+                if (old_.matched[old_child] != tree::npos || new_.matched[new_child] != tree::npos
+                    || !same_kind(old_child, new_child)) {
+                    return;
+                }
+                if (old_.hashes[old_child] != new_.hashes[new_child] || !try_match_subtrees(old_child, new_child)) {
+                    match_pair(old_child, new_child);
+                }
+            }
+
+            // A node whose child is matched corresponds to the logical parent of the child's counterpart
+            void match_parents_of_matched() {
+                for (auto node : parser::ast::postorder(new_.t)) {
+                    if (new_.matched[node] != tree::npos || new_.is_glue(node)) {
+                        continue;
+                    }
+                    for (auto child : parser::ast::children(new_.t, node)) {
+                        auto old_child = new_.matched[new_.first_statement(child)];
+                        if (old_child == tree::npos) {
+                            continue;
+                        }
+                        auto old_parent = old_.logical_parent(old_child);
+                        if (old_parent != tree::npos && old_.matched[old_parent] == tree::npos && same_kind(old_parent, node)) {
+                            match_pair(old_parent, node);
+                            break;
+                        }
+                    }
+                }
+            }
+
+            // What is left and has an identical copy in the old tree was moved there. Copies are taken
+            // in order and every candidate list is scanned once. Lone leaves are not worth a move.
+            void match_repeated_subtrees() {
+                for (auto node : parser::ast::preorder(new_.t)) {
+                    if (new_.matched[node] != tree::npos || new_.is_glue(node)
+                        || (!new_.t.have_left(node) && !new_.t.have_right(node))) {
+                        continue;
+                    }
+                    auto found = old_by_hash_.find(new_.hashes[node]);
+                    if (found == old_by_hash_.end()) {
+                        continue;
+                    }
+                    auto & c = found->second;
+                    while (c.next < c.nodes.size() && old_.matched[c.nodes[c.next]] != tree::npos) {
+                        ++c.next;
+                    }
+                    if (c.next < c.nodes.size()) {
+                        try_match_subtrees(c.nodes[c.next], node);
+                    }
+                }
+            }
+
+            side & old_;
+            side & new_;
+            std::unordered_map<uint64_t, candidates> old_by_hash_;
+            std::unordered_map<uint64_t, uint32_t> new_count_;
+        };
+
+        // Indices of a longest strictly increasing subsequence, O(n log n)
+        inline std::vector<size_t> longest_increasing(std::vector<uint32_t> const & values) {
+            std::vector<size_t> tails;            // index of the smallest tail of every length
+            std::vector<size_t> previous(values.size());
+            for (size_t idx = 0; idx < values.size(); ++idx) {
+                auto it = std::lower_bound(tails.begin(), tails.end(), values[idx], [&](size_t tail, uint32_t value) {
+                    return values[tail] < value;
+                });
+                previous[idx] = it == tails.begin() ? values.size() : *(it - 1);
+                if (it == tails.end()) {
+                    tails.push_back(idx);
+                } else {
+                    *it = idx;
+                }
+            }
+
+            std::vector<size_t> result(tails.size());
+            auto idx = tails.empty() ? values.size() : tails.back();
+            for (auto out = result.rbegin(); out != result.rend(); ++out) {
+                *out = idx;
+                idx = previous[idx];
+            }
+            return result;
+        }
+
+        class script_builder {
+        public:
+            script_builder(side const & old_side, side const & new_side) : old_(old_side), new_(new_side) {}
+
+            script run() && {
+                moved_.assign(new_.t.size(), false);
+                find_reordered_statements();
+
+                for (auto node : parser::ast::preorder(new_.t)) {
+                    if (new_.t.get_kind(node) == kind::STATEMENTS) {
+                        continue;
+                    }
+                    auto old_node = new_.matched[node];
+                    if (old_node == tree::npos) {
+                        if (is_outermost(new_, node)) {
+                            add(operation::INSERT, tree::npos, node);
+                        }
+                        continue;
+                    }
+                    if (new_.t.get_operator_type(node) != old_.t.get_operator_type(old_node)
+                        || new_.label(node) != old_.label(old_node)) {
+                        add(operation::UPDATE, old_node, node);
+                    }
+                    if (moved_[node] || !same_place(old_node, node)) {
+                        add(operation::MOVE, old_node, node);
+                    }
+                }
+
+                for (auto node : parser::ast::preorder(old_.t)) {
+                    if (old_.t.get_kind(node) != kind::STATEMENTS && old_.matched[node] == tree::npos
+                        && is_outermost(old_, node)) {
+                        add(operation::DELETE, node, tree::npos);
+                    }
+                }
+
+                result_.old_of_new = new_.matched;
+                return std::move(result_);
+            }
+
+        private:
+            // the node is unmatched and its nearest ancestor which is not a statement list is matched
+            [[nodiscard]]
+            static bool is_outermost(side const & s, uint16_t node) {
+                auto parent = s.logical_parent(node);
+                return parent == tree::npos || s.matched[parent] != tree::npos;
+            }
+
+            // parent corresponds and, for expressions, the node is in the same slot
+            [[nodiscard]]
+            bool same_place(uint16_t old_node, uint16_t new_node) const {
+                auto old_parent = old_.logical_parent(old_node);
+                auto new_parent = new_.logical_parent(new_node);
+                if (new_parent == tree::npos || old_parent == tree::npos) {
+                    return new_parent == old_parent;
+                }
+                if (new_.matched[new_parent] != old_parent) {
+                    return false;
+                }
+                if (new_.is_statement(new_node) || old_.is_statement(old_node)) {
+                    return new_.is_statement(new_node) == old_.is_statement(old_node);
+                }
+                return (old_.t.get_left(old_parent) == old_node) == (new_.t.get_left(new_parent) == new_node);
+            }
+
+            // Statements staying in the same block keep the longest run in the old order, the others moved
+            void find_reordered_statements() {
+                auto check_block = [&](uint16_t list) {
+                    std::vector<uint16_t> statements;
+                    std::vector<uint32_t> old_positions;
+                    new_.for_each_statement(list, [&](uint16_t statement) {
+                        auto old_node = new_.matched[statement];
+                        if (old_node != tree::npos && same_place(old_node, statement)) {
+                            statements.push_back(statement);
+                            old_positions.push_back(old_.position[old_node]);
+                        }
+                    });
+
+                    std::vector<char> kept(statements.size(), false);
+                    for (auto idx : longest_increasing(old_positions)) {
+                        kept[idx] = true;
+                    }
+                    for (size_t idx = 0; idx < statements.size(); ++idx) {
+                        moved_[statements[idx]] = !kept[idx];
+                    }
+                };
+
+                for (auto node : parser::ast::preorder(new_.t)) {
+                    if (new_.t.get_kind(node) == kind::STATEMENTS && !new_.is_glue(new_.t.get_parent(node))) {
+                        check_block(node);
+                    }
+                }
+            }
+
+            void add(operation op, uint16_t old_node, uint16_t new_node) {
+                edit e{.op = op, .old_node = old_node, .new_node = new_node};
+                if (old_node != tree::npos) {
+                    e.old_range = old_.t.get_range(old_node);
+                }
+                if (new_node != tree::npos) {
+                    e.new_range = new_.t.get_range(new_node);
+                }
+                result_.edits.push_back(e);
+            }
+
+            side const & old_;
+            side const & new_;
+            std::vector<char> moved_;
+            script result_;
+        };
+
+        inline char const * operation_to_string(operation op) {
+            switch (op) {
+                case operation::INSERT:
+                    return "INSERT";
+                case operation::DELETE:
+                    return "DELETE";
+                case operation::UPDATE:
+                    return "UPDATE";
+                case operation::MOVE:
+                    return "MOVE";
+            }
+            return "";
+        }
+
+    }
+
+    // Edit script turning `old_tree` into `new_tree`. Identical subtrees are matched by their structural
+    // hashes first, the rest through matched parents and children, so the time is linear in the tree sizes
+    // apart from the reordering of statements inside a block (n log n in the block length).
+    // Inserted and deleted subtrees are reported once at their outermost node; statement lists are glue
+    // and never appear in the script.
+    inline script diff(
+        parser::ast::tree const & old_tree,
+        std::string_view old_sv,
+        parser::ast::tree const & new_tree,
+        std::string_view new_sv
+    ) {
+        detail::side old_side(old_tree, old_sv);
+        detail::side new_side(new_tree, new_sv);
+        detail::matcher(old_side, new_side).run();
+        return detail::script_builder(old_side, new_side).run();
+    }
+
+    // One edit per line, `MOVE [4..9] 'a + b' -> [12..17] 'a + b'`
+    inline void print(std::ostream & out, script const & s, std::string_view old_sv, std::string_view new_sv) {
+        ::detail::output_buffer buffer(out);
+        auto append_range = [&](std::pair<uint32_t, uint32_t> range, std::string_view sv) {
+            buffer.append('[');
+            buffer.append_number(range.first);
+            buffer.append("..");
+            buffer.append_number(range.second);
+            buffer.append("] '");
+            buffer.append(sv.substr(range.first, range.second - range.first));
+            buffer.append('\'');
+        };
+
+        for (auto const & e : s.edits) {
+            buffer.append(detail::operation_to_string(e.op));
+            buffer.append(' ');
+            if (e.old_node != parser::ast::tree::npos) {
+                append_range(e.old_range, old_sv);
+            }
+            if (e.old_node != parser::ast::tree::npos && e.new_node != parser::ast::tree::npos) {
+                buffer.append(" -> ");
+            }
+            if (e.new_node != parser::ast::tree::npos) {
+                append_range(e.new_range, new_sv);
+            }
+            buffer.append('\n');
+        }
+    }
+
+}
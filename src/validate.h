@@ -0,0 +1,320 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include "lexer.h"
+#include "parser.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace parser {
+
+    namespace detail {
+
+        enum class char_class {
+            WHITESPACE,
+            ALPHA,
+            DIGIT,
+        };
+
+        template <char_class CLASS>
+        constexpr bool is(char c) {
+            if constexpr (CLASS == char_class::WHITESPACE) {
+                return lexer::chars::is_whitespace(c);
+            } else if constexpr (CLASS == char_class::ALPHA) {
+                return lexer::chars::is_alpha(c);
+            } else {
+                return lexer::chars::is_digit(c);
+            }
+        }
+
+    #if defined(__SSE2__)
+        // bit i set when byte i of `chunk` is of the class
+        template <char_class CLASS>
+        inline uint32_t members(__m128i chunk) {
+            __m128i in;
+            if constexpr (CLASS == char_class::WHITESPACE) {
+                in = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))));
+            } else {
+                // bytes from 0x80 are negative, below any bound
+                auto low = CLASS == char_class::ALPHA ? 'a' : '0';
+                auto high = CLASS == char_class::ALPHA ? 'z' : '9';
+                if constexpr (CLASS == char_class::ALPHA) {
+                    chunk = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+                }
+                in = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(static_cast<char>(low - 1))),
+                                   _mm_cmplt_epi8(chunk, _mm_set1_epi8(static_cast<char>(high + 1))));
+            }
+            return static_cast<uint32_t>(_mm_movemask_epi8(in));
+        }
+    #endif
+
+        // first position from `pos` on whose character is not of the class
+        template <char_class CLASS>
+        constexpr uint32_t skip(std::string_view sv, uint32_t pos) {
+            auto size = static_cast<uint32_t>(sv.size());
+            // most runs are a character or two, the vector loop pays off on the longer ones
+            for (auto stop = std::min(pos + 4, size); pos < stop; ++pos) {
+                if (!is<CLASS>(sv[pos])) {
+                    return pos;
+                }
+            }
+
+        #if defined(__SSE2__)
+            if (!std::is_constant_evaluated()) {
+                for (; pos + 16 <= size; pos += 16) {
+                    auto chunk = _mm_loadu_si128(reinterpret_cast<__m128i const *>(sv.data() + pos));
+                    if (auto outside = ~members<CLASS>(chunk) & 0xFFFF) {
+                        return pos + std::countr_zero(outside);
+                    }
+                }
+            }
+        #endif
+
+            while (pos < size && is<CLASS>(sv[pos])) {
+                ++pos;
+            }
+            return pos;
+        }
+
+        // `sv.substr(pos).starts_with(prefix)` for `pos <= sv.size()`, without the bounds checks
+        constexpr bool starts_with(std::string_view sv, uint32_t pos, std::string_view prefix) {
+            if (sv.size() - pos < prefix.size()) {
+                return false;
+            }
+            for (size_t idx = 0; idx < prefix.size(); ++idx) {
+                if (sv[pos + idx] != prefix[idx]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Rows of an operator table by the first character of their symbol, as bit masks, so that
+        // most positions are rejected by one lookup
+        template <size_t N>
+        constexpr std::array<uint16_t, 256> by_first_char(lexer::operator_info const (&table)[N]) {
+            static_assert(N <= 16);
+            std::array<uint16_t, 256> result{};
+            for (size_t row = 0; row < N; ++row) {
+                result[static_cast<uint8_t>(table[row].symbol.front())] |= 1u << row;
+            }
+            return result;
+        }
+
+        inline constexpr auto binary_operators_by_first_char = by_first_char(lexer::binary_operators);
+        inline constexpr auto prefix_operators_by_first_char = by_first_char(lexer::prefix_operators);
+
+        // length of the longest symbol of `table` at `pos < sv.size()`, 0 if none
+        template <size_t N>
+        constexpr uint32_t longest_symbol(
+            lexer::operator_info const (&table)[N],
+            std::array<uint16_t, 256> const & by_first_char,
+            std::string_view sv,
+            uint32_t pos
+        ) {
+            uint32_t longest = 0;
+            for (uint32_t rows = by_first_char[static_cast<uint8_t>(sv[pos])]; rows; rows &= rows - 1) {
+                auto const & symbol = table[std::countr_zero(rows)].symbol;
+                if (symbol.size() > longest && starts_with(sv, pos, symbol)) {
+                    longest = symbol.size();
+                }
+            }
+            return longest;
+        }
+
+        // The grammar of `lexer::program` walked without emitting tokens. Every branch mirrors the
+        // lexer's, down to which combinator fails first, so errors come out with the same cause and
+        // position.
+        class validator {
+        public:
+            constexpr explicit validator(std::string_view sv) : sv_(sv), size_(sv.size()) {}
+
+            constexpr std::optional<lexer::error> run() && {
+                pos_ = skip<char_class::WHITESPACE>(sv_, 0);
+                do {
+                    if (auto error = statement()) {
+                        return error;
+                    }
+                } while (pos_ < size_);
+                if (too_many_nodes_ != NONE) {
+                    return lexer::error{.cause = lexer::errors::TOO_MANY_NODES, .pos = too_many_nodes_};
+                }
+                return std::nullopt;
+            }
+
+        private:
+            constexpr std::optional<lexer::error> statement() {
+                uint32_t opened = 0; // if and while without their end yet
+                while (true) {
+                    auto start = pos_;
+                    if (auto len = keyword()) {
+                        add_nodes(1);
+                        pos_ = skip<char_class::WHITESPACE>(sv_, pos_ + len);
+                        if (auto error = expression()) {
+                            return error;
+                        }
+                        pos_ = skip<char_class::WHITESPACE>(sv_, pos_);
+                        ++opened;
+                        continue;
+                    }
+
+                    if (auto error = assignment()) {
+                        if (opened) {
+                            return lexer::error{.cause = lexer::errors::UNFINISHED_STATEMENT, .pos = start};
+                        }
+                        return error;
+                    }
+                    pos_ = skip<char_class::WHITESPACE>(sv_, pos_);
+
+                    std::string_view end = lexer::token_strings::END;
+                    while (opened && starts_with(sv_, pos_, end)) {
+                        pos_ = skip<char_class::WHITESPACE>(sv_, pos_ + end.size());
+                        --opened;
+                    }
+                    if (!opened) {
+                        return std::nullopt;
+                    }
+                }
+            }
+
+            // length of the keyword `pos_` starts with, keywords being prefixes like in `lexer::k_while`
+            constexpr uint32_t keyword() const {
+                std::string_view k_while = lexer::token_strings::WHILE;
+                std::string_view k_if = lexer::token_strings::IF;
+                if (starts_with(sv_, pos_, k_while)) {
+                    return k_while.size();
+                }
+                return starts_with(sv_, pos_, k_if) ? k_if.size() : 0;
+            }
+
+            // `lexer::assignment`, the first failing part gives the error
+            constexpr std::optional<lexer::error> assignment() {
+                if (auto error = expect(is<char_class::ALPHA>(peek()))) {
+                    return error;
+                }
+                add_nodes(1);
+                pos_ = skip<char_class::WHITESPACE>(sv_, skip<char_class::ALPHA>(sv_, pos_));
+                if (auto error = expect(peek() == '=')) {
+                    return error;
+                }
+                add_nodes(2);
+                pos_ = skip<char_class::WHITESPACE>(sv_, pos_ + 1);
+                return expression();
+            }
+
+            // `lexer::expression`, with the same bound on nesting
+            constexpr std::optional<lexer::error> expression() {
+                std::array<uint32_t, lexer::MAX_NESTING> outer; // written before read, no need to clear it
+                uint32_t opened = 0;
+                uint32_t depth = 0;
+                uint32_t operand_start = 0;
+
+                while (true) {
+                    while (true) {
+                        uint32_t len = 0;
+                        bool open = peek() == '(';
+                        if (open) {
+                            len = 1;
+                        } else if (pos_ < size_) {
+                            len = longest_symbol(lexer::prefix_operators, prefix_operators_by_first_char, sv_, pos_);
+                        }
+                        if (!len) {
+                            break;
+                        }
+                        if (depth == lexer::MAX_NESTING) {
+                            return lexer::error{.cause = lexer::errors::NESTING_TOO_DEEP, .pos = pos_};
+                        }
+                        if (open) {
+                            outer[opened++] = operand_start;
+                            operand_start = ++depth;
+                        } else {
+                            add_nodes(1);
+                            ++depth;
+                        }
+                        pos_ = skip<char_class::WHITESPACE>(sv_, pos_ + len);
+                    }
+
+                    if (is<char_class::ALPHA>(peek())) {
+                        add_nodes(1);
+                        pos_ = skip<char_class::ALPHA>(sv_, pos_);
+                    } else if (is<char_class::DIGIT>(peek())) {
+                        add_nodes(1);
+                        pos_ = skip<char_class::DIGIT>(sv_, pos_);
+                    } else {
+                        return lexer::error{.cause = lexer::errors::IDENTIFIER_OR_CONSTANT_EXPECTED, .pos = pos_};
+                    }
+                    depth = operand_start;
+                    pos_ = skip<char_class::WHITESPACE>(sv_, pos_);
+
+                    while (opened && peek() == ')') {
+                        depth = operand_start = outer[--opened];
+                        pos_ = skip<char_class::WHITESPACE>(sv_, pos_ + 1);
+                    }
+
+                    if (pos_ < size_) {
+                        if (auto len = longest_symbol(lexer::binary_operators, binary_operators_by_first_char, sv_, pos_)) {
+                            add_nodes(1);
+                            pos_ = skip<char_class::WHITESPACE>(sv_, pos_ + len);
+                            continue;
+                        }
+                    }
+
+                    if (opened) {
+                        return lexer::error{.cause = lexer::errors::UNCLOSED_PARENTHESIS, .pos = pos_};
+                    }
+                    return std::nullopt;
+                }
+            }
+
+            // `parser::detail::check_node_count` for the token at `pos_`; lexing errors come first, so the
+            // position is kept until the end
+            constexpr void add_nodes(uint32_t count) {
+                nodes_ += count;
+                if (nodes_ > parser::ast::tree::MAX_NODES + 1 && too_many_nodes_ == NONE) {
+                    too_many_nodes_ = pos_;
+                }
+            }
+
+            // character at `pos_`, 0 past the end
+            constexpr char peek() const {
+                return pos_ < size_ ? sv_[pos_] : '\0';
+            }
+
+            // the error of a one character combinator at `pos_` when `ok` does not hold
+            constexpr std::optional<lexer::error> expect(bool ok) const {
+                if (pos_ >= size_) {
+                    return lexer::error{.cause = lexer::errors::STRING_IS_TOO_SHORT, .pos = size_};
+                }
+                if (!ok) {
+                    return lexer::error{.cause = lexer::errors::INVALID_SYMBOL, .pos = pos_};
+                }
+                return std::nullopt;
+            }
+
+            static constexpr uint32_t NONE = -1;
+
+            std::string_view sv_;
+            uint32_t size_;
+            uint32_t pos_ = 0;
+            uint32_t nodes_ = 0;
+            uint32_t too_many_nodes_ = NONE;
+        };
+
+    }
+
+    // Whether `sv` is a program, without building tokens or a tree and without allocating.
+    // Errors are the ones `parse` reports, cause and position.
+    constexpr std::optional<lexer::error> validate(std::string_view sv) {
+        return detail::validator(sv).run();
+    }
+
+}
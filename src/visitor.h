@@ -0,0 +1,336 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include "parser.h"
+
+namespace parser::ast {
+
+    // Children of a node from left to right, at most two, stored inline
+    class children_range {
+    public:
+        constexpr children_range(tree const & t, uint16_t node) {
+            if (t.have_left(node)) {
+                nodes_[size_++] = t.get_left(node);
+            }
+            if (t.have_right(node)) {
+                nodes_[size_++] = t.get_right(node);
+            }
+        }
+
+        [[nodiscard]]
+        constexpr uint16_t const * begin() const {
+            return nodes_.data();
+        }
+
+        [[nodiscard]]
+        constexpr uint16_t const * end() const {
+            return nodes_.data() + size_;
+        }
+
+        [[nodiscard]]
+        constexpr size_t size() const {
+            return size_;
+        }
+
+        [[nodiscard]]
+        constexpr bool empty() const {
+            return size_ == 0;
+        }
+
+    private:
+        std::array<uint16_t, 2> nodes_{};
+        uint8_t size_ = 0;
+    };
+
+    [[nodiscard]]
+    constexpr children_range children(tree const & t, uint16_t node) {
+        return {t, node};
+    }
+
+    namespace detail {
+
+        // Euler tour of a subtree: every node is entered, its children are toured, then it is left.
+        // The way up follows parent links, so a tour needs no stack whatever the depth of the tree.
+        class tour {
+        public:
+            constexpr tour() = default;
+
+            constexpr tour(tree const & t, uint16_t root) : tree_(&t), root_(root), node_(root) {}
+
+            constexpr void advance() {
+                if (!leaving_) {
+                    if (tree_->have_left(node_)) {
+                        node_ = tree_->get_left(node_);
+                        ++depth_;
+                    } else if (tree_->have_right(node_)) {
+                        node_ = tree_->get_right(node_);
+                        ++depth_;
+                    } else {
+                        leaving_ = true;
+                    }
+                    return;
+                }
+
+                if (node_ == root_) {
+                    node_ = tree::npos;
+                    return;
+                }
+                auto parent = tree_->get_parent(node_);
+                if (tree_->get_left(parent) == node_ && tree_->have_right(parent)) {
+                    node_ = tree_->get_right(parent);
+                    leaving_ = false;
+                } else {
+                    node_ = parent;
+                    --depth_;
+                }
+            }
+
+            [[nodiscard]]
+            constexpr uint16_t node() const {
+                return node_;
+            }
+
+            [[nodiscard]]
+            constexpr uint32_t depth() const {
+                return depth_;
+            }
+
+            [[nodiscard]]
+            constexpr bool leaving() const {
+                return leaving_;
+            }
+
+            [[nodiscard]]
+            constexpr bool done() const {
+                return node_ == tree::npos;
+            }
+
+        private:
+            tree const * tree_ = nullptr;
+            uint16_t root_ = tree::npos;
+            uint16_t node_ = tree::npos;
+            uint32_t depth_ = 0;
+            bool leaving_ = false;
+        };
+
+    }
+
+    enum class order {
+        PRE,  // parents before their children
+        POST, // children before their parents
+    };
+
+    // Forward iterator over the nodes of a subtree, no allocation; depth() is relative to the subtree root
+    template <order ORDER>
+    class traversal_iterator {
+    public:
+        using value_type = uint16_t;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        constexpr traversal_iterator() = default;
+
+        constexpr traversal_iterator(tree const & t, uint16_t root) : tour_(t, root) {
+            if constexpr (ORDER == order::POST) {
+                skip();
+            }
+        }
+
+        [[nodiscard]]
+        constexpr uint16_t operator*() const {
+            return tour_.node();
+        }
+
+        [[nodiscard]]
+        constexpr uint32_t depth() const {
+            return tour_.depth();
+        }
+
+        constexpr traversal_iterator & operator++() {
+            tour_.advance();
+            skip();
+            return *this;
+        }
+
+        constexpr traversal_iterator operator++(int) {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        [[nodiscard]]
+        constexpr bool operator==(std::default_sentinel_t) const {
+            return tour_.done();
+        }
+
+        [[nodiscard]]
+        constexpr bool operator==(traversal_iterator const & other) const {
+            return tour_.node() == other.tour_.node();
+        }
+
+    private:
+        // moves to the next step that belongs to this order
+        constexpr void skip() {
+            while (!tour_.done() && tour_.leaving() != (ORDER == order::POST)) {
+                tour_.advance();
+            }
+        }
+
+        detail::tour tour_;
+    };
+
+    template <order ORDER>
+    class traversal {
+    public:
+        constexpr traversal(tree const & t, uint16_t root) : tree_(t), root_(root) {}
+
+        [[nodiscard]]
+        constexpr traversal_iterator<ORDER> begin() const {
+            return root_ == tree::npos ? traversal_iterator<ORDER>() : traversal_iterator<ORDER>(tree_, root_);
+        }
+
+        [[nodiscard]]
+        constexpr std::default_sentinel_t end() const {
+            return {};
+        }
+
+    private:
+        tree const & tree_;
+        uint16_t root_;
+    };
+
+    // Nodes of the subtree of `node` in pre-order, the whole tree by default
+    [[nodiscard]]
+    constexpr traversal<order::PRE> preorder(tree const & t, uint16_t node) {
+        return {t, node};
+    }
+
+    [[nodiscard]]
+    constexpr traversal<order::PRE> preorder(tree const & t) {
+        return {t, t.empty() ? tree::npos : t.get_root()};
+    }
+
+    // Nodes of the subtree of `node` in post-order, the whole tree by default
+    [[nodiscard]]
+    constexpr traversal<order::POST> postorder(tree const & t, uint16_t node) {
+        return {t, node};
+    }
+
+    [[nodiscard]]
+    constexpr traversal<order::POST> postorder(tree const & t) {
+        return {t, t.empty() ? tree::npos : t.get_root()};
+    }
+
+    // Calls `enter(node, depth)` when a node is reached and `leave(node, depth)` after all its children
+    template <typename Enter, typename Leave>
+    constexpr void walk(tree const & t, uint16_t node, Enter enter, Leave leave) {
+        if (node == tree::npos) {
+            return;
+        }
+        for (detail::tour tour(t, node); !tour.done(); tour.advance()) {
+            if (tour.leaving()) {
+                leave(tour.node(), tour.depth());
+            } else {
+                enter(tour.node(), tour.depth());
+            }
+        }
+    }
+
+    template <typename Enter, typename Leave>
+    constexpr void walk(tree const & t, Enter enter, Leave leave) {
+        walk(t, t.empty() ? tree::npos : t.get_root(), enter, leave);
+    }
+
+    // Statically dispatched visitor, `Derived` hides the hooks it is interested in:
+    //
+    //     struct counter : ast::visitor<counter> {
+    //         using visitor::visitor;
+    //         constexpr void visit_var(uint16_t) { ++vars; }
+    //         uint32_t vars = 0;
+    //     };
+    //
+    // By default a hook visits the children of its node, and a statement list is walked
+    // as a loop over its right-nested chain, so long programs do not deepen the recursion.
+    template <typename Derived>
+    class visitor {
+    public:
+        constexpr explicit visitor(tree const & t) : tree_(t) {}
+
+        constexpr void visit(uint16_t node) {
+            switch (tree_.get_kind(node)) {
+                case kind::IF:
+                    return derived().visit_if(node);
+                case kind::WHILE:
+                    return derived().visit_while(node);
+                case kind::ASSIGNMENT:
+                    return derived().visit_assignment(node);
+                case kind::VAR:
+                    return derived().visit_var(node);
+                case kind::CONST:
+                    return derived().visit_const(node);
+                case kind::BINOP:
+                    return derived().visit_binop(node);
+                case kind::UNOP:
+                    return derived().visit_unop(node);
+                case kind::STATEMENTS:
+                    return derived().visit_statements(node);
+            }
+        }
+
+        // visits the whole tree
+        constexpr void visit() {
+            if (!tree_.empty()) {
+                visit(tree_.get_root());
+            }
+        }
+
+        constexpr void visit_children(uint16_t node) {
+            for (auto child : children(tree_, node)) {
+                visit(child);
+            }
+        }
+
+        constexpr void visit_if(uint16_t node) {
+            visit_children(node);
+        }
+
+        constexpr void visit_while(uint16_t node) {
+            visit_children(node);
+        }
+
+        constexpr void visit_assignment(uint16_t node) {
+            visit_children(node);
+        }
+
+        constexpr void visit_var(uint16_t) {}
+
+        constexpr void visit_const(uint16_t) {}
+
+        constexpr void visit_binop(uint16_t node) {
+            visit_children(node);
+        }
+
+        constexpr void visit_unop(uint16_t node) {
+            visit_children(node);
+        }
+
+        constexpr void visit_statements(uint16_t node) {
+            while (tree_.get_kind(node) == kind::STATEMENTS) {
+                visit(tree_.get_left(node));
+                node = tree_.get_right(node);
+            }
+            visit(node);
+        }
+
+    protected:
+        tree const & tree_;
+
+    private:
+        constexpr Derived & derived() {
+            return static_cast<Derived &>(*this);
+        }
+    };
+
+}
@@ -0,0 +1,101 @@
+#include <catch2/catch.hpp>
+
+#include <allocator.h>
+#include <analyze.h>
+#include <parser.h>
+#include <pretty_print.h>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace {
+
+    // Counts what passes through it, backed by the heap
+    class counting_resource : public std::pmr::memory_resource {
+    public:
+        size_t allocations = 0;
+        size_t live_bytes = 0;
+
+    private:
+        void * do_allocate(size_t bytes, size_t alignment) override {
+            ++allocations;
+            live_bytes += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void * ptr, size_t bytes, size_t alignment) override {
+            live_bytes -= bytes;
+            std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+        }
+
+        [[nodiscard]]
+        bool do_is_equal(std::pmr::memory_resource const & other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    std::string program() {
+        std::string input;
+        for (int idx = 0; idx < 50; ++idx) {
+            input += "a = b + " + std::to_string(idx) + "\nwhile a > 0\n    a = a - 1\nend\nb = a\n";
+        }
+        return input;
+    }
+
+}
+
+TEST_CASE("Parse and analysis allocate from the given resource", "[allocator]") {
+    auto input = program();
+    auto expected = std::get<parser::ast::tree>(parser::parse(input));
+    auto expected_unused = find_unused_assignments(expected, input);
+
+    counting_resource resource;
+    {
+        auto tree = std::get<parser::ast::tree>(parser::parse(input, &resource));
+        auto after_parse = resource.allocations;
+        REQUIRE(after_parse > 0);
+        REQUIRE(resource.live_bytes >= tree.memory_usage()); // the tokens are gone, the nodes are not
+
+        std::string printed, reference;
+        printer::print_json(printed, tree);
+        printer::print_json(reference, expected);
+        REQUIRE(printed == reference);
+
+        auto unused = find_unused_assignments(tree, input, &resource);
+        REQUIRE(resource.allocations > after_parse);
+        REQUIRE(std::vector<uint32_t>(unused.begin(), unused.end()) == expected_unused);
+        REQUIRE(unused.get_allocator().resource() == &resource);
+    }
+    REQUIRE(resource.live_bytes == 0);
+}
+
+TEST_CASE("Containers of the allocator copy to the heap and move in place", "[allocator]") {
+    counting_resource resource;
+    memory::vector<int> values({1, 2, 3}, &resource);
+    REQUIRE(resource.allocations == 1);
+
+    auto copy = values;
+    REQUIRE(copy.get_allocator().resource() == nullptr);
+    REQUIRE(resource.allocations == 1);
+
+    memory::vector<int> moved;
+    moved = std::move(values);
+    REQUIRE(moved.get_allocator().resource() == &resource);
+    REQUIRE(resource.allocations == 1);
+    REQUIRE(moved == copy);
+}
+
+TEST_CASE("A monotonic arena holds a whole request", "[allocator]") {
+    auto input = program();
+    auto expected = find_unused_assignments(std::get<parser::ast::tree>(parser::parse(input)), input);
+    std::vector<std::byte> buffer(1 << 20);
+    std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+    for (int round = 0; round < 3; ++round) {
+        {
+            auto tree = std::get<parser::ast::tree>(parser::parse(input, &arena));
+            auto unused = find_unused_assignments(tree, input, &arena);
+            REQUIRE(std::vector<uint32_t>(unused.begin(), unused.end()) == expected);
+        }
+        arena.release();
+    }
+}
@@ -1,6 +1,7 @@
 #include <catch2/catch.hpp>
 
 #include <analyze.h>
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -120,6 +121,23 @@ TEST_CASE("Test unused assignments analyzer", "[analyzer]") {
                  )",
                  "y = z\n"
                  "z = x\n"
+             },
+             {
+                 R"(x=1 x = x + 1)",
+                 "x = x + 1\n"
+             },
+             {
+                 R"(
+                    x = 0
+                    while x < 10
+                        y = x
+                        while y > 0
+                            y = y - 1
+                        end
+                        x = x + 1
+                    end
+                 )",
+                 ""
              }
         }));
 
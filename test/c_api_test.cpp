@@ -0,0 +1,138 @@
+#include <catch2/catch.hpp>
+
+#include <simple_parser.h>
+#include <analyze.h>
+#include <def_use.h>
+#include <format.h>
+#include <optimize.h>
+#include <pretty_print.h>
+#include <transform.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+// This TU includes the headers which are also compiled into the library, linking checks they are ODR-safe
+
+namespace {
+
+    struct session_deleter {
+        void operator()(sp_session * s) const {
+            sp_session_destroy(s);
+        }
+    };
+
+    struct tree_deleter {
+        void operator()(sp_tree * t) const {
+            sp_tree_destroy(t);
+        }
+    };
+
+    using session_ptr = std::unique_ptr<sp_session, session_deleter>;
+    using tree_ptr = std::unique_ptr<sp_tree, tree_deleter>;
+
+}
+
+TEST_CASE("C API tree matches the C++ tree", "[c_api]") {
+    std::string input = "x = 1\n"
+                        "while x < 10\n"
+                        "    y = x * 2\n"
+                        "    x = x + 1\n"
+                        "end\n";
+
+    session_ptr session(sp_session_create());
+    REQUIRE(session);
+
+    sp_tree * raw = nullptr;
+    REQUIRE(sp_parse(session.get(), input.data(), input.size(), &raw, nullptr) == SP_OK);
+    tree_ptr tree(raw);
+
+    auto expected = std::get<parser::ast::tree>(parser::parse(input));
+    REQUIRE(sp_tree_size(tree.get()) == expected.size());
+    REQUIRE(sp_tree_root(tree.get()) == expected.get_root());
+
+    std::vector<sp_node> nodes(sp_tree_size(tree.get()));
+    size_t count = 0;
+    REQUIRE(sp_tree_nodes(tree.get(), nodes.data(), nodes.size(), &count) == SP_OK);
+    REQUIRE(count == nodes.size());
+
+    for (uint16_t idx = 0; idx < count; ++idx) {
+        CAPTURE(idx);
+        REQUIRE(nodes[idx].kind == static_cast<uint8_t>(expected.get_kind(idx)));
+        REQUIRE(nodes[idx].op == static_cast<uint8_t>(expected.get_operator_type(idx)));
+        REQUIRE(nodes[idx].left == expected.get_left(idx));
+        REQUIRE(nodes[idx].right == expected.get_right(idx));
+        REQUIRE(nodes[idx].parent == expected.get_parent(idx));
+        REQUIRE(std::make_pair(nodes[idx].begin, nodes[idx].end) == expected.get_range(idx));
+    }
+
+    std::vector<uint16_t> unused(4);
+    REQUIRE(sp_find_unused_assignments(session.get(), tree.get(), unused.data(), unused.size(), &count) == SP_OK);
+    unused.resize(count);
+
+    auto expected_unused = find_unused_assignments(expected, input);
+    REQUIRE(std::vector<uint16_t>(expected_unused.begin(), expected_unused.end()) == unused);
+    REQUIRE(count == 1); // y = x * 2
+}
+
+TEST_CASE("C API reports the required size of small buffers", "[c_api]") {
+    std::string input = "a = 1 b = 2 c = 3";
+    session_ptr session(sp_session_create());
+
+    size_t count = 0;
+    REQUIRE(sp_analyze(session.get(), input.data(), input.size(), nullptr, 0, &count, nullptr) == SP_BUFFER_TOO_SMALL);
+    REQUIRE(count == 3);
+
+    std::vector<uint32_t> ranges(2);
+    REQUIRE(sp_analyze(session.get(), input.data(), input.size(), ranges.data(), 1, &count, nullptr) == SP_BUFFER_TOO_SMALL);
+    REQUIRE(count == 3);
+
+    ranges.resize(2 * count);
+    REQUIRE(sp_analyze(session.get(), input.data(), input.size(), ranges.data(), count, &count, nullptr) == SP_OK);
+
+    std::vector<std::string_view> texts;
+    for (size_t idx = 0; idx < count; ++idx) {
+        texts.push_back(std::string_view(input).substr(ranges[2 * idx], ranges[2 * idx + 1] - ranges[2 * idx]));
+    }
+    std::sort(texts.begin(), texts.end());
+    REQUIRE(texts == std::vector<std::string_view>{"a = 1", "b = 2", "c = 3"});
+
+    sp_stats stats;
+    sp_session_stats(session.get(), &stats);
+    REQUIRE(stats.sources == 3);
+    REQUIRE(stats.bytes == 3 * input.size());
+}
+
+TEST_CASE("C API syntax errors", "[c_api]") {
+    std::string input = "x = 1\n"
+                        "y = (2\n";
+    session_ptr session(sp_session_create());
+
+    sp_tree * tree = reinterpret_cast<sp_tree *>(&input); // must be reset
+    sp_error error{};
+    REQUIRE(sp_parse(session.get(), input.data(), input.size(), &tree, &error) == SP_SYNTAX_ERROR);
+    REQUIRE(tree == nullptr);
+    REQUIRE(std::string(error.cause) == "UNCLOSED_PARENTHESIS");
+    REQUIRE(error.line == 3);
+    REQUIRE(error.column == 1);
+
+    size_t count = 0;
+    REQUIRE(sp_analyze(session.get(), input.data(), input.size(), nullptr, 0, &count, nullptr) == SP_SYNTAX_ERROR);
+}
+
+TEST_CASE("C API argument checks", "[c_api]") {
+    session_ptr session(sp_session_create());
+    sp_tree * tree = nullptr;
+    size_t count = 0;
+
+    REQUIRE(sp_parse(nullptr, "x=1", 3, &tree, nullptr) == SP_INVALID_ARGUMENT);
+    REQUIRE(sp_parse(session.get(), nullptr, 3, &tree, nullptr) == SP_INVALID_ARGUMENT);
+    REQUIRE(sp_parse(session.get(), "x=1", 3, nullptr, nullptr) == SP_INVALID_ARGUMENT);
+    REQUIRE(sp_tree_nodes(nullptr, nullptr, 0, &count) == SP_INVALID_ARGUMENT);
+    REQUIRE(sp_analyze(session.get(), "x=1", 3, nullptr, 1, &count, nullptr) == SP_INVALID_ARGUMENT);
+
+    REQUIRE(sp_tree_size(nullptr) == 0);
+    REQUIRE(sp_tree_root(nullptr) == SP_NPOS);
+    REQUIRE(std::string(sp_status_string(SP_BUFFER_TOO_SMALL)) == "buffer too small");
+    REQUIRE(sp_api_version() == SP_API_VERSION);
+}
@@ -0,0 +1,52 @@
+#include <catch2/catch.hpp>
+
+#include <compile_time.h>
+#include <pretty_print.h>
+#include <string>
+
+namespace {
+
+    constexpr auto program = parser::parse_ct<"x = 1\n"
+                                              "while x < 10\n"
+                                              "    x = x + (y * 2)\n"
+                                              "end\n"
+                                              "y = x\n">();
+
+    static_assert(program.size() == 19);
+    static_assert(program.get_kind(program.get_root()) == parser::ast::kind::STATEMENTS);
+    static_assert(program.get_string(program.get_root()).starts_with("x = 1"));
+    static_assert(program.get_parent(program.get_root()) == parser::ast::tree::npos);
+
+    static_assert(no_unused_assignments("n = 10 s = 0 while n > 0 s = s + n n = n - 1 end"));
+    static_assert(no_unused_assignments("i = 0 while i < 10 i = i + 1 end"));
+    static_assert(!no_unused_assignments("x = 1 x = 2 y = x"));
+    static_assert(!no_unused_assignments("x = x + 1"));
+    static_assert(!no_unused_assignments("x = (1"));
+    static_assert(find_unused_assignments(std::get<parser::ast::tree>(parser::parse("a = 1 a = 2")), "a = 1 a = 2").size() == 2);
+
+}
+
+TEST_CASE("Compile-time tree matches the runtime parse", "[compile_time]") {
+    auto expected = std::get<parser::ast::tree>(parser::parse(program.source()));
+    auto tree = program.to_tree();
+    REQUIRE(tree.size() == expected.size());
+    REQUIRE(tree.get_root() == expected.get_root());
+    for (uint16_t idx = 0; idx < tree.size(); ++idx) {
+        REQUIRE(tree.get_kind(idx) == expected.get_kind(idx));
+        REQUIRE(tree.get_left(idx) == expected.get_left(idx));
+        REQUIRE(tree.get_right(idx) == expected.get_right(idx));
+        REQUIRE(tree.get_parent(idx) == expected.get_parent(idx));
+        REQUIRE(tree.get_range(idx) == expected.get_range(idx));
+        REQUIRE(tree.get_operator_type(idx) == expected.get_operator_type(idx));
+    }
+
+    std::string printed, reference;
+    printer::print_json(printed, tree);
+    printer::print_json(reference, expected);
+    REQUIRE(printed == reference);
+
+    auto unused = find_unused_assignments(tree, program.source());
+    REQUIRE(unused.size() == 1);
+    REQUIRE(program.get_string(unused[0]) == "y = x");
+    REQUIRE(!no_unused_assignments(program.source()));
+}
@@ -0,0 +1,139 @@
+#include <catch2/catch.hpp>
+
+#include <def_use.h>
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+std::string build_and_dump(std::string_view str) {
+    auto tree = std::get<parser::ast::tree>(parser::parse(str));
+    auto chains = dataflow::build_def_use_chains(tree, str);
+
+    std::vector<uint16_t> uses;
+    for (uint16_t idx = 0; idx < tree.size(); ++idx) {
+        bool is_target = tree.have_parent(idx)
+                         && tree.get_kind(tree.get_parent(idx)) == parser::ast::kind::ASSIGNMENT
+                         && tree.get_left(tree.get_parent(idx)) == idx;
+        if (tree.get_kind(idx) == parser::ast::kind::VAR && !is_target) {
+            uses.push_back(idx);
+        }
+    }
+    std::sort(uses.begin(), uses.end(), [&](uint16_t l, uint16_t r) {
+        return tree.get_range(l).first < tree.get_range(r).first;
+    });
+
+    std::stringstream ss;
+    for (auto use : uses) {
+        ss << tree.get_string(use, str) << " <-";
+        for (auto def : chains.get_definitions(use)) {
+            ss << " [" << tree.get_string(def, str) << "]";
+
+            auto def_uses = chains.get_uses(def);
+            REQUIRE(std::find(def_uses.begin(), def_uses.end(), use) != def_uses.end());
+        }
+        ss << std::endl;
+    }
+    return ss.str();
+}
+
+TEST_CASE("Reaching definitions test", "[def_use]") {
+    std::string input, expected;
+
+    std::tie(input, expected) =
+        GENERATE(table<std::string, std::string>({
+             {
+                 R"(x=1 y=x x=y)",
+                 "x <- [x=1]\n"
+                 "y <- [y=x]\n"
+             },
+             {
+                 R"(y=x)",
+                 "x <-\n"
+             },
+             {
+                 R"(
+                    x = 1
+                    if w > 0
+                        x = 2
+                    end
+                    y = x
+                 )",
+                 "w <-\n"
+                 "x <- [x = 1] [x = 2]\n"
+             },
+             {
+                 R"(
+                    i = 0
+                    s = 0
+                    while i < 10
+                        s = s + i
+                        i = i + 1
+                    end
+                    r = s
+                 )",
+                 "i <- [i = 0] [i = i + 1]\n"
+                 "s <- [s = 0] [s = s + i]\n"
+                 "i <- [i = 0] [i = i + 1]\n"
+                 "i <- [i = 0] [i = i + 1]\n"
+                 "s <- [s = 0] [s = s + i]\n"
+             },
+             {
+                 R"(
+                    x = 1
+                    while a
+                        y = x
+                        while b
+                            if c
+                                x = 2
+                            end
+                            x = 3
+                        end
+                    end
+                    z = x
+                 )",
+                 "a <-\n"
+                 "x <- [x = 1] [x = 3]\n"
+                 "b <-\n"
+                 "c <-\n"
+                 "x <- [x = 1] [x = 3]\n"
+             },
+             {
+                 R"(
+                    x = 1
+                    if c
+                        x = 2
+                        y = x
+                    end
+                    z = (x)
+                 )",
+                 "c <-\n"
+                 "x <- [x = 2]\n"
+                 "(x) <- [x = 1] [x = 2]\n"
+             },
+        }));
+
+    CAPTURE(input);
+    REQUIRE(build_and_dump(input) == expected);
+}
+
+TEST_CASE("Uses of assignments", "[def_use]") {
+    std::string_view input = "x = 1 y = x + x x = 2 z = y";
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    auto chains = dataflow::build_def_use_chains(tree, input);
+
+    for (uint16_t idx = 0; idx < tree.size(); ++idx) {
+        if (tree.get_kind(idx) != parser::ast::kind::ASSIGNMENT) {
+            continue;
+        }
+        auto text = tree.get_string(idx, input);
+        auto uses = chains.get_uses(idx);
+        if (text == "x = 1") {
+            REQUIRE(uses.size() == 2);
+        } else if (text == "y = x + x") {
+            REQUIRE(uses.size() == 1);
+            REQUIRE(tree.get_string(uses[0], input) == "y");
+        } else {
+            REQUIRE(uses.empty());
+        }
+    }
+}
@@ -0,0 +1,133 @@
+#include <catch2/catch.hpp>
+
+#include <driver.h>
+#include <thread_pool.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    class temporary_directory {
+    public:
+        // unique, ctest may run the cases in parallel processes
+        temporary_directory() {
+            std::string pattern = (std::filesystem::temp_directory_path() / "simple_parser_driver_XXXXXX").string();
+            if (!::mkdtemp(pattern.data())) {
+                throw std::system_error(errno, std::generic_category(), "mkdtemp");
+            }
+            path_ = pattern;
+        }
+
+        ~temporary_directory() {
+            std::filesystem::remove_all(path_);
+        }
+
+        std::string write(std::string const & name, std::string const & contents) const {
+            auto file = path_ / name;
+            std::filesystem::create_directories(file.parent_path());
+            std::ofstream(file) << contents;
+            return file.string();
+        }
+
+        [[nodiscard]]
+        std::string path() const {
+            return path_.string();
+        }
+
+    private:
+        std::filesystem::path path_;
+    };
+
+}
+
+TEST_CASE("Work-stealing pool runs every task", "[driver]") {
+    concurrency::work_stealing_pool pool(4);
+    REQUIRE(pool.size() == 4);
+
+    std::vector<uint64_t> values(10000);
+    concurrency::parallel_for(pool, values.size(), [&](size_t idx) {
+        values[idx] = idx * idx;
+    });
+    for (size_t idx = 0; idx < values.size(); ++idx) {
+        REQUIRE(values[idx] == idx * idx);
+    }
+
+    // tasks spawning tasks land in the spawning worker's deque; the spawning worker stays busy until
+    // an idle one has stolen from there, so one worker is left without a parent of its own
+    // (assertions are for the test thread only, tasks count)
+    std::atomic<uint32_t> leaves = 0;
+    std::atomic<uint32_t> off_worker = 0;
+    std::atomic<uint32_t> stolen = 0;
+    for (int idx = 0; idx < 3; ++idx) {
+        pool.submit([&] {
+            auto parent = concurrency::work_stealing_pool::current_worker();
+            off_worker += parent < 0;
+            for (int child = 0; child < 100; ++child) {
+                pool.submit([&, parent] {
+                    stolen += concurrency::work_stealing_pool::current_worker() != parent;
+                    ++leaves;
+                });
+            }
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            while (stolen == 0 && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::yield();
+            }
+        });
+    }
+    pool.wait();
+    REQUIRE(off_worker == 0);
+    REQUIRE(leaves == 300);
+    REQUIRE(stolen > 0);
+    REQUIRE(concurrency::work_stealing_pool::current_worker() == -1);
+}
+
+TEST_CASE("Driver processes inputs in a deterministic order", "[driver]") {
+    temporary_directory dir;
+    auto b = dir.write("tree/b.sp", "x = 1\ny = 2\nx = y\n");
+    auto a = dir.write("tree/a.sp", "a = 1\n");
+    auto nested = dir.write("tree/sub/c.sp", "if a > 0\n    b = 1\n");
+    auto listed = dir.write("listed.sp", "z = 0\nz = z + 1\n");
+
+    std::istringstream list(listed + "\n\n" + dir.path() + "/missing.sp\n");
+    auto inputs = driver::collect_inputs({dir.path() + "/tree"}, &list);
+    REQUIRE(inputs == std::vector<std::string>{a, b, nested, listed, dir.path() + "/missing.sp"});
+
+    concurrency::work_stealing_pool pool(3);
+    auto results = driver::run(pool, inputs);
+    REQUIRE(results.size() == inputs.size());
+
+    std::string text;
+    for (size_t idx = 0; idx < inputs.size(); ++idx) {
+        driver::write_text(text, inputs[idx], results[idx]);
+    }
+    REQUIRE(text ==
+        a + ":1:1: unused assignment: a = 1\n" +
+        b + ":1:1: unused assignment: x = 1\n" +
+        b + ":3:1: unused assignment: x = y\n" +
+        nested + ":3:1: error: UNFINISHED_STATEMENT\n" +
+        listed + ":2:1: unused assignment: z = z + 1\n" +
+        dir.path() + "/missing.sp: error: No such file or directory\n");
+
+    std::string json;
+    driver::write_json(json, "x\"y.sp", results[1]);
+    REQUIRE(json ==
+        R"({"file":"x\"y.sp","error":null,"unused":[{"line":1,"column":1,"text":"x = 1"},)"
+        R"({"line":3,"column":1,"text":"x = y"}]})" "\n");
+
+    auto summary = driver::summarize(results, std::chrono::milliseconds(1));
+    REQUIRE(summary.files == 5);
+    REQUIRE(summary.failed == 2);
+    REQUIRE(summary.unused == 4);
+    REQUIRE(summary.bytes == std::filesystem::file_size(a) + std::filesystem::file_size(b)
+                             + std::filesystem::file_size(nested) + std::filesystem::file_size(listed));
+}
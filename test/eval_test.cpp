@@ -0,0 +1,89 @@
+#include <catch2/catch.hpp>
+
+#include <eval.h>
+#include <limits>
+#include <random>
+#include <string>
+
+namespace {
+
+    eval::program compile(std::string_view input) {
+        return eval::compile(std::get<parser::ast::tree>(parser::parse(input)), input);
+    }
+
+    // final value of `name` when the program starts from `initial` values by name
+    eval::value run(std::string_view input, std::string_view name, std::vector<std::pair<std::string_view, eval::value>> initial = {}) {
+        auto p = compile(input);
+        std::vector<eval::value> variables(p.variable_count());
+        for (auto [var, v] : initial) {
+            variables[p.find_variable(var)] = v;
+        }
+        REQUIRE(eval::run(p, variables));
+        return variables[p.find_variable(name)];
+    }
+
+}
+
+TEST_CASE("Scalar evaluation test", "[eval]") {
+    constexpr auto MIN = std::numeric_limits<eval::value>::min();
+
+    REQUIRE(run("x = 1 + 2 * 3", "x") == 7);
+    REQUIRE(run("x = 7 / 0", "x") == 0);
+    REQUIRE(run("x = -7 / 2", "x") == -3);
+    REQUIRE(run("x = 9223372036854775807 + 1", "x") == MIN);
+    REQUIRE(run("y = x / -1", "y", {{"x", MIN}}) == MIN);
+    REQUIRE(run("x = (3 < 4) + (2 && 0) * 10 + (0 || 5) * 100 + (4 >= 4) * 1000", "x") == 1101);
+    REQUIRE(run("x = -(-a)", "x", {{"a", 5}}) == 5);
+    REQUIRE(run("r = 1 while n > 0 r = r * n n = n - 1 end", "r", {{"n", 10}}) == 3628800);
+    REQUIRE(run("if a > 0 x = 1 end if a <= 0 x = 2 end", "x", {{"a", -3}}) == 2);
+    REQUIRE(run("x = 5 y = x", "y") == 5);
+}
+
+TEST_CASE("Evaluation stops after the test budget", "[eval]") {
+    auto p = compile("while 1 x = x + 1 end");
+    std::vector<eval::value> variables(p.variable_count());
+    REQUIRE_FALSE(eval::run(p, variables, 100));
+    REQUIRE(variables[p.find_variable("x")] == 100);
+
+    eval::table t(p, 10);
+    REQUIRE_FALSE(eval::run(p, t, 100));
+}
+
+TEST_CASE("Batch evaluation agrees with scalar evaluation", "[eval]") {
+    std::string input = GENERATE(as<std::string>{},
+        "x = a * b - c / (a - b) y = -x + (a < b) * 3",
+        "s = 0 while n > 1 if n - n / 2 * 2 == 1 n = 3 * n + 1 end if n - n / 2 * 2 == 0 n = n / 2 end s = s + 1 end",
+        "r = 1 while k > 0 if k > 5 && r < 1000 r = r * k end k = k - 1 r = r + (k || a) end",
+        "while a < b a = a + 1 if a == c while c > 0 c = c - 2 end end end d = a != b || c >= 0"
+    );
+    auto target = GENERATE(eval::isa::GENERIC, eval::isa::AVX2, eval::isa::AVX512);
+    if (!eval::is_supported(target)) {
+        return;
+    }
+    CAPTURE(input, target);
+
+    auto p = compile(input);
+    constexpr size_t ROWS = 1003; // a partial group of lanes at the end
+    eval::table batch(p, ROWS);
+    std::mt19937 random(42);
+    std::uniform_int_distribution<eval::value> values(-20, 60);
+    for (uint32_t var = 0; var < p.variable_count(); ++var) {
+        for (auto & v : batch.column(var)) {
+            v = values(random);
+        }
+    }
+    auto scalar = batch;
+
+    REQUIRE(eval::run(p, batch, eval::DEFAULT_MAX_TESTS, target));
+    std::vector<eval::value> variables(p.variable_count());
+    for (size_t row = 0; row < ROWS; ++row) {
+        for (uint32_t var = 0; var < p.variable_count(); ++var) {
+            variables[var] = scalar.column(var)[row];
+        }
+        REQUIRE(eval::run(p, variables));
+        for (uint32_t var = 0; var < p.variable_count(); ++var) {
+            CAPTURE(row, p.variable_name(var));
+            REQUIRE(batch.column(var)[row] == variables[var]);
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#include <catch2/catch.hpp>
+
+#include <format.h>
+#include <string>
+
+std::string parse_and_format(std::string_view str) {
+    auto parsed = parser::parse(str);
+    REQUIRE(std::holds_alternative<parser::ast::tree>(parsed));
+    return formatter::format(std::get<parser::ast::tree>(parsed), str);
+}
+
+TEST_CASE("Formatter test", "[format]") {
+    std::string input, expected;
+
+    std::tie(input, expected) =
+        GENERATE(table<std::string, std::string>({
+             {"x=y",                            "x = y\n"},
+             {"x   =y+1 y=   z",                "x = y + 1\ny = z\n"},
+             {"x = (y)",                        "x = y\n"},
+             {"x = a - b - c",                  "x = a - b - c\n"},
+             {"x = a - (b - c)",                "x = a - (b - c)\n"},
+             {"x = (a + b) * c",                "x = (a + b) * c\n"},
+             {"x = a + (b * c)",                "x = a + b * c\n"},
+             {"x = a * b + c",                  "x = a * b + c\n"},
+             {"x = (a < b) + (c > d)",          "x = (a < b) + (c > d)\n"},
+             {"x = a<=b&&c==d||-e",             "x = a <= b && c == d || -e\n"},
+             {"x = a || (b || c)",              "x = a || (b || c)\n"},
+             {"x = - ( - a) - -(b*c)",          "x = --a - -(b * c)\n"},
+             {"x = ((a))",                      "x = a\n"},
+             {"if x>0 y=1 end",                 "if x > 0\n    y = 1\nend\n"},
+             {
+                 "while (i < 10) if (i > 5) x = i end i = i + 1 end",
+                 "while i < 10\n"
+                 "    if i > 5\n"
+                 "        x = i\n"
+                 "    end\n"
+                 "    i = i + 1\n"
+                 "end\n"
+             },
+        }));
+
+    CAPTURE(input);
+    auto formatted = parse_and_format(input);
+    REQUIRE(formatted == expected);
+    REQUIRE(parse_and_format(formatted) == formatted);
+}
+
+TEST_CASE("Formatter preserves tree shape", "[format]") {
+    std::string input = R"(
+    x = 1
+    z = x * (y + z) < 12000
+    while x > 0
+        if y > 3 x = x + 1 end
+        if y < 3 y = y + 1 end
+        z = z / 2
+        unused = x * 123 + z * 125 - (a - b) / (c / d)
+        flag = -x >= 0 && (y != z || z == -(a <= b))
+    end
+    )";
+
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    auto formatted = formatter::format(tree, input);
+    auto reparsed = std::get<parser::ast::tree>(parser::parse(formatted));
+
+    REQUIRE(reparsed.size() == tree.size());
+    for (uint16_t idx = 0; idx < tree.size(); ++idx) {
+        REQUIRE(reparsed.get_kind(idx) == tree.get_kind(idx));
+        REQUIRE(reparsed.get_operator_type(idx) == tree.get_operator_type(idx));
+        REQUIRE(reparsed.get_left(idx) == tree.get_left(idx));
+        REQUIRE(reparsed.get_right(idx) == tree.get_right(idx));
+    }
+    REQUIRE(formatter::format(reparsed, formatted) == formatted);
+}
@@ -0,0 +1,105 @@
+#include <catch2/catch.hpp>
+
+#include <hash_cons.h>
+#include <pretty_print.h>
+#include <sstream>
+#include <string>
+
+namespace {
+
+    std::string dump(parser::ast::tree const & tree, std::string_view sv) {
+        std::stringstream ss;
+        printer::print(ss, tree, sv);
+        return ss.str();
+    }
+
+    // statement `idx` of a right-nested statement list
+    uint16_t statement(parser::ast::tree const & tree, uint32_t idx) {
+        auto node = tree.get_root();
+        for (; idx > 0; --idx) {
+            node = tree.get_right(node);
+        }
+        return tree.get_kind(node) == parser::ast::kind::STATEMENTS ? tree.get_left(node) : node;
+    }
+
+}
+
+TEST_CASE("Structural hashes test", "[hash_cons]") {
+    std::string input = "x = a + b y = (a + b) z = a - b t = b + a u = (a) + b";
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    auto hashes = parser::ast::structural_hashes(tree, input);
+
+    auto value = [&](uint32_t idx) {
+        return hashes[tree.get_right(statement(tree, idx))];
+    };
+    REQUIRE(value(0) == value(1));
+    REQUIRE(value(0) == value(4));
+    REQUIRE(value(0) != value(2));
+    REQUIRE(value(0) != value(3));
+
+    // every VAR `a` hashes alike, whatever its position
+    auto target_x = tree.get_left(statement(tree, 0));
+    auto target_y = tree.get_left(statement(tree, 1));
+    REQUIRE(hashes[target_x] != hashes[target_y]);
+}
+
+TEST_CASE("Hash consing shares expressions test", "[hash_cons]") {
+    std::string input = "i = i + 1\nwhile i < 100 i = i + 1 x = (i + 1) * 2 end\ni = i + 1";
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    auto consed = parser::ast::hash_cons(tree, input);
+
+    REQUIRE(consed.occurrences() == tree.size());
+    REQUIRE(consed.size() < tree.size());
+
+    // `i`, `1`, `i + 1`, `100`, `i < 100`, `x`, `2`, `(i + 1) * 2` are stored once
+    uint32_t expressions = 0;
+    for (uint16_t id = 0; id < consed.size(); ++id) {
+        auto k = consed.get_kind(id);
+        expressions += k == parser::ast::kind::VAR || k == parser::ast::kind::CONST
+                       || k == parser::ast::kind::BINOP || k == parser::ast::kind::UNOP;
+    }
+    REQUIRE(expressions == 8);
+
+    // the same id means the same expression
+    auto first = consed.get_right(consed.get_left(consed.get_root()));
+    REQUIRE(consed.get_kind(first) == parser::ast::kind::BINOP);
+    REQUIRE(consed.get_symbol(consed.get_left(first), input) == "i");
+    REQUIRE(consed.get_symbol(consed.get_right(first), input) == "1");
+}
+
+TEST_CASE("Hash consing keeps occurrence ranges test", "[hash_cons]") {
+    std::string input = GENERATE(as<std::string>{},
+        "x = 1",
+        "x = -(a + b) * -(a + b)",
+        "a = (b) b = ((b)) c = b + b",
+        "if a < b x = 1 y = 2 end z = x + y",
+        "while x > 0 if y x = x - 1 end while z z = z - 1 end end t = x");
+    CAPTURE(input);
+
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    auto consed = parser::ast::hash_cons(tree, input);
+
+    uint32_t occurrence = 0;
+    for (auto node : parser::ast::preorder(tree)) {
+        REQUIRE(consed.get_range(occurrence++) == tree.get_range(node));
+    }
+
+    REQUIRE(dump(consed.to_tree(), input) == dump(tree, input));
+}
+
+TEST_CASE("Hash consing of generated programs test", "[hash_cons]") {
+    std::string input;
+    for (int idx = 0; idx < 500; ++idx) {
+        input += "i = i + 1 while (i < 100) if i > 5 x = (x - 1) / 2 end i = i + 1 end\n";
+    }
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    auto consed = parser::ast::hash_cons(tree, input);
+
+    REQUIRE(consed.size() < tree.size() / 2);
+    REQUIRE(consed.memory_usage() < tree.memory_usage());
+    REQUIRE(dump(consed.to_tree(), input) == dump(tree, input));
+
+    parser::ast::tree empty;
+    REQUIRE(parser::ast::hash_cons(empty, "").empty());
+    REQUIRE(parser::ast::hash_cons(empty, "").to_tree().empty());
+}
@@ -0,0 +1,90 @@
+#include <catch2/catch.hpp>
+
+#include <layout.h>
+#include <analyze.h>
+#include <pretty_print.h>
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+namespace {
+
+    std::string dump(parser::ast::tree const & tree, std::string_view sv) {
+        std::stringstream ss;
+        printer::print(ss, tree, sv);
+        return ss.str();
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> unused_ranges(parser::ast::tree const & tree, std::string_view sv) {
+        std::vector<std::pair<uint32_t, uint32_t>> result;
+        for (auto idx : find_unused_assignments(tree, sv)) {
+            result.push_back(tree.get_range(idx));
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+}
+
+TEST_CASE("Relayout keeps the tree", "[layout]") {
+    std::string input = GENERATE(as<std::string>{},
+        "x = 1",
+        "x = -a - (-b) y = x",
+        "a=b+(c*d)-e  while (a<10) if a>5 b=(b-1)/2 end a=a+1 end",
+        "while a if b while c x = x + 1 end end y = x end z = (a + b) * (c + d) - (e + f) * (g + h)"
+    );
+    auto order = GENERATE(parser::ast::layout::PREORDER, parser::ast::layout::VAN_EMDE_BOAS);
+    CAPTURE(input, order);
+
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    auto relaid = parser::ast::relayout(tree, order);
+
+    REQUIRE(relaid.size() == tree.size());
+    REQUIRE(relaid.get_root() == 0);
+    REQUIRE(dump(relaid, input) == dump(tree, input));
+    REQUIRE(unused_ranges(relaid, input) == unused_ranges(tree, input));
+
+    std::string binary, relaid_binary;
+    printer::print_binary(binary, tree);
+    printer::print_binary(relaid_binary, relaid);
+    REQUIRE(relaid_binary == binary);
+
+    for (uint16_t node = 0; node < relaid.size(); ++node) {
+        for (auto child : parser::ast::children(relaid, node)) {
+            REQUIRE(relaid.get_parent(child) == node);
+        }
+    }
+}
+
+TEST_CASE("Preorder layout numbers nodes in visiting order", "[layout]") {
+    std::string input;
+    for (int i = 0; i < 500; ++i) {
+        input.append("a=b+(c*d)-e while (a<10) if a>5 b=(b-1)/2 end a=a+1 end\n");
+    }
+    auto tree = parser::ast::relayout(std::get<parser::ast::tree>(parser::parse(input)));
+
+    uint16_t expected = 0;
+    for (auto node : parser::ast::preorder(tree)) {
+        REQUIRE(node == expected++);
+    }
+    REQUIRE(expected == tree.size());
+}
+
+TEST_CASE("Van Emde Boas layout puts the top levels first", "[layout]") {
+    // height 6: the top 3 levels (assignment, `x`, `<`, `-`, `i`) come before the products below `-`
+    std::string input = "x = (a + b) * (c + d) - (e + f) * (g + h) < i";
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+
+    auto blocked = parser::ast::relayout(tree, parser::ast::layout::VAN_EMDE_BOAS);
+    std::vector<std::string_view> order;
+    for (uint16_t node = 0; node < blocked.size(); ++node) {
+        order.push_back(blocked.get_string(node, input));
+    }
+    REQUIRE(order[1] == "x");
+    REQUIRE(order[4] == "i");
+    REQUIRE(order[5] == "(a + b) * (c + d)");
+    REQUIRE(order[6] == "(a + b)");
+
+    auto depth_first = parser::ast::relayout(tree);
+    REQUIRE(depth_first.get_string(depth_first.size() - 1, input) == "i");
+}
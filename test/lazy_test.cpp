@@ -0,0 +1,126 @@
+#include <catch2/catch.hpp>
+
+#include <lazy.h>
+#include <analyze.h>
+#include <algorithm>
+#include <set>
+#include <string>
+#include "program_generator.h"
+
+TEST_CASE("Lazy program skeleton test", "[lazy]") {
+    std::string input = "  x = (a + 1) * b\nwhile x < 10 if x x = x - 1 end y = x end\nz = y";
+    lazy::program program(input);
+
+    REQUIRE(program.size() == 6);
+    REQUIRE(program.top_level_size() == 3);
+    REQUIRE(program.materialized() == 0);
+
+    auto text = [&](uint32_t id) {
+        auto [start, end] = program.get_range(id);
+        return input.substr(start, end - start);
+    };
+    REQUIRE(text(0) == "x = (a + 1) * b");
+    REQUIRE(text(1) == "while x < 10 if x x = x - 1 end y = x end");
+    REQUIRE(text(2) == "if x x = x - 1 end");
+    REQUIRE(text(3) == "x = x - 1");
+    REQUIRE(text(4) == "y = x");
+    REQUIRE(text(5) == "z = y");
+
+    REQUIRE(program.get_kind(1) == parser::ast::kind::WHILE);
+    REQUIRE(program.get_kind(2) == parser::ast::kind::IF);
+    REQUIRE(program.get_parent(3) == 2);
+    REQUIRE(program.get_parent(4) == 1);
+    REQUIRE(program.get_first_child(1) == 2);
+    REQUIRE(program.get_first_child(0) == lazy::npos);
+    REQUIRE(program.get_next(2) == 4);
+    REQUIRE(program.get_next(1) == 5);
+    REQUIRE(program.get_top_level(2) == 5);
+
+    REQUIRE(program.find(0) == lazy::npos);
+    REQUIRE(program.find(input.find("- 1")) == 3);
+    REQUIRE(program.find(input.find("y = x")) == 4);
+    REQUIRE(program.find(input.find("end\nz")) == 1);
+
+    auto ref = std::get<lazy::node_ref>(program.materialize(4));
+    REQUIRE(ref.tree->get_string(ref.node, input) == "y = x");
+    REQUIRE(program.materialized() == 1);
+    std::get<lazy::node_ref>(program.materialize(3));
+    REQUIRE(program.materialized() == 1);
+}
+
+TEST_CASE("Lazy program reads end as a name before the first statement of a block", "[lazy]") {
+    std::string input = "while a end = b end\nc = end";
+    lazy::program program(input);
+
+    REQUIRE(program.size() == 3);
+    REQUIRE(program.get_range(0) == std::pair<uint32_t, uint32_t>(0, 19));
+    REQUIRE(program.get_range(1) == std::pair<uint32_t, uint32_t>(8, 15));
+    REQUIRE(program.get_parent(1) == 0);
+
+    auto ref = std::get<lazy::node_ref>(program.materialize(1));
+    REQUIRE(ref.tree->get_kind(ref.node) == parser::ast::kind::ASSIGNMENT);
+    REQUIRE(ref.tree->get_range(ref.node) == program.get_range(1));
+    REQUIRE(std::get<bool>(lazy::is_used(program, 1)));
+}
+
+TEST_CASE("Lazy queries agree with the whole program analysis", "[lazy]") {
+    auto seed = GENERATE(range(0u, 20u));
+    auto input = program_generator::generate(200, seed, {.variables = 5, .nested = true});
+
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    std::set<uint32_t> unused;
+    for (auto idx : find_unused_assignments(tree, input)) {
+        unused.insert(tree.get_range(idx).first);
+    }
+
+    lazy::program program(input);
+    uint32_t assignments = 0;
+    for (uint32_t id = 0; id < program.size(); ++id) {
+        if (program.get_kind(id) == parser::ast::kind::ASSIGNMENT) {
+            CAPTURE(seed, program.get_range(id).first);
+            REQUIRE(std::get<bool>(lazy::is_used(program, id)) == !unused.contains(program.get_range(id).first));
+            ++assignments;
+        }
+    }
+    REQUIRE(assignments == std::ranges::count_if(parser::ast::preorder(tree), [&](uint16_t node) {
+        return tree.get_kind(node) == parser::ast::kind::ASSIGNMENT;
+    }));
+}
+
+TEST_CASE("Lazy query touches only the statements it needs", "[lazy]") {
+    // more nodes than a single tree can hold
+    std::string input;
+    for (int i = 0; i < 20000; ++i) {
+        input.append("a = b + 1 while a < 10 a = a + 1 end b = a\n");
+    }
+    lazy::program program(input);
+    REQUIRE(program.top_level_size() == 60000);
+
+    auto middle = program.get_top_level(30000);
+    REQUIRE(std::get<bool>(lazy::is_used(program, middle)));
+    REQUIRE(program.materialized() == 2);
+
+    auto last = program.find(input.size() - 2);
+    REQUIRE(program.get_kind(last) == parser::ast::kind::ASSIGNMENT);
+    REQUIRE_FALSE(std::get<bool>(lazy::is_used(program, last)));
+    REQUIRE(program.materialized() == 3);
+}
+
+TEST_CASE("Lazy program errors test", "[lazy]") {
+    std::string input = GENERATE(as<std::string>{},
+        "x = 1 y = (2",
+        "x = 1 y = x +",
+        "x = 1 while x x = 2",
+        "x = 1 if y y = 2 end end",
+        "x = 1 y = a)",
+        "x = 1 y"
+    );
+    CAPTURE(input);
+    auto expected = std::get<lexer::error>(parser::parse(input));
+
+    lazy::program program(input);
+    auto result = lazy::is_used(program, 0);
+    REQUIRE(std::holds_alternative<lexer::error>(result));
+    REQUIRE(std::string(std::get<lexer::error>(result).cause) == expected.cause);
+    REQUIRE(std::get<lexer::error>(result).pos == expected.pos);
+}
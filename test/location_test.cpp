@@ -0,0 +1,67 @@
+#include <catch2/catch.hpp>
+
+#include <location.h>
+#include <analyze.h>
+#include <string>
+
+TEST_CASE("Line index test", "[location]") {
+    std::string input = "a = 1\n"
+                        "\n"
+                        "b = a\r\n"
+                        "   c = 100000000000000000000 + b\n"
+                        "d = c";
+
+    location::line_index index(input);
+
+    REQUIRE(index.line_count() == 5);
+    REQUIRE(index.get_position(0) == location::position{1, 1});
+    REQUIRE(index.get_position(5) == location::position{1, 6});
+    REQUIRE(index.get_position(6) == location::position{2, 1});
+    REQUIRE(index.get_position(7) == location::position{3, 1});
+    REQUIRE(index.get_position(17) == location::position{4, 4});
+    REQUIRE(index.get_position(input.size()) == location::position{5, 6});
+}
+
+TEST_CASE("Line index agrees with rescanning", "[location]") {
+    std::string input;
+    for (int i = 0; i < 200; ++i) {
+        input += std::string(i % 37, ' ') + "x = y" + std::string(i % 5, '\n');
+    }
+
+    location::line_index index(input);
+
+    location::position expected{1, 1};
+    for (uint32_t offset = 0; offset <= input.size(); ++offset) {
+        REQUIRE(index.get_position(offset) == expected);
+        if (offset < input.size() && input[offset] == '\n') {
+            expected = {expected.line + 1, 1};
+        } else {
+            ++expected.column;
+        }
+    }
+}
+
+TEST_CASE("Located errors and analyzer results", "[location]") {
+    std::string error_input = "\n"
+                              "if x > 0\n"
+                              "  y = (1\n";
+    auto parsed = parser::parse(error_input);
+    REQUIRE(std::holds_alternative<lexer::error>(parsed));
+
+    auto err = location::line_index(error_input).locate(std::get<lexer::error>(parsed));
+    REQUIRE(std::string(err.cause) == "UNFINISHED_STATEMENT");
+    REQUIRE(err.where == location::position{3, 3});
+
+    std::string input = "x = 1\n"
+                        "while x < 10\n"
+                        "    y = x\n"
+                        "    x = x + 1\n"
+                        "end\n";
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    auto located = location::line_index(input).locate(tree, find_unused_assignments(tree, input));
+
+    REQUIRE(located.size() == 1);
+    REQUIRE(tree.get_string(located[0].node, input) == "y = x");
+    REQUIRE(located[0].where.begin == location::position{3, 5});
+    REQUIRE(located[0].where.end == location::position{3, 10});
+}
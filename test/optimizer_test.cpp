@@ -0,0 +1,237 @@
+#include <catch2/catch.hpp>
+
+#include <optimize.h>
+#include <analyze.h>
+#include <string>
+
+void render(optimizer::folded_tree const & folded, std::string_view sv, uint16_t node, std::string & out) {
+    auto const & tree = folded.tree;
+    switch (tree.get_kind(node)) {
+        case parser::ast::kind::VAR:
+            out += tree.get_symbol(node, sv);
+            break;
+        case parser::ast::kind::CONST:
+            out += std::to_string(folded.constants[node]);
+            break;
+        case parser::ast::kind::BINOP: {
+            out += '(';
+            render(folded, sv, tree.get_left(node), out);
+            out += ' ';
+            out += lexer::find_operator(tree.get_operator_type(node))->symbol;
+            out += ' ';
+            render(folded, sv, tree.get_right(node), out);
+            out += ')';
+            break;
+        }
+        case parser::ast::kind::UNOP:
+            out += lexer::find_operator(tree.get_operator_type(node))->symbol;
+            render(folded, sv, tree.get_left(node), out);
+            break;
+        case parser::ast::kind::ASSIGNMENT:
+            render(folded, sv, tree.get_left(node), out);
+            out += " = ";
+            render(folded, sv, tree.get_right(node), out);
+            out += '\n';
+            break;
+        case parser::ast::kind::IF:
+        case parser::ast::kind::WHILE:
+            out += tree.get_kind(node) == parser::ast::kind::IF ? "if " : "while ";
+            render(folded, sv, tree.get_left(node), out);
+            out += '\n';
+            render(folded, sv, tree.get_right(node), out);
+            out += "end\n";
+            break;
+        case parser::ast::kind::STATEMENTS:
+            render(folded, sv, tree.get_left(node), out);
+            render(folded, sv, tree.get_right(node), out);
+            break;
+    }
+}
+
+std::string fold_and_render(std::string_view str) {
+    auto tree = std::get<parser::ast::tree>(parser::parse(str));
+    auto folded = optimizer::fold_constants(tree, str);
+    if (folded.tree.empty()) {
+        return "";
+    }
+    std::string out;
+    render(folded, str, folded.tree.get_root(), out);
+    return out;
+}
+
+TEST_CASE("Constant folding test", "[optimizer]") {
+    std::string input, expected;
+
+    std::tie(input, expected) =
+        GENERATE(table<std::string, std::string>({
+             {"x = 2 + 2 * 3",              "x = 8\n"},
+             {"x = (2 + 2) * 3",            "x = 12\n"},
+             {"x = (7 / 2) - 10",           "x = -7\n"},
+             {"x = 7 / 2 - 10",             "x = -7\n"},
+             {"x = 7 / (2 - 10)",           "x = 0\n"},
+             {"x = -3 * -(2 - 4)",          "x = -6\n"},
+             {"x = 2 <= 2 && 3 >= 4 || 1 != 0 == 1", "x = 1\n"},
+             {"x = y + -1",                 "x = (y + -1)\n"},
+             {"x = 1 / 0",                  "x = 0\n"},
+             {"x = (1 < 2) + (3 > 4)",      "x = 1\n"},
+             {"x = y + (2 * 3)",            "x = (y + 6)\n"},
+             {"x = 18446744073709551617",   "x = 1\n"},
+             {"x = 2 y = x * x z = y + w",  "x = 2\ny = 4\nz = (4 + w)\n"},
+             {"x = 2 x = w y = x",          "x = 2\nx = w\ny = x\n"},
+             {"x = (5) * 2",                "x = 10\n"},
+             {"x = ( 7 )",                  "x = 7\n"},
+             {"x = 3 y = (x) + 1",          "x = 3\ny = 4\n"},
+             {"y = ( w ) + 1",              "y = (w + 1)\n"},
+        }));
+
+    CAPTURE(input);
+    REQUIRE(fold_and_render(input) == expected);
+}
+
+TEST_CASE("Dead branch elimination test", "[optimizer]") {
+    std::string input, expected;
+
+    std::tie(input, expected) =
+        GENERATE(table<std::string, std::string>({
+             {
+                 R"(
+                    x = 0
+                    if x > 0
+                        y = 1
+                    end
+                    z = x
+                 )",
+                 "x = 0\n"
+                 "z = 0\n"
+             },
+             {
+                 R"(
+                    x = 1
+                    if x > 0
+                        y = 1
+                    end
+                    z = y
+                 )",
+                 "x = 1\n"
+                 "y = 1\n"
+                 "z = 1\n"
+             },
+             {
+                 R"(
+                    x = 1
+                    if w
+                        x = 2
+                        y = 3
+                    end
+                    z = x + y
+                 )",
+                 "x = 1\n"
+                 "if w\n"
+                 "x = 2\n"
+                 "y = 3\n"
+                 "end\n"
+                 "z = (x + y)\n"
+             },
+             {
+                 R"(
+                    x = 1
+                    if w
+                        x = 1
+                    end
+                    z = x
+                 )",
+                 "x = 1\n"
+                 "if w\n"
+                 "x = 1\n"
+                 "end\n"
+                 "z = 1\n"
+             },
+             {
+                 R"(
+                    n = 10
+                    while 0 < 1 - 1
+                        n = n - 1
+                    end
+                    r = n
+                 )",
+                 "n = 10\n"
+                 "r = 10\n"
+             },
+             {
+                 R"(
+                    i = 0
+                    k = 5
+                    while i < k
+                        i = i + 1
+                        j = 2 * i
+                        t = j
+                    end
+                    r = i + k
+                 )",
+                 "i = 0\n"
+                 "k = 5\n"
+                 "while (i < 5)\n"
+                 "i = (i + 1)\n"
+                 "j = (2 * i)\n"
+                 "t = j\n"
+                 "end\n"
+                 "r = (i + 5)\n"
+             },
+             {
+                 R"(
+                    if w
+                        if 0
+                            x = 1
+                        end
+                    end
+                    y = 2
+                 )",
+                 "y = 2\n"
+             },
+             {
+                 R"(
+                    while w
+                        if 0
+                            x = 1
+                        end
+                    end
+                 )",
+                 "while w\n"
+                 "if 0\n"
+                 "x = 1\n"
+                 "end\n"
+                 "end\n"
+             },
+             {
+                 "if 2 < 1 x = 1 end",
+                 ""
+             },
+        }));
+
+    CAPTURE(input);
+    REQUIRE(fold_and_render(input) == expected);
+}
+
+TEST_CASE("Folded tree is compact and analyzable", "[optimizer]") {
+    std::string_view input = R"(
+        x = 2 + 3
+        if x < 2
+            y = x * 100
+        end
+        z = x
+    )";
+
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    auto folded = optimizer::fold_constants(tree, input);
+
+    REQUIRE(folded.tree.size() == 7);
+    REQUIRE(folded.constants.size() == folded.tree.size());
+    for (uint16_t idx = 0; idx < folded.tree.size(); ++idx) {
+        if (idx != folded.tree.get_root()) {
+            REQUIRE(folded.tree.have_parent(idx));
+        }
+    }
+
+    auto unused = find_unused_assignments(folded.tree, input);
+    REQUIRE(unused.size() == 2);
+}
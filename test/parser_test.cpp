@@ -3,6 +3,7 @@
 #include <pretty_print.h>
 #include <lexer.h>
 #include <sstream>
+#include <algorithm>
 
 std::string parse_and_dump(std::string const & s) {
     std::stringstream ss;
@@ -101,23 +102,23 @@ TEST_CASE ("Parser simple test", "[parser]") {
                                                           ""},
              {"x = a+b*c",                                "{ ASSIGNMENT [0..9] 'x = a+b*c'\n"
                                                           "   { VAR [0..1] 'x'}\n"
-                                                          "   { BINOP MULTIPLICATION [4..9] 'a+b*c'\n"
-                                                          "      { BINOP PLUS [4..7] 'a+b'\n"
-                                                          "         { VAR [4..5] 'a'}\n"
+                                                          "   { BINOP PLUS [4..9] 'a+b*c'\n"
+                                                          "      { VAR [4..5] 'a'}\n"
+                                                          "      { BINOP MULTIPLICATION [6..9] 'b*c'\n"
                                                           "         { VAR [6..7] 'b'}\n"
+                                                          "         { VAR [8..9] 'c'}\n"
                                                           "      }\n"
-                                                          "      { VAR [8..9] 'c'}\n"
                                                           "   }\n"
                                                           "}\n"
                                                           ""},
              {"x = a*b+c",                                "{ ASSIGNMENT [0..9] 'x = a*b+c'\n"
                                                           "   { VAR [0..1] 'x'}\n"
-                                                          "   { BINOP MULTIPLICATION [4..9] 'a*b+c'\n"
-                                                          "      { VAR [4..5] 'a'}\n"
-                                                          "      { BINOP PLUS [6..9] 'b+c'\n"
+                                                          "   { BINOP PLUS [4..9] 'a*b+c'\n"
+                                                          "      { BINOP MULTIPLICATION [4..7] 'a*b'\n"
+                                                          "         { VAR [4..5] 'a'}\n"
                                                           "         { VAR [6..7] 'b'}\n"
-                                                          "         { VAR [8..9] 'c'}\n"
                                                           "      }\n"
+                                                          "      { VAR [8..9] 'c'}\n"
                                                           "   }\n"
                                                           "}\n"
                                                           ""},
@@ -151,6 +152,49 @@ TEST_CASE ("Parser simple test", "[parser]") {
                                                           "   }\n"
                                                           "}\n"
                                                           ""},
+             {"x = -a - (-b)",                            "{ ASSIGNMENT [0..13] 'x = -a - (-b)'\n"
+                                                          "   { VAR [0..1] 'x'}\n"
+                                                          "   { BINOP MINUS [4..13] '-a - (-b)'\n"
+                                                          "      { UNOP NEGATION [4..6] '-a'\n"
+                                                          "         { VAR [5..6] 'a'}\n"
+                                                          "      }\n"
+                                                          "      { UNOP NEGATION [9..13] '(-b)'\n"
+                                                          "         { VAR [11..12] 'b'}\n"
+                                                          "      }\n"
+                                                          "   }\n"
+                                                          "}\n"
+                                                          ""},
+             {"x = a <= b && c != d || e == 0",           "{ ASSIGNMENT [0..30] 'x = a <= b && c != d || e == 0'\n"
+                                                          "   { VAR [0..1] 'x'}\n"
+                                                          "   { BINOP OR [4..30] 'a <= b && c != d || e == 0'\n"
+                                                          "      { BINOP AND [4..20] 'a <= b && c != d'\n"
+                                                          "         { BINOP LESS_EQUAL [4..10] 'a <= b'\n"
+                                                          "            { VAR [4..5] 'a'}\n"
+                                                          "            { VAR [9..10] 'b'}\n"
+                                                          "         }\n"
+                                                          "         { BINOP NOT_EQUAL [14..20] 'c != d'\n"
+                                                          "            { VAR [14..15] 'c'}\n"
+                                                          "            { VAR [19..20] 'd'}\n"
+                                                          "         }\n"
+                                                          "      }\n"
+                                                          "      { BINOP EQUAL [24..30] 'e == 0'\n"
+                                                          "         { VAR [24..25] 'e'}\n"
+                                                          "         { CONST [29..30] '0'}\n"
+                                                          "      }\n"
+                                                          "   }\n"
+                                                          "}\n"
+                                                          ""},
+             {"x = ( y + z ) * 2",                        "{ ASSIGNMENT [0..17] 'x = ( y + z ) * 2'\n"
+                                                          "   { VAR [0..1] 'x'}\n"
+                                                          "   { BINOP MULTIPLICATION [4..17] '( y + z ) * 2'\n"
+                                                          "      { BINOP PLUS [4..13] '( y + z )'\n"
+                                                          "         { VAR [6..7] 'y'}\n"
+                                                          "         { VAR [10..11] 'z'}\n"
+                                                          "      }\n"
+                                                          "      { CONST [16..17] '2'}\n"
+                                                          "   }\n"
+                                                          "}\n"
+                                                          ""},
              {"if x > 0 x = 0 end",                       "{ IF [0..18] 'if x > 0 x = 0 end'\n"
                                                           "   { BINOP GREATER [3..8] 'x > 0'\n"
                                                           "      { VAR [3..4] 'x'}\n"
@@ -303,15 +347,15 @@ end'
         z = 15
     end
 end'
-            { BINOP MULTIPLICATION [29..48] 'x * (y + z) < 12000'
-               { VAR [29..30] 'x'}
-               { BINOP LESS [33..48] '(y + z) < 12000'
+            { BINOP LESS [29..48] 'x * (y + z) < 12000'
+               { BINOP MULTIPLICATION [29..40] 'x * (y + z)'
+                  { VAR [29..30] 'x'}
                   { BINOP PLUS [33..40] '(y + z)'
                      { VAR [34..35] 'y'}
                      { VAR [38..39] 'z'}
                   }
-                  { CONST [43..48] '12000'}
                }
+               { CONST [43..48] '12000'}
             }
             { STATEMENTS [53..223] 'while x > 0
         if y > 3 x = x + 1 end
@@ -376,15 +420,15 @@ end'
                            }
                            { ASSIGNMENT [153..179] 'unused = x * 123 + z * 125'
                               { VAR [153..159] 'unused'}
-                              { BINOP MULTIPLICATION [162..179] 'x * 123 + z * 125'
-                                 { BINOP MULTIPLICATION [162..173] 'x * 123 + z'
+                              { BINOP PLUS [162..179] 'x * 123 + z * 125'
+                                 { BINOP MULTIPLICATION [162..169] 'x * 123'
                                     { VAR [162..163] 'x'}
-                                    { BINOP PLUS [166..173] '123 + z'
-                                       { CONST [166..169] '123'}
-                                       { VAR [172..173] 'z'}
-                                    }
+                                    { CONST [166..169] '123'}
+                                 }
+                                 { BINOP MULTIPLICATION [172..179] 'z * 125'
+                                    { VAR [172..173] 'z'}
+                                    { CONST [176..179] '125'}
                                  }
-                                 { CONST [176..179] '125'}
                               }
                            }
                         }
@@ -424,7 +468,12 @@ TEST_CASE ("Parser error test", "[parser]") {
                  {"x=(1", "UNCLOSED_PARENTHESIS", 4},
                  {"if x > 0 x = 2", "UNFINISHED_STATEMENT", 14},
                  {"  ", "STRING_IS_TOO_SHORT", 2},
-                 {"white", "STRING_IS_TOO_SHORT", 5}
+                 {"white", "STRING_IS_TOO_SHORT", 5},
+                 {"x=1 y", "STRING_IS_TOO_SHORT", 5},
+                 {"x=1 y=", "IDENTIFIER_OR_CONSTANT_EXPECTED", 6},
+                 {"x=a)", "INVALID_SYMBOL", 3},
+                 {"x=a & b", "INVALID_SYMBOL", 4},
+                 {"x=a+*b", "IDENTIFIER_OR_CONSTANT_EXPECTED", 4}
             }));
 
     CAPTURE(input);
@@ -432,3 +481,99 @@ TEST_CASE ("Parser error test", "[parser]") {
     REQUIRE(expected_error == error.cause);
     REQUIRE(expected_pos == error.pos);
 }
+
+TEST_CASE ("Parser nesting limit test", "[parser]") {
+    auto nested = [](std::string const & open, std::string const & close, size_t depth) {
+        std::string result = "x=";
+        for (size_t level = 0; level < depth; ++level) {
+            result += open;
+        }
+        result += "1";
+        for (size_t level = 0; level < depth; ++level) {
+            result += close;
+        }
+        return result;
+    };
+
+    REQUIRE(std::holds_alternative<parser::ast::tree>(parser::parse(nested("(", ")", lexer::MAX_NESTING))));
+    REQUIRE(std::holds_alternative<parser::ast::tree>(parser::parse(nested("-", "", lexer::MAX_NESTING))));
+
+    auto error = parse_and_get_error(nested("(", ")", lexer::MAX_NESTING + 1));
+    REQUIRE(std::string("NESTING_TOO_DEEP") == error.cause);
+    REQUIRE(error.pos == 2 + lexer::MAX_NESTING);
+
+    error = parse_and_get_error(nested("-(", ")", lexer::MAX_NESTING));
+    REQUIRE(std::string("NESTING_TOO_DEEP") == error.cause);
+}
+
+TEST_CASE ("Parser node limit test", "[parser]") {
+    // a statement `a = 1` is 4 nodes with the STATEMENTS node joining it, the first one is joined to nothing
+    std::string largest = "a = 1 + 1 a = -1";
+    for (uint32_t statements = 2; statements < (parser::ast::tree::MAX_NODES + 1) / 4; ++statements) {
+        largest += " a = 1";
+    }
+    auto parsed = parser::parse(largest);
+    REQUIRE(std::holds_alternative<parser::ast::tree>(parsed));
+    REQUIRE(std::get<parser::ast::tree>(parsed).size() == parser::ast::tree::MAX_NODES);
+
+    std::string too_large = largest + " b = -1";
+    auto error = parse_and_get_error(too_large);
+    REQUIRE(std::string("TOO_MANY_NODES") == error.cause);
+    REQUIRE(error.pos == too_large.size() - 6); // the first node past the limit is `b`
+
+    std::string big;
+    for (uint32_t statements = 0; statements < 14000; ++statements) {
+        big += "x = y + 1\n";
+    }
+    REQUIRE(std::string("TOO_MANY_NODES") == parse_and_get_error(big).cause);
+}
+
+TEST_CASE ("Printer JSON test", "[printer]") {
+    std::string input = "x = 2 + y";
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+
+    std::stringstream ss;
+    printer::print_json(ss, tree);
+
+    REQUIRE(ss.str() ==
+        "{\"id\":3,\"kind\":\"ASSIGNMENT\",\"operator\":null,\"range\":[0,9],\"children\":[4,2]}\n"
+        "{\"id\":4,\"kind\":\"VAR\",\"operator\":null,\"range\":[0,1],\"children\":[]}\n"
+        "{\"id\":2,\"kind\":\"BINOP\",\"operator\":\"PLUS\",\"range\":[4,9],\"children\":[0,1]}\n"
+        "{\"id\":0,\"kind\":\"CONST\",\"operator\":null,\"range\":[4,5],\"children\":[]}\n"
+        "{\"id\":1,\"kind\":\"VAR\",\"operator\":null,\"range\":[8,9],\"children\":[]}\n"
+    );
+}
+
+TEST_CASE ("Printer binary test", "[printer]") {
+    std::string input = "if x y = 1 end";
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+
+    std::stringstream ss;
+    printer::print_binary(ss, tree);
+    auto dump = ss.str();
+
+    REQUIRE(dump.size() == 5 + 1 + 4 + tree.size() * 11u);
+    REQUIRE(dump.substr(0, 5) == "SPAST");
+    REQUIRE(dump[5] == printer::binary::VERSION);
+    REQUIRE(dump[6] == static_cast<char>(tree.size()));
+
+    auto node = [&](size_t idx) { return dump.substr(10 + idx * 11, 11); };
+    REQUIRE(node(0) == std::string("\x00\x06\x03\x00\x00\x00\x00\x0e\x00\x00\x00", 11)); // IF
+    REQUIRE(node(1) == std::string("\x03\x06\x00\x03\x00\x00\x00\x04\x00\x00\x00", 11)); // VAR x
+    REQUIRE(node(2) == std::string("\x02\x06\x03\x05\x00\x00\x00\x0a\x00\x00\x00", 11)); // ASSIGNMENT
+}
+
+TEST_CASE ("Buffered printer handles large trees", "[printer]") {
+    std::string input;
+    for (int i = 0; i < 500; ++i) {
+        input += "x = x + 1 ";
+    }
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+
+    std::stringstream ss;
+    printer::print(ss, tree, input);
+    auto dump = ss.str();
+
+    REQUIRE(std::count(dump.begin(), dump.end(), '\n') == 500 * 7 + 499 * 2);
+    REQUIRE(dump.substr(dump.size() - 2) == "}\n");
+}
@@ -0,0 +1,100 @@
+#include <catch2/catch.hpp>
+
+#include <profiler.h>
+#include <sstream>
+#include <string>
+
+namespace {
+
+    uint16_t find_statement(parser::ast::tree const & tree, std::string_view sv, std::string_view text) {
+        for (auto node : parser::ast::preorder(tree)) {
+            if (profiler::detail::is_statement(tree, node) && tree.get_string(node, sv).starts_with(text)) {
+                return node;
+            }
+        }
+        FAIL("no statement " << text);
+        return parser::ast::tree::npos;
+    }
+
+}
+
+TEST_CASE("Profile counts executions of statements", "[profiler]") {
+    std::string input = "r = 1\nwhile n > 0\n  if n > 2 r = r * n end\n  n = n - 1\nend";
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    auto p = eval::compile(tree, input);
+
+    eval::profile profile(p);
+    std::vector<eval::value> variables(p.variable_count());
+    variables[p.find_variable("n")] = 5;
+    REQUIRE(eval::run(p, variables, profile));
+    REQUIRE(variables[p.find_variable("r")] == 60);
+    variables[p.find_variable("n")] = 3;
+    REQUIRE(eval::run(p, variables, profile));
+
+    auto node = [&](std::string_view text) {
+        return find_statement(tree, input, text);
+    };
+    REQUIRE(profile.counts[node("r = 1")] == 2);
+    REQUIRE(profile.counts[node("while")] == 2);
+    REQUIRE(profile.counts[node("if")] == 8);
+    REQUIRE(profile.counts[node("r = r * n")] == 4);
+    REQUIRE(profile.counts[node("n = n - 1")] == 8);
+    for (uint16_t idx = 0; idx < tree.size(); ++idx) {
+        if (!profiler::detail::is_statement(tree, idx)) {
+            REQUIRE(profile.counts[idx] == 0);
+            REQUIRE(profile.cycles[idx] == 0);
+        }
+    }
+
+    auto spots = profiler::hot_spots(tree, profile);
+    REQUIRE(spots.size() == 5);
+    REQUIRE(std::is_sorted(spots.begin(), spots.end(), [](auto const & a, auto const & b) {
+        return a.self_cycles > b.self_cycles;
+    }));
+    uint64_t all = 0;
+    for (auto const & s : spots) {
+        REQUIRE(s.range == tree.get_range(s.node));
+        REQUIRE(s.total_cycles >= s.self_cycles);
+        all += s.self_cycles;
+    }
+    auto loop = std::find_if(spots.begin(), spots.end(), [&](auto const & s) {
+        return s.node == node("while");
+    });
+    auto first = std::find_if(spots.begin(), spots.end(), [&](auto const & s) {
+        return s.node == node("r = 1");
+    });
+    REQUIRE(loop->total_cycles + first->total_cycles == all);
+}
+
+TEST_CASE("Profile exports folded stacks", "[profiler]") {
+    std::string input = "while n > 0\n  if n > 2\n    r = r * n\n  end n = n - 1 end";
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    auto p = eval::compile(tree, input);
+    eval::profile profile(p);
+    std::vector<eval::value> variables(p.variable_count());
+    variables[p.find_variable("n")] = 100;
+    REQUIRE(eval::run(p, variables, profile));
+
+    std::ostringstream folded;
+    profiler::write_folded(folded, tree, input, profile);
+    std::istringstream lines(folded.str());
+    uint64_t all = 0;
+    bool nested = false;
+    for (std::string line; std::getline(lines, line);) {
+        auto space = line.rfind(' ');
+        REQUIRE(space != std::string::npos);
+        all += std::stoull(line.substr(space + 1));
+        nested |= line.starts_with("while n > 0 @1:1;if n > 2 @2:3;r = r * n @3:5 ");
+    }
+    REQUIRE(nested);
+    uint64_t cycles = 0;
+    for (auto c : profile.cycles) {
+        cycles += c;
+    }
+    REQUIRE(all == cycles);
+
+    std::ostringstream report;
+    profiler::write_report(report, tree, input, profile);
+    REQUIRE(report.str().starts_with("self%\tself\ttotal\tcount\tstatement\n"));
+    REQUIRE(report.str().find("\t100\tn = n - 1 @4:7\n") != std::string::npos);
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <string>
+
+// Random programs for the differential tests and the benchmarks. Every generated program
+// parses, so that it can be fed to any phase of the pipeline.
+namespace program_generator {
+
+    namespace detail {
+
+        inline constexpr char const * NAMES[] = {"a", "total", "counter", "x", "position", "limit"};
+        // the edges of the 64 bit range, the last one wraps around
+        inline constexpr char const * CONSTANTS[] = {"0", "1", "2", "7", "1000003", "9223372036854775807", "9223372036854775808"};
+        inline constexpr char const * OPERATORS[] = {"+", "-", "*", "/", "<", ">", "==", "!=", "<=", ">=", "&&", "||"};
+
+    }
+
+    struct options {
+        uint32_t variables = 6;  // drawn from 'a' on, or from the long names
+        bool long_names = false; // a mix of one letter and longer identifiers
+        uint32_t constants = 4;  // constants of the fixed shapes are below this
+        std::string indent;      // when set, block bodies go on their own lines behind this margin
+        bool nested = false;     // blocks stay open across statements and are closed in turn
+        uint32_t depth = 0;      // random expressions of this depth instead of the fixed shapes
+    };
+
+    inline std::string generate(uint32_t statements, std::mt19937 & random, options const & opts = {}) {
+        auto pick = [&](uint32_t n) {
+            return std::uniform_int_distribution<uint32_t>(0, n - 1)(random);
+        };
+        auto variable = [&]() -> std::string {
+            if (opts.long_names) {
+                return detail::NAMES[pick(std::min<uint32_t>(opts.variables, std::size(detail::NAMES)))];
+            }
+            return std::string(1, static_cast<char>('a' + pick(opts.variables)));
+        };
+        auto expression = [&](auto & self, uint32_t depth) -> std::string {
+            switch (depth ? pick(4) : 0) {
+                case 0:
+                    return pick(2) ? variable() : detail::CONSTANTS[pick(std::size(detail::CONSTANTS))];
+                case 1:
+                    return std::string("-").append(self(self, depth - 1));
+                case 2:
+                    return std::string("(").append(self(self, depth - 1)).append(")");
+                default: {
+                    auto left = self(self, depth - 1);
+                    auto op = detail::OPERATORS[pick(std::size(detail::OPERATORS))];
+                    return left.append(" ").append(op).append(" ").append(self(self, depth - 1));
+                }
+            }
+        };
+
+        auto assignment = [&] {
+            auto result = variable().append(" = ");
+            if (opts.depth) {
+                return result.append(expression(expression, opts.depth));
+            }
+            if (pick(2)) {
+                return result.append(variable()).append(" + (").append(variable()).append(" * 3 - ").append(variable()).append(")");
+            }
+            return result.append(variable()).append(" * ").append(std::to_string(pick(opts.constants))).append(" + -").append(variable());
+        };
+        auto condition = [&](bool loop) {
+            if (opts.depth) {
+                return expression(expression, opts.depth - 1);
+            }
+            return variable().append(loop ? " < 100" : " > 5");
+        };
+
+        // blocks may not be empty, every opened one gets an assignment first
+        std::string result, margin;
+        uint32_t opened = 0;
+        auto line = [&](std::string const & text) {
+            result.append(margin).append(text).append("\n");
+        };
+        auto open = [&](bool loop) {
+            auto head = std::string(loop ? "while " : "if ").append(condition(loop));
+            if (opts.indent.empty()) {
+                result.append(margin).append(head).append(" ").append(assignment());
+                result.append(opts.nested ? "\n" : " end\n");
+            } else {
+                line(head);
+                margin += opts.indent;
+                line(assignment());
+                if (!opts.nested) {
+                    margin.resize(margin.size() - opts.indent.size());
+                    line("end");
+                }
+            }
+            opened += opts.nested;
+        };
+        auto close = [&] {
+            if (!opts.indent.empty()) {
+                margin.resize(margin.size() - opts.indent.size());
+            }
+            line("end");
+            --opened;
+        };
+
+        for (uint32_t idx = 0; idx < statements; ++idx) {
+            switch (pick(opts.nested ? 6 : 4)) {
+                case 0:
+                    open(true);
+                    break;
+                case 1:
+                    open(false);
+                    break;
+                case 2:
+                    if (opts.nested) {
+                        if (opened) {
+                            close();
+                        }
+                        break;
+                    }
+                    [[fallthrough]];
+                default:
+                    line(assignment());
+                    break;
+            }
+        }
+        while (opened) {
+            close();
+        }
+        return result;
+    }
+
+    inline std::string generate(uint32_t statements, uint32_t seed, options const & opts = {}) {
+        std::mt19937 random(seed);
+        return generate(statements, random, opts);
+    }
+
+}
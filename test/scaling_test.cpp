@@ -0,0 +1,152 @@
+#include <catch2/catch.hpp>
+
+#include <analyze.h>
+#include <cmath>
+#include <functional>
+#include <string>
+
+// Runtime of every pipeline phase is measured on inputs of doubling size and the exponent
+// of the power law `t = c * n^k` is fitted by least squares on the log-log scale.
+// O(n log n) on these sizes gives k close to 1.1, quadratic behaviour gives k close to 2.
+// Wall-clock fits drift when other tests share the machine, so ctest runs them as one serial test.
+
+constexpr double MAX_EXPONENT = 1.4;
+constexpr double MIN_MEASURABLE_SECONDS = 2e-4; // cheaper phases are dominated by timer noise
+constexpr int REPETITIONS = 5;
+
+// prefixed, so that names never start with a keyword
+std::string variable_name(uint32_t idx) {
+    std::string name = "v";
+    do {
+        name.push_back(static_cast<char>('a' + idx % 26));
+        idx /= 26;
+    } while (idx);
+    return name;
+}
+
+std::string long_identifiers(uint32_t n) {
+    auto name = std::string(n, 'a');
+    return name + " = 1 x = " + name + " + " + name;
+}
+
+std::string parenthesized_groups(uint32_t n) {
+    std::string result = "x = (a + b)";
+    for (auto idx = 1u; idx < n; ++idx) {
+        result += idx % 2 ? " * (c - d)" : " - (e / f)";
+    }
+    return result;
+}
+
+std::string nested_loops(uint32_t n) {
+    std::string result;
+    for (auto idx = 0u; idx < n; ++idx) {
+        auto var = variable_name(idx);
+        result += "while " + var + " < 10 " + var + " = " + var + " + 1\n";
+    }
+    result += "x = 1\n";
+    for (auto idx = 0u; idx < n; ++idx) {
+        result += "end\n";
+    }
+    return result;
+}
+
+std::string operator_chain(uint32_t n) {
+    constexpr char operators[] = "+-*/<>";
+    std::string result = "x = a";
+    for (auto idx = 1u; idx < n; ++idx) {
+        result += ' ';
+        result += operators[idx % 6];
+        result += ' ';
+        result += idx % 2 ? "b" : "1";
+    }
+    return result;
+}
+
+std::string many_variables(uint32_t n) {
+    std::string result = "a = 1\n";
+    for (auto idx = 1u; idx < n; ++idx) {
+        result += variable_name(idx) + " = " + variable_name(idx - 1) + " + " + variable_name(idx / 2) + "\n";
+    }
+    return result;
+}
+
+stats::pipeline_stats measure(std::string const & input) {
+    stats::pipeline_stats best;
+    for (auto & phase : best.phases) {
+        phase.time = std::chrono::nanoseconds::max();
+    }
+
+    for (auto rep = 0; rep < REPETITIONS; ++rep) {
+        stats::pipeline_stats current;
+        auto parsed = parser::parse(input, current);
+        REQUIRE(std::holds_alternative<parser::ast::tree>(parsed));
+        find_unused_assignments(std::get<parser::ast::tree>(parsed), input, current);
+
+        for (auto idx = 0u; idx < stats::PHASE_COUNT; ++idx) {
+            best.phases[idx].time = std::min(best.phases[idx].time, current.phases[idx].time);
+        }
+    }
+    return best;
+}
+
+double fit_exponent(std::vector<double> const & sizes, std::vector<double> const & times) {
+    double mean_x = 0, mean_y = 0;
+    for (auto idx = 0u; idx < sizes.size(); ++idx) {
+        mean_x += std::log(sizes[idx]) / sizes.size();
+        mean_y += std::log(times[idx]) / sizes.size();
+    }
+
+    double cov = 0, var = 0;
+    for (auto idx = 0u; idx < sizes.size(); ++idx) {
+        auto dx = std::log(sizes[idx]) - mean_x;
+        cov += dx * (std::log(times[idx]) - mean_y);
+        var += dx * dx;
+    }
+    return cov / var;
+}
+
+void check_scaling(std::function<std::string(uint32_t)> const & generate, uint32_t from, uint32_t to) {
+    constexpr char const * names[] = {"lex", "parse", "free variables", "unused detection"};
+
+    std::vector<double> sizes;
+    std::vector<stats::pipeline_stats> results;
+    for (auto n = from; n <= to; n *= 2) {
+        auto input = generate(n);
+        sizes.push_back(static_cast<double>(input.size()));
+        results.push_back(measure(input));
+    }
+
+    for (auto phase = 0u; phase < stats::PHASE_COUNT; ++phase) {
+        std::vector<double> times;
+        for (auto const & result : results) {
+            times.push_back(std::max(1e-9, std::chrono::duration<double>(result.phases[phase].time).count()));
+        }
+        if (times.back() < MIN_MEASURABLE_SECONDS) {
+            continue;
+        }
+
+        auto exponent = fit_exponent(sizes, times);
+        CAPTURE(names[phase], times.front(), times.back(), exponent);
+        CHECK(exponent < MAX_EXPONENT);
+    }
+}
+
+TEST_CASE("Scaling: long identifiers", "[scaling]") {
+    check_scaling(long_identifiers, 1 << 17, 1 << 21);
+}
+
+TEST_CASE("Scaling: parenthesized groups", "[scaling]") {
+    check_scaling(parenthesized_groups, 1 << 9, 1 << 13);
+}
+
+TEST_CASE("Scaling: nested loops", "[scaling]") {
+    check_scaling(nested_loops, 1 << 7, 1 << 11);
+}
+
+TEST_CASE("Scaling: operator chains", "[scaling]") {
+    check_scaling(operator_chain, 1 << 10, 1 << 14);
+}
+
+TEST_CASE("Scaling: many variables", "[scaling]") {
+    check_scaling(many_variables, 1 << 8, 1 << 12);
+}
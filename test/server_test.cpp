@@ -0,0 +1,212 @@
+#include <catch2/catch.hpp>
+
+#include <server.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    // Socket path in a directory of its own: ctest runs every case in a process of its own, possibly
+    // in parallel, and a daemon unlinks its path before binding
+    class temporary_socket {
+    public:
+        temporary_socket() {
+            std::string pattern = (std::filesystem::temp_directory_path() / "simple_parser_server_XXXXXX").string();
+            if (!::mkdtemp(pattern.data())) {
+                throw std::system_error(errno, std::generic_category(), "mkdtemp");
+            }
+            dir_ = pattern;
+        }
+
+        temporary_socket(temporary_socket const &) = delete;
+        temporary_socket & operator=(temporary_socket const &) = delete;
+
+        ~temporary_socket() {
+            std::error_code ignored;
+            std::filesystem::remove_all(dir_, ignored);
+        }
+
+        [[nodiscard]]
+        std::string path() const {
+            return (dir_ / "daemon.sock").string();
+        }
+
+    private:
+        std::filesystem::path dir_;
+    };
+
+    // Daemon with its event loop on a background thread
+    class running_daemon {
+    public:
+        running_daemon()
+            : daemon_(socket_.path(), 2)
+            , thread_([this] { daemon_.serve(); }) {}
+
+        ~running_daemon() {
+            daemon_.stop();
+            thread_.join();
+        }
+
+        [[nodiscard]]
+        std::string const & path() const {
+            return daemon_.path();
+        }
+
+    private:
+        temporary_socket socket_;
+        server::daemon daemon_;
+        std::thread thread_;
+    };
+
+    std::vector<uint32_t> read_words(std::string_view body) {
+        std::vector<uint32_t> words;
+        for (size_t pos = 0; pos + 4 <= body.size(); pos += 4) {
+            words.push_back(server::protocol::read_u32(body.data() + pos));
+        }
+        return words;
+    }
+
+}
+
+TEST_CASE("Server answers analyze and parse requests", "[server]") {
+    running_daemon daemon;
+    server::client client(daemon.path());
+
+    std::string input = "x = 1\n"
+                        "y = 2\n"
+                        "x = y\n";
+
+    auto binary = client.request(server::protocol::ANALYZE, server::protocol::BINARY, input);
+    REQUIRE(binary.status == server::protocol::OK);
+    REQUIRE(read_words(binary.body) == std::vector<uint32_t>{2, 0, 5, 12, 17});
+
+    auto json = client.request(server::protocol::ANALYZE, server::protocol::JSON, input);
+    REQUIRE(json.status == server::protocol::OK);
+    REQUIRE(json.body ==
+        R"({"unused":[{"begin":0,"end":5,"line":1,"column":1,"text":"x = 1"},)"
+        R"({"begin":12,"end":17,"line":3,"column":1,"text":"x = y"}]})");
+
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    std::string expected;
+    printer::print_binary(expected, tree);
+    auto parsed = client.request(server::protocol::PARSE, server::protocol::BINARY, input);
+    REQUIRE(parsed.status == server::protocol::OK);
+    REQUIRE(parsed.body == expected);
+
+    expected.clear();
+    printer::print_json(expected, tree);
+    REQUIRE(client.request(server::protocol::PARSE, server::protocol::JSON, input).body == expected);
+}
+
+TEST_CASE("Server reports syntax errors and malformed requests", "[server]") {
+    running_daemon daemon;
+    server::client client(daemon.path());
+
+    auto error = client.request(server::protocol::ANALYZE, server::protocol::JSON, "x = 1\ny = (2");
+    REQUIRE(error.status == server::protocol::SYNTAX_ERROR);
+    REQUIRE(error.body == R"({"error":{"cause":"UNCLOSED_PARENTHESIS","offset":12,"line":2,"column":7}})");
+
+    error = client.request(server::protocol::PARSE, server::protocol::BINARY, "x = ");
+    REQUIRE(error.status == server::protocol::SYNTAX_ERROR);
+    REQUIRE(read_words(error.body.substr(0, 12)) == std::vector<uint32_t>{4, 1, 5});
+    REQUIRE(error.body.substr(12) == "IDENTIFIER_OR_CONSTANT_EXPECTED");
+
+    auto bad = client.request(static_cast<server::protocol::command>(7), server::protocol::JSON, "x = 1");
+    REQUIRE(bad.status == server::protocol::BAD_REQUEST);
+
+    // the connection is still usable
+    REQUIRE(client.request(server::protocol::ANALYZE, server::protocol::BINARY, "x = 1").status == server::protocol::OK);
+}
+
+TEST_CASE("Server handles concurrent and pipelined clients", "[server]") {
+    running_daemon daemon;
+
+    std::string input;
+    for (int idx = 0; idx < 100; ++idx) {
+        input += "a = b + ";
+        input += std::to_string(idx);
+        input += "\nb = a\n";
+    }
+    auto expected = server::client(daemon.path()).request(server::protocol::ANALYZE, server::protocol::BINARY, input).body;
+
+    std::vector<std::thread> clients;
+    std::atomic<int> matching = 0;
+    for (int thread = 0; thread < 4; ++thread) {
+        clients.emplace_back([&] {
+            server::client client(daemon.path());
+
+            // three requests in one write, split inside a frame header, answered in order
+            std::string batch;
+            for (int idx = 0; idx < 3; ++idx) {
+                std::string_view source = idx == 1 ? std::string_view("x = ") : std::string_view(input);
+                server::protocol::append_u32(batch, source.size() + 2);
+                batch.push_back(server::protocol::ANALYZE);
+                batch.push_back(server::protocol::BINARY);
+                batch.append(source);
+            }
+            client.send_all(batch.substr(0, 3));
+            client.send_all(batch.substr(3));
+
+            auto first = client.receive();
+            auto second = client.receive();
+            auto third = client.receive();
+            matching += first.body == expected && second.status == server::protocol::SYNTAX_ERROR && third.body == expected;
+
+            for (int round = 0; round < 50; ++round) {
+                auto result = client.request(server::protocol::ANALYZE, server::protocol::BINARY, input);
+                matching += result.status == server::protocol::OK && result.body == expected;
+            }
+        });
+    }
+    for (auto & thread : clients) {
+        thread.join();
+    }
+    REQUIRE(matching == 4 * 51);
+}
+
+TEST_CASE("Server answers requests of a client that stopped sending", "[server]") {
+    temporary_socket socket;
+    server::daemon daemon(socket.path(), 2);
+    std::string input = "x = 1\ny = 2\n";
+
+    // frames and EOF are already there when the event loop first looks at the connection
+    server::client client(daemon.path());
+    client.send(server::protocol::ANALYZE, server::protocol::BINARY, input);
+    client.send(server::protocol::PARSE, server::protocol::JSON, input);
+    client.finish_sending();
+
+    server::client partial(daemon.path());
+    partial.send_all(std::string_view("\x09\0\0\0\x01", 5));
+    partial.finish_sending();
+
+    std::thread loop([&] { daemon.serve(); });
+    auto analyzed = client.receive();
+    auto parsed = client.receive();
+    bool client_closed = false;
+    bool partial_closed = false;
+    try {
+        client.receive();
+    } catch (std::system_error const &) {
+        client_closed = true;
+    }
+    try {
+        partial.receive();
+    } catch (std::system_error const &) {
+        partial_closed = true;
+    }
+    daemon.stop();
+    loop.join();
+
+    REQUIRE(analyzed.status == server::protocol::OK);
+    REQUIRE(read_words(analyzed.body) == std::vector<uint32_t>{2, 0, 5, 6, 11});
+    REQUIRE(parsed.status == server::protocol::OK);
+    REQUIRE(parsed.body.starts_with("{\"id\":"));
+    REQUIRE(client_closed);
+    REQUIRE(partial_closed);
+}
@@ -0,0 +1,63 @@
+#include <catch2/catch.hpp>
+
+#include <stats.h>
+#include <analyze.h>
+#include <string>
+#include <type_traits>
+
+TEST_CASE("Pipeline statistics test", "[stats]") {
+    std::string input = R"(
+        a = 1
+        b = a
+        while (b < 5)
+            z = x
+            b = b + 1
+        end
+    )";
+
+    stats::pipeline_stats statistics;
+    auto parsed = parser::parse(input, statistics);
+    REQUIRE(std::holds_alternative<parser::ast::tree>(parsed));
+    auto const & tree = std::get<parser::ast::tree>(parsed);
+    auto unused = find_unused_assignments(tree, input, statistics);
+
+    REQUIRE(unused == find_unused_assignments(tree, input));
+    REQUIRE(statistics.tokens > 0);
+    REQUIRE(statistics.token_bytes >= statistics.tokens * sizeof(lexer::token));
+    REQUIRE(statistics.nodes == tree.size());
+    REQUIRE(statistics.node_bytes >= tree.memory_usage());
+
+    for (auto const & phase : statistics.phases) {
+        REQUIRE(phase.time.count() >= 0);
+        REQUIRE(phase.allocations > 0);
+    }
+}
+
+TEST_CASE("Pluggable allocation counter", "[stats]") {
+    std::string input = "x = 1 y = x";
+
+    stats::pipeline_stats statistics;
+    statistics.allocation_counter = []() -> uint64_t { return 0; };
+    auto tree = std::get<parser::ast::tree>(parser::parse(input, statistics));
+    find_unused_assignments(tree, input, statistics);
+
+    for (auto const & phase : statistics.phases) {
+        REQUIRE(phase.allocations == 0);
+    }
+
+    stats::counting_resource counting;
+    memory::vector<int> counted(&counting);
+    auto before = stats::allocation_count();
+    counted.push_back(1);
+    REQUIRE(stats::allocation_count() == before + 1);
+}
+
+TEST_CASE("Parse error statistics", "[stats]") {
+    stats::pipeline_stats statistics;
+    auto parsed = parser::parse("x = (1", statistics);
+
+    REQUIRE(std::holds_alternative<lexer::error>(parsed));
+    REQUIRE(statistics.nodes == 0);
+    REQUIRE(statistics.phases[stats::PARSE].allocations == 0);
+    REQUIRE(std::is_empty_v<stats::disabled>);
+}
@@ -0,0 +1,121 @@
+#include <catch2/catch.hpp>
+
+#include <streaming.h>
+#include <algorithm>
+#include <sstream>
+
+using ranges = std::vector<std::pair<uint32_t, uint32_t>>;
+
+std::string describe(std::variant<ranges, lexer::error> const & result) {
+    std::stringstream ss;
+    if (auto error = std::get_if<lexer::error>(&result)) {
+        ss << error->cause << " at " << error->pos;
+    } else {
+        for (auto [start, end] : std::get<ranges>(result)) {
+            ss << start << "-" << end << " ";
+        }
+    }
+    return ss.str();
+}
+
+std::string analyze_whole(std::string_view str) {
+    auto result = parser::parse(str);
+    if (auto error = std::get_if<lexer::error>(&result)) {
+        return describe(*error);
+    }
+    auto const & tree = std::get<parser::ast::tree>(result);
+    ranges unused;
+    for (auto idx : find_unused_assignments(tree, str)) {
+        unused.push_back(tree.get_range(idx));
+    }
+    std::sort(unused.begin(), unused.end());
+    return describe(unused);
+}
+
+std::string analyze_streamed(std::string_view str, size_t piece) {
+    ranges unused;
+    streaming::analyzer a([&](std::pair<uint32_t, uint32_t> range) {
+        unused.push_back(range);
+    });
+    std::optional<lexer::error> error;
+    for (size_t pos = 0; !error && pos < str.size(); pos += piece) {
+        error = a.feed(str.substr(pos, piece));
+    }
+    if (!error) {
+        error = a.finish();
+    }
+    if (error) {
+        return describe(*error);
+    }
+    std::sort(unused.begin(), unused.end());
+    return describe(unused);
+}
+
+TEST_CASE("Streaming analysis test", "[streaming]") {
+    auto input = GENERATE(as<std::string>{},
+        "x=1",
+        "x=y y=x",
+        "x=y x=0",
+        "  x = 0\n  if x > 0\n    y = x\n  end\n  x = y\n",
+        "x = 0 while x < 100 x = x + 1 end",
+        "x = 0 y = 0 while x < 10 y = x x = x + 1 end z = 1",
+        "a = 1 while a while b a = a - 1 b = 0 end c = a end d = c",
+        "x = 1 y = x != 2 x = y >= 3 z = x || y && -x",
+        "x = (a + b) * c x = x/2 if x x = 1 end",
+        "x = a\n!= b y = x",
+        "while a if b c = 1 end c = 2 end",
+        "",
+        "   ",
+        "x = ",
+        "x = a)",
+        "x = a & b",
+        "while a x = 1",
+        "x = 1 y = 2 if",
+        "x = 1 end"
+    );
+    auto piece = GENERATE(as<size_t>{}, 1, 2, 3, 7, 1000);
+
+    CAPTURE(input, piece);
+    REQUIRE(analyze_streamed(input, piece) == analyze_whole(input));
+}
+
+TEST_CASE("Streaming analysis reports dead assignments early", "[streaming]") {
+    ranges unused;
+    streaming::analyzer a([&](std::pair<uint32_t, uint32_t> range) {
+        unused.push_back(range);
+    });
+
+    REQUIRE_FALSE(a.feed("x = 1\n"));
+    REQUIRE(unused.empty());
+
+    REQUIRE_FALSE(a.feed("x = 2\ny = x\n"));
+    REQUIRE(unused == ranges{{0, 5}});
+
+    REQUIRE_FALSE(a.finish());
+    REQUIRE(unused == ranges{{0, 5}, {12, 17}});
+}
+
+TEST_CASE("Streaming analysis memory is bounded by a block", "[streaming]") {
+    // far more nodes than a single tree can hold
+    constexpr uint32_t BLOCKS = 30000;
+    std::string block = "a = 1 b = a while b < 10 b = b + 1 end c = 2\n";
+    std::string program;
+    for (uint32_t i = 0; i < BLOCKS; ++i) {
+        program += block;
+    }
+
+    std::istringstream in(program);
+    uint32_t reported = 0;
+    streaming::footprint memory;
+    auto error = streaming::analyze(in, [&](std::pair<uint32_t, uint32_t> range) {
+        REQUIRE(std::string_view(program).substr(range.first, range.second - range.first) == "c = 2");
+        ++reported;
+    }, &memory);
+
+    REQUIRE_FALSE(error);
+    REQUIRE(reported == BLOCKS);
+    REQUIRE(memory.statements == BLOCKS * 4);
+    REQUIRE(memory.max_nodes < 16);
+    REQUIRE(memory.max_buffered <= block.size());
+    REQUIRE(memory.variables == 3);
+}
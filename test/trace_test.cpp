@@ -0,0 +1,138 @@
+#include <catch2/catch.hpp>
+
+#include <analyze.h>
+#include <parser.h>
+#include <trace.h>
+#include <latch>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifdef SIMPLE_PARSER_TRACE
+
+namespace {
+
+    // drains what earlier tests left
+    std::string flush() {
+        std::ostringstream out;
+        trace::write_chrome_json(out);
+        return out.str();
+    }
+
+    size_t count(std::string const & json, std::string const & needle) {
+        size_t result = 0;
+        for (auto pos = json.find(needle); pos != std::string::npos; pos = json.find(needle, pos + 1)) {
+            ++result;
+        }
+        return result;
+    }
+
+}
+
+static_assert(trace::enabled);
+static_assert(std::holds_alternative<parser::ast::tree>(parser::parse("while x x = x - 1 end")), "spans are skipped in constant evaluation");
+
+TEST_CASE("Trace records the pipeline phases", "[trace]") {
+    flush();
+    std::string input = "x = 1 y = x x = 2";
+    {
+        trace::file_scope file(7);
+        auto tree = std::get<parser::ast::tree>(parser::parse(input));
+        REQUIRE(find_unused_assignments(tree, input).size() == 2);
+    }
+    auto json = flush();
+
+    REQUIRE(json.starts_with("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+    REQUIRE(json.ends_with("]}\n"));
+    for (auto name : {"lex", "parse", "free variables", "unused detection"}) {
+        CAPTURE(name);
+        REQUIRE(count(json, "{\"name\":\"" + std::string(name) + "\",\"cat\":\"pipeline\",\"ph\":\"X\",\"ts\":") == 1);
+    }
+    REQUIRE(count(json, "\"args\":{\"file\":7}") == 4);
+    REQUIRE(json.find("\"name\":\"lex\"") < json.find("\"name\":\"parse\""));
+
+    parser::parse(input);
+    json = flush();
+    REQUIRE(count(json, "\"ph\":\"X\"") == 2);
+    REQUIRE(count(json, "\"file\"") == 0);
+    REQUIRE(flush().find("\"ph\":\"X\"") == std::string::npos);
+}
+
+TEST_CASE("Trace keeps a track per thread", "[trace]") {
+    flush();
+    std::vector<std::thread> threads;
+    std::latch alive(4); // threads which are gone leave their ring to the next one
+    for (uint32_t file = 0; file < 4; ++file) {
+        threads.emplace_back([file, &alive] {
+            trace::file_scope scope(file);
+            std::string input = "a = " + std::to_string(file);
+            parser::parse(input);
+            alive.arrive_and_wait();
+        });
+    }
+    for (auto & t : threads) {
+        t.join();
+    }
+    auto json = flush();
+
+    std::set<std::string> tracks;
+    for (uint32_t file = 0; file < 4; ++file) {
+        std::string args = "\"args\":{\"file\":";
+        args.append(std::to_string(file)).append("}");
+        auto pos = json.find(args);
+        REQUIRE(pos != std::string::npos);
+        auto tid = json.rfind("\"tid\":", pos);
+        tracks.insert(json.substr(tid, pos - tid));
+    }
+    REQUIRE(tracks.size() == 4);
+    REQUIRE(count(json, "\"ph\":\"M\"") >= 4);
+}
+
+TEST_CASE("Trace drops events when a ring is full", "[trace]") {
+    flush();
+    auto before = trace::dropped();
+    std::thread([] {
+        for (uint64_t idx = 0; idx < trace::detail::RING_SIZE + 5; ++idx) {
+            trace::span span("tick");
+        }
+    }).join();
+    REQUIRE(trace::dropped() - before == 5);
+
+    auto json = flush();
+    REQUIRE(count(json, "\"name\":\"tick\"") == trace::detail::RING_SIZE);
+}
+
+TEST_CASE("Trace reuses the rings of exited threads", "[trace]") {
+    auto ring_count = [] {
+        auto & r = trace::detail::rings();
+        std::lock_guard lock(r.mutex);
+        return r.rings.size();
+    };
+
+    std::thread([] {
+        trace::span span("first");
+    }).join();
+    auto before = ring_count();
+    for (int idx = 0; idx < 100; ++idx) {
+        std::thread([] {
+            trace::span span("later");
+        }).join();
+    }
+    REQUIRE(ring_count() == before);
+
+    auto json = flush();
+    REQUIRE(count(json, "\"name\":\"later\"") == 100);
+}
+
+#else
+
+TEST_CASE("Tracing compiled out", "[trace]") {
+    REQUIRE_FALSE(trace::enabled);
+    REQUIRE(std::is_empty_v<trace::span>);
+    REQUIRE(std::is_empty_v<trace::file_scope>);
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include <catch2/catch.hpp>
+
+#include <transform.h>
+#include <string>
+
+TEST_CASE("Dead store elimination test", "[transform]") {
+    std::string input, expected;
+    uint32_t expected_rounds, expected_removed;
+
+    std::tie(input, expected, expected_rounds, expected_removed) =
+        GENERATE(table<std::string, std::string, uint32_t, uint32_t>({
+             {
+                 "x = 1 y = x",
+                 "",
+                 2, 2
+             },
+             {
+                 "x = 0 while x < 10 y = x end",
+                 "x = 0 while x < 10 y = x end",
+                 0, 0
+             },
+             {
+                 "x = 0\n"
+                 "while x < 10\n"
+                 "    y = x\n"
+                 "    x = x + 1\n"
+                 "end\n",
+                 "x = 0\n"
+                 "while x < 10\n"
+                 "    x = x + 1\n"
+                 "end\n",
+                 1, 1
+             },
+             {
+                 "x = 0\n"
+                 "if x > 0\n"
+                 "    y = 1\n"
+                 "end\n"
+                 "z = x\n",
+                 "",
+                 2, 3
+             },
+             {
+                 "a = 1\n"
+                 "b = a\n"
+                 "x = 3\n"
+                 "y = 4\n"
+                 "while (b < 5)\n"
+                 "    z = x\n"
+                 "    b = b + 1\n"
+                 "    x = 9\n"
+                 "    y = 10\n"
+                 "end\n",
+                 "a = 1\n"
+                 "b = a\n"
+                 "while (b < 5)\n"
+                 "    b = b + 1\n"
+                 "end\n",
+                 2, 5
+             },
+             {
+                 "i = 0 t = 1 while i < 3 t = i i = i + 1 end x = t + 1y = 2",
+                 "i = 0 while i < 3 i = i + 1 end ",
+                 2, 4
+             },
+        }));
+
+    CAPTURE(input);
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    auto result = transform::eliminate_dead_stores(tree, input, find_unused_assignments(tree, input));
+    REQUIRE(result.source == expected);
+    REQUIRE(result.rounds == expected_rounds);
+    REQUIRE(result.removed == expected_removed);
+}
@@ -0,0 +1,82 @@
+#include <catch2/catch.hpp>
+
+#include <transpile.h>
+#include <eval.h>
+#include <limits>
+#include <random>
+#include <string>
+#include "program_generator.h"
+
+namespace {
+
+    transpile::library compile_and_load(transpile::translation const & t) {
+        auto result = transpile::load(t);
+        if (auto error = std::get_if<transpile::load_error>(&result)) {
+            FAIL(error->message);
+        }
+        return std::move(std::get<transpile::library>(result));
+    }
+
+}
+
+TEST_CASE("Transpiled C follows the program structure", "[transpile]") {
+    std::string input = "r = 1 while n > 0 if n > 2 r = r * n end n = n - 1 end";
+    auto t = transpile::to_c(std::get<parser::ast::tree>(parser::parse(input)), input, "factorial");
+
+    REQUIRE(t.function == "factorial");
+    REQUIRE(t.variables == std::vector<std::string>{"r", "n"});
+    REQUIRE(t.source.find("int factorial(value * variables, uint64_t max_tests) {") != std::string::npos);
+    REQUIRE(t.source.find("    value v1 = variables[1];\n") != std::string::npos);
+    REQUIRE(t.source.find("    for (;;) {\n") != std::string::npos);
+    REQUIRE(t.source.find("        if ((value) ((v1) > (2LL))) {\n            v0 = sp_mul(v0, v1);\n        }\n") != std::string::npos);
+
+    auto library = compile_and_load(t);
+    std::vector<transpile::value> variables = {0, 10};
+    REQUIRE(library.run(variables));
+    REQUIRE(variables == std::vector<transpile::value>{1814400, 0});
+}
+
+TEST_CASE("Transpiled C keeps the language arithmetic", "[transpile]") {
+    constexpr auto MIN = std::numeric_limits<transpile::value>::min();
+    std::string input = "a = 9223372036854775807 + 1 b = x / 0 c = x / -1 d = -x e = 9223372036854775808 f = -7 / 2 g = 3 && -1 || 0";
+    auto t = transpile::to_c(std::get<parser::ast::tree>(parser::parse(input)), input);
+    auto library = compile_and_load(t);
+
+    std::vector<transpile::value> variables(t.variables.size());
+    variables[2] = MIN; // x
+    REQUIRE(library.run(variables));
+    REQUIRE(t.variables == std::vector<std::string>{"a", "b", "x", "c", "d", "e", "f", "g"});
+    REQUIRE(variables == std::vector<transpile::value>{MIN, 0, MIN, MIN, MIN, MIN, -3, 1});
+}
+
+TEST_CASE("Transpiled programs agree with the evaluator", "[transpile]") {
+    constexpr uint64_t MAX_TESTS = 300;
+    auto seed = GENERATE(range(0u, 16u));
+    auto input = program_generator::generate(40, seed, {.variables = 4, .nested = true, .depth = 3});
+    CAPTURE(seed, input);
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    auto p = eval::compile(tree, input);
+    auto t = transpile::to_c(tree, input);
+    auto library = compile_and_load(t);
+    REQUIRE(t.variables.size() == p.variable_count());
+
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<transpile::value> values(-5, 12);
+    for (int environment = 0; environment < 20; ++environment) {
+        std::vector<transpile::value> native(t.variables.size());
+        for (auto & v : native) {
+            v = values(random);
+        }
+        std::vector<eval::value> expected(p.variable_count());
+        for (uint32_t var = 0; var < t.variables.size(); ++var) {
+            expected[p.find_variable(t.variables[var])] = native[var];
+        }
+
+        auto finished = eval::run(p, expected, MAX_TESTS);
+        REQUIRE(library.run(native, MAX_TESTS) == finished);
+        for (uint32_t var = 0; var < t.variables.size(); ++var) {
+            CAPTURE(environment, t.variables[var]);
+            REQUIRE(native[var] == expected[p.find_variable(t.variables[var])]);
+        }
+    }
+}
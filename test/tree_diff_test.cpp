@@ -0,0 +1,154 @@
+#include <catch2/catch.hpp>
+
+#include <tree_diff.h>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    // every old node is matched to one new node at most, of the same kind
+    void require_consistent(tree_diff::script const & script, parser::ast::tree const & old_tree, parser::ast::tree const & new_tree) {
+        REQUIRE(script.old_of_new.size() == new_tree.size());
+        std::vector<uint16_t> new_of_old(old_tree.size(), parser::ast::tree::npos);
+        for (uint16_t node = 0; node < new_tree.size(); ++node) {
+            auto old_node = script.old_of_new[node];
+            if (old_node != parser::ast::tree::npos) {
+                CAPTURE(node, old_node);
+                REQUIRE(old_tree.get_kind(old_node) == new_tree.get_kind(node));
+                REQUIRE(new_of_old[old_node] == parser::ast::tree::npos);
+                new_of_old[old_node] = node;
+            }
+        }
+    }
+
+    std::string diff_and_dump(std::string const & old_sv, std::string const & new_sv) {
+        auto old_tree = std::get<parser::ast::tree>(parser::parse(old_sv));
+        auto new_tree = std::get<parser::ast::tree>(parser::parse(new_sv));
+        auto script = tree_diff::diff(old_tree, old_sv, new_tree, new_sv);
+
+        require_consistent(script, old_tree, new_tree);
+
+        std::stringstream ss;
+        tree_diff::print(ss, script, old_sv, new_sv);
+        return ss.str();
+    }
+
+}
+
+TEST_CASE("Tree diff test", "[tree_diff]") {
+    std::string old_sv, new_sv, expected;
+
+    std::tie(old_sv, new_sv, expected) =
+        GENERATE(table<std::string, std::string, std::string>({
+            {"x = a + b", "x = a + b", ""},
+            {"x = a + b", "x  =  (a + b)\n", ""},
+            {"x = a + b", "x = a - b",
+             "UPDATE [4..9] 'a + b' -> [4..9] 'a - b'\n"},
+            {"x = a + b y = 1", "x = a + c y = 1",
+             "UPDATE [8..9] 'b' -> [8..9] 'c'\n"},
+            {"x = 1 y = 2", "x = 1 z = 3 y = 2",
+             "INSERT [6..11] 'z = 3'\n"},
+            {"x = 1 z = 3 y = 2", "x = 1 y = 2",
+             "DELETE [6..11] 'z = 3'\n"},
+            {"a = 1 b = 2 c = 3", "b = 2 c = 3 a = 1",
+             "MOVE [0..5] 'a = 1' -> [12..17] 'a = 1'\n"},
+            {"x = 1 if c y = 2 end", "if c y = 2 x = 1 end",
+             "MOVE [0..5] 'x = 1' -> [11..16] 'x = 1'\n"},
+            {"x = (a * b) + c", "x = c + (a * b)",
+             "MOVE [14..15] 'c' -> [4..5] 'c'\n"
+             "MOVE [4..11] '(a * b)' -> [8..15] '(a * b)'\n"},
+            {"x = a", "while x < 10 x = a end",
+             "INSERT [0..22] 'while x < 10 x = a end'\n"
+             "MOVE [0..5] 'x = a' -> [13..18] 'x = a'\n"},
+            {"x = a y = b", "z = c",
+             "UPDATE [0..1] 'x' -> [0..1] 'z'\n"
+             "UPDATE [4..5] 'a' -> [4..5] 'c'\n"
+             "DELETE [6..11] 'y = b'\n"},
+        }));
+
+    CAPTURE(old_sv, new_sv);
+    REQUIRE(diff_and_dump(old_sv, new_sv) == expected);
+}
+
+TEST_CASE("Tree diff of large trees test", "[tree_diff]") {
+    std::string old_sv, new_sv;
+    for (int idx = 0; idx < 3600; ++idx) {
+        std::string counter = "v";
+        counter.push_back(static_cast<char>('a' + idx % 26));
+
+        std::string statement;
+        statement.append(counter).append(" = ").append(counter).append(" + ").append(std::to_string(idx));
+        statement.append(" while ").append(counter).append(" < 100 x = (x - 1) / 2 end\n");
+
+        old_sv += statement;
+        if (idx % 100 == 7) {
+            new_sv.append(counter).append(" = 0\n");
+        }
+        new_sv += statement;
+    }
+    auto old_tree = std::get<parser::ast::tree>(parser::parse(old_sv));
+    auto new_tree = std::get<parser::ast::tree>(parser::parse(new_sv));
+    REQUIRE(new_tree.size() > 60000);
+
+    auto start = std::chrono::steady_clock::now();
+    auto script = tree_diff::diff(old_tree, old_sv, new_tree, new_sv);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    REQUIRE(elapsed.count() < 1.0);
+    REQUIRE(script.edits.size() == 36);
+    for (auto const & e : script.edits) {
+        REQUIRE(e.op == tree_diff::operation::INSERT);
+        REQUIRE(new_sv.substr(e.new_range.first, e.new_range.second - e.new_range.first).ends_with(" = 0"));
+    }
+}
+
+TEST_CASE("Tree diff matches every node once at most", "[tree_diff]") {
+    std::mt19937 random(7);
+    auto pick = [&](uint32_t n) {
+        return std::uniform_int_distribution<uint32_t>(0, n - 1)(random);
+    };
+    auto variable = [&] {
+        return std::string(1, static_cast<char>('a' + pick(3)));
+    };
+    auto operand = [&] {
+        return pick(3) ? variable() : std::to_string(pick(3));
+    };
+    auto generate = [&] {
+        std::string result;
+        uint32_t opened = 0;
+        for (uint32_t statements = 1 + pick(12); statements; --statements) {
+            switch (pick(5)) {
+                case 0:
+                    result.append(pick(2) ? "while " : "if ").append(operand()).append(" < ").append(operand()).append(" ");
+                    ++opened;
+                    break;
+                case 1:
+                    if (opened) {
+                        result.append("a = a end ");
+                        --opened;
+                        break;
+                    }
+                    [[fallthrough]];
+                default:
+                    result.append(variable()).append(" = ").append(operand()).append(pick(2) ? " + " : " * ").append(operand()).append(" ");
+                    break;
+            }
+        }
+        for (; opened; --opened) {
+            result.append("b = b end ");
+        }
+        return result;
+    };
+
+    for (int pair = 0; pair < 3000; ++pair) {
+        auto old_sv = generate();
+        auto new_sv = generate();
+        CAPTURE(old_sv, new_sv);
+        auto old_tree = std::get<parser::ast::tree>(parser::parse(old_sv));
+        auto new_tree = std::get<parser::ast::tree>(parser::parse(new_sv));
+        require_consistent(tree_diff::diff(old_tree, old_sv, new_tree, new_sv), old_tree, new_tree);
+    }
+}
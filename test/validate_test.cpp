@@ -0,0 +1,95 @@
+#include <catch2/catch.hpp>
+
+#include <validate.h>
+#include <parser.h>
+#include <cstring>
+#include <random>
+#include <string>
+#include "program_generator.h"
+
+namespace {
+
+    void require_same_as_parse(std::string_view input) {
+        CAPTURE(input);
+        auto parsed = parser::parse(input);
+        auto validated = parser::validate(input);
+        if (auto error = std::get_if<lexer::error>(&parsed)) {
+            REQUIRE(validated);
+            REQUIRE(std::string(validated->cause) == error->cause);
+            REQUIRE(validated->pos == error->pos);
+        } else {
+            REQUIRE_FALSE(validated);
+        }
+    }
+
+}
+
+TEST_CASE("Validation agrees with the parser", "[validate]") {
+    std::string input = GENERATE(as<std::string>{},
+        "", "   ", "x", "x =", "x = ", "x = 1", "  x = 1  ", "x == 1", "x = 1 +", "x = (1", "x = (1))", "x = 1)",
+        "x = -", "x = --a", "x = a -- b", "x = a <= b >= c", "x = a < = b", "x = !a", "x = a ! b", "x = a & b",
+        "1 = x", "x = 1 y", "x = 1 y =", "x = 1 end", "end", "x = 1 end = 2",
+        "if x", "if x y = 1", "if x y = 1 end", "if x y = 1 end end", "if x end", "while", "while (x) y = 1 end",
+        "whilex y = 1 end", "iffy = 3", "if x y = 1 endz = 2", "if x y = 1 end\nwhile y < 2 y = y + 1\nend",
+        "if x if y z = 1 end", "if x if y z = 1 end end", "while x x = x - 1 if x y = 2 end",
+        "x = ((((a))))", "x = (a + (b * (c - d)) / e)", "x = a\r\n\ty = b\n", "x = a#", "x = 123abc",
+        "x = a1", "\xC3\xA9 = 1", "x = \xFF", "x = a +\n\n\n"
+    );
+    require_same_as_parse(input);
+}
+
+TEST_CASE("Validation bounds nesting like the parser", "[validate]") {
+    for (uint32_t depth : {lexer::MAX_NESTING - 1, lexer::MAX_NESTING, lexer::MAX_NESTING + 1}) {
+        require_same_as_parse("x = " + std::string(depth, '(') + "a" + std::string(depth, ')'));
+        require_same_as_parse("x = " + std::string(depth, '-') + "a");
+        require_same_as_parse("x = " + std::string(depth / 2, '(') + std::string(depth - depth / 2, '-') + "a" + std::string(depth / 2, ')'));
+        require_same_as_parse("x = (a) + " + std::string(depth, '(') + "a" + std::string(depth, ')') + " * -(b)");
+    }
+}
+
+TEST_CASE("Validation bounds the tree size like the parser", "[validate]") {
+    std::string program = "x = -1";
+    for (uint32_t statements = 1; statements < (parser::ast::tree::MAX_NODES + 1) / 4; ++statements) {
+        program += " x = 1";
+    }
+    for (auto tail : {"", " y = 1", " if x y = 1 end", " y = 1 z", " x = (1"}) {
+        require_same_as_parse(program + tail);
+    }
+}
+
+TEST_CASE("Validation agrees with the parser on mutated programs", "[validate]") {
+    auto seed = GENERATE(range(0u, 10u));
+    std::mt19937 random(seed);
+    auto program = program_generator::generate(60, random, {.indent = "\t", .nested = true, .depth = 2});
+    require_same_as_parse(program);
+
+    constexpr std::string_view ALPHABET = "()=-+*/<>!&| \n\t#0123456789abcdefhilnw";
+    auto pick = [&](size_t n) {
+        return std::uniform_int_distribution<size_t>(0, n - 1)(random);
+    };
+    for (int mutation = 0; mutation < 300; ++mutation) {
+        auto input = program;
+        for (auto edits = 1 + pick(3); edits; --edits) {
+            auto pos = pick(input.size());
+            switch (pick(3)) {
+                case 0:
+                    input.erase(pos, 1 + pick(4));
+                    break;
+                case 1:
+                    input.insert(pos, 1, ALPHABET[pick(ALPHABET.size())]);
+                    break;
+                default:
+                    input[pos] = ALPHABET[pick(ALPHABET.size())];
+                    break;
+            }
+        }
+        require_same_as_parse(input);
+        require_same_as_parse(input.substr(0, pick(input.size() + 1)));
+    }
+}
+
+TEST_CASE("Validation runs at compile time", "[validate]") {
+    static_assert(!parser::validate("while x < 10 x = x + 1 end"));
+    static_assert(parser::validate("while x < 10 x = x + 1")->pos == 22);
+    STATIC_REQUIRE(std::string_view(parser::validate("x = (1")->cause) == lexer::errors::UNCLOSED_PARENTHESIS);
+}
@@ -0,0 +1,173 @@
+#include <catch2/catch.hpp>
+
+#include <visitor.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+    // recursive reference for the iterators
+    void collect(parser::ast::tree const & tree, uint16_t node, uint32_t depth,
+                 std::vector<std::pair<uint16_t, uint32_t>> & pre, std::vector<uint16_t> & post) {
+        pre.emplace_back(node, depth);
+        if (tree.have_left(node)) {
+            collect(tree, tree.get_left(node), depth + 1, pre, post);
+        }
+        if (tree.have_right(node)) {
+            collect(tree, tree.get_right(node), depth + 1, pre, post);
+        }
+        post.push_back(node);
+    }
+
+    struct kind_counter : parser::ast::visitor<kind_counter> {
+        using visitor::visitor;
+
+        constexpr void visit_var(uint16_t) {
+            ++vars;
+        }
+
+        constexpr void visit_assignment(uint16_t node) {
+            ++assignments;
+            visit_children(node);
+        }
+
+        constexpr void visit_while(uint16_t node) {
+            ++loops; // the condition is skipped
+            visit(tree_.get_right(node));
+        }
+
+        uint32_t vars = 0;
+        uint32_t assignments = 0;
+        uint32_t loops = 0;
+    };
+
+    constexpr uint32_t count_vars(std::string_view sv) {
+        auto tree = std::get<parser::ast::tree>(parser::parse(sv));
+        kind_counter counter(tree);
+        counter.visit();
+        return counter.vars;
+    }
+
+}
+
+TEST_CASE("Traversal order test", "[visitor]") {
+    std::string input = GENERATE(as<std::string>{},
+        "x = 1",
+        "x = -(a + b) * c",
+        "x = a + b * c - d / e",
+        "if a < b x = 1 y = 2 end z = x + y",
+        "while x > 0 if y x = x - 1 end while z z = z - 1 end end t = x",
+        "a = 1 b = a c = b d = c e = d f = e");
+    CAPTURE(input);
+
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+    std::vector<std::pair<uint16_t, uint32_t>> expected_pre;
+    std::vector<uint16_t> expected_post;
+    collect(tree, tree.get_root(), 0, expected_pre, expected_post);
+
+    std::vector<std::pair<uint16_t, uint32_t>> pre;
+    auto preorder = parser::ast::preorder(tree);
+    for (auto it = preorder.begin(); it != preorder.end(); ++it) {
+        pre.emplace_back(*it, it.depth());
+    }
+    REQUIRE(pre == expected_pre);
+
+    std::vector<uint16_t> post;
+    for (auto node : parser::ast::postorder(tree)) {
+        post.push_back(node);
+    }
+    REQUIRE(post == expected_post);
+
+    std::vector<std::pair<uint16_t, uint32_t>> entered;
+    std::vector<uint16_t> left;
+    parser::ast::walk(tree, [&](uint16_t node, uint32_t depth) {
+        entered.emplace_back(node, depth);
+    }, [&](uint16_t node, uint32_t depth) {
+        REQUIRE(depth == expected_pre[std::find_if(expected_pre.begin(), expected_pre.end(), [&](auto const & p) {
+            return p.first == node;
+        }) - expected_pre.begin()].second);
+        left.push_back(node);
+    });
+    REQUIRE(entered == expected_pre);
+    REQUIRE(left == expected_post);
+}
+
+TEST_CASE("Subtree traversal test", "[visitor]") {
+    std::string input = "x = (a + b) * c y = d";
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+
+    auto assignment = tree.get_left(tree.get_root());
+    auto product = tree.get_right(assignment);
+
+    std::vector<std::string_view> pre;
+    for (auto node : parser::ast::preorder(tree, product)) {
+        pre.push_back(tree.get_string(node, input));
+    }
+    REQUIRE(pre == std::vector<std::string_view>{"(a + b) * c", "(a + b)", "a", "b", "c"});
+
+    std::vector<std::string_view> post;
+    for (auto node : parser::ast::postorder(tree, product)) {
+        post.push_back(tree.get_string(node, input));
+    }
+    REQUIRE(post == std::vector<std::string_view>{"a", "b", "(a + b)", "c", "(a + b) * c"});
+
+    auto leaf = tree.get_right(product);
+    REQUIRE(std::ranges::distance(parser::ast::preorder(tree, leaf)) == 1);
+
+    parser::ast::tree empty;
+    REQUIRE(parser::ast::preorder(empty).begin() == parser::ast::preorder(empty).end());
+    REQUIRE(parser::ast::postorder(empty).begin() == parser::ast::postorder(empty).end());
+}
+
+TEST_CASE("Children range test", "[visitor]") {
+    std::string input = "x = -a + 1";
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+
+    auto assignment = tree.get_root();
+    auto sum = tree.get_right(assignment);
+    auto negation = tree.get_left(sum);
+
+    auto children = parser::ast::children(tree, sum);
+    REQUIRE(children.size() == 2);
+    REQUIRE(std::vector<uint16_t>(children.begin(), children.end())
+            == std::vector<uint16_t>{tree.get_left(sum), tree.get_right(sum)});
+
+    REQUIRE(parser::ast::children(tree, negation).size() == 1);
+    REQUIRE(*parser::ast::children(tree, negation).begin() == tree.get_left(negation));
+    REQUIRE(parser::ast::children(tree, tree.get_left(negation)).empty());
+}
+
+TEST_CASE("Visitor dispatch test", "[visitor]") {
+    std::string input = "a = b while a > c a = a - 1 x = y end z = -a";
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+
+    kind_counter counter(tree);
+    counter.visit();
+    REQUIRE(counter.assignments == 4);
+    REQUIRE(counter.loops == 1);
+    REQUIRE(counter.vars == 8); // `a > c` is skipped
+
+    static_assert(count_vars("x = a + b if x y = -x end") == 6);
+}
+
+TEST_CASE("Long statement lists test", "[visitor]") {
+    std::string input;
+    for (int idx = 0; idx < 8000; ++idx) {
+        input += "x = x + 1\n";
+    }
+    auto tree = std::get<parser::ast::tree>(parser::parse(input));
+
+    kind_counter counter(tree);
+    counter.visit();
+    REQUIRE(counter.assignments == 8000);
+
+    uint32_t max_depth = 0;
+    uint32_t nodes = 0;
+    auto preorder = parser::ast::preorder(tree);
+    for (auto it = preorder.begin(); it != preorder.end(); ++it) {
+        max_depth = std::max(max_depth, it.depth());
+        ++nodes;
+    }
+    REQUIRE(nodes == tree.size());
+    REQUIRE(max_depth == 8001); // operands of the last statement
+}